@@ -0,0 +1,151 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+// Replacement of the global allocation functions counting heap allocations
+// and allocated bytes; include in exactly one translation unit of a
+// benchmark executable.
+// All the forms are replaced as a matched set: every operator new
+// allocates with malloc and every operator delete releases with free.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace bench {
+std::atomic< size_t > allocations(0);
+std::atomic< size_t > allocatedBytes(0);
+
+//! Count and allocate; \c nullptr on failure.
+inline void* Allocate(size_t size) noexcept {
+    ++allocations;
+    allocatedBytes += size;
+    return malloc(size ? size : 1);
+}
+
+//! Count and allocate, throw \c std::bad_alloc on failure.
+inline void* AllocateOrThrow(size_t size) {
+    void* p = Allocate(size);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+inline void Release(void* p) noexcept { free(p); }
+}
+
+void* operator new(size_t size) {
+    return bench::AllocateOrThrow(size);
+}
+
+void* operator new[](size_t size) {
+    return bench::AllocateOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return bench::Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return bench::Allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    bench::Release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    bench::Release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    bench::Release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    bench::Release(p);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* p, size_t) noexcept {
+    bench::Release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    bench::Release(p);
+}
+#endif
+
+#if defined(__cpp_aligned_new)
+//Aligned forms: aligned_alloc requires a size multiple of the alignment;
+//memory from aligned_alloc is released with free.
+namespace bench {
+inline void* Allocate(size_t size, std::align_val_t al) noexcept {
+    const size_t a = size_t(al);
+    ++allocations;
+    allocatedBytes += size;
+    return aligned_alloc(a, size ? (size + a - 1) / a * a : a);
+}
+
+inline void* AllocateOrThrow(size_t size, std::align_val_t al) {
+    void* p = Allocate(size, al);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+}
+
+void* operator new(size_t size, std::align_val_t al) {
+    return bench::AllocateOrThrow(size, al);
+}
+
+void* operator new[](size_t size, std::align_val_t al) {
+    return bench::AllocateOrThrow(size, al);
+}
+
+void* operator new(size_t size, std::align_val_t al,
+                   const std::nothrow_t&) noexcept {
+    return bench::Allocate(size, al);
+}
+
+void* operator new[](size_t size, std::align_val_t al,
+                     const std::nothrow_t&) noexcept {
+    return bench::Allocate(size, al);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    bench::Release(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    bench::Release(p);
+}
+
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+    bench::Release(p);
+}
+
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+    bench::Release(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    bench::Release(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    bench::Release(p);
+}
+#endif
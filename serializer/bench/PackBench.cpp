@@ -0,0 +1,281 @@
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+// Pack benchmark: number of heap allocations and throughput of srz::Pack
+// on the message shapes sent by the web application client test server,
+// compared with growing the buffer once per argument; size and throughput
+// of the integer encodings on index, id and count arrays and of the block
+// compression and precision reduction of scalar fields; std::map and
+// srz::FlatMap of numbers.
+//
+// usage: pack-bench [iterations]
+
+//same configuration as the application client test server
+#define ZRF_UNSIGNED_CHAR
+#define ZRF_int32_size
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "Serialize.h"
+#include "IntegerCodecs.h"
+#include "Compression.h"
+#include "Quantize.h"
+#include "FlatMap.h"
+#include "AllocationCounter.h"
+
+using namespace std;
+
+enum class ServerEventId {PRINT = 1, RESIZE = 2, FILE_DOWNLOAD = 3};
+
+//Reference: append one argument at a time, resizing the buffer each time.
+inline srz::ByteArray PackIncremental(srz::ByteArray&& ba) {
+    return move(ba);
+}
+
+template< typename T, typename... ArgsT >
+srz::ByteArray PackIncremental(srz::ByteArray&& ba, const T& h,
+                               const ArgsT&... t) {
+    return PackIncremental(
+        srz::GetSerializer< T >::Type::Pack(h, move(ba)), t...);
+}
+
+volatile size_t sink = 0;
+
+template< typename F >
+void Run(const string& name, int iterations, F&& f) {
+    //warm up
+    sink += f().size();
+    const size_t a = bench::allocations.load();
+    const auto begin = chrono::steady_clock::now();
+    size_t bytes = 0;
+    for(int i = 0; i != iterations; ++i) bytes += f().size();
+    const double s = chrono::duration< double >(
+        chrono::steady_clock::now() - begin).count();
+    sink += bytes;
+    cout << left << setw(46) << name
+         << right << setw(10) << fixed << setprecision(2)
+         << double(bench::allocations.load() - a) / iterations << " allocs/msg"
+         << setw(14) << setprecision(0) << iterations / s << " msg/s"
+         << setw(12) << setprecision(1) << bytes / s / (1 << 20) << " MiB/s"
+         << endl;
+}
+
+template< typename... ArgsT >
+void Compare(const string& name, int iterations, const ArgsT&... args) {
+    Run(name + " (incremental)", iterations, [&]() {
+        return PackIncremental(srz::ByteArray(), args...);
+    });
+    Run(name + " (Pack)", iterations, [&]() {
+        return srz::Pack(args...);
+    });
+}
+
+//Bytes consumed by unpacking, reported as message size.
+struct Consumed {
+    size_t bytes;
+    size_t size() const { return bytes; }
+};
+
+//Unpack into a new tuple and into existing variables.
+template< typename T1, typename T2, typename T3 >
+void CompareUnPack(const string& name, int iterations,
+                   const T1& a, const T2& b, const T3& c) {
+    const srz::ByteArray buf = srz::Pack(a, b, c);
+    Run(name + " (UnPackTuple)", iterations, [&]() {
+        const tuple< T1, T2, T3 > t = srz::UnPackTuple< T1, T2, T3 >(buf);
+        sink += get< 0 >(t) == a;
+        return Consumed{buf.size()};
+    });
+    T1 x;
+    T2 y;
+    T3 z;
+    Run(name + " (UnPackInto)", iterations, [&]() {
+        return Consumed{size_t(srz::UnPackInto(buf.data(), x, y, z)
+                               - buf.data())};
+    });
+}
+
+//Encoded size relative to plain vector, encode and decode throughput in
+//MiB/s of input data.
+template< typename EncodedT, typename T >
+void Codec(const string& name, int iterations, const vector< T >& v) {
+    const size_t plain = srz::Sizeof(v);
+    const EncodedT e(v);
+    srz::ByteArray buf;
+    srz::Pack(buf, e);
+    auto begin = chrono::steady_clock::now();
+    for(int i = 0; i != iterations; ++i) {
+        buf.clear();
+        sink += srz::Pack(buf, e);
+    }
+    const double es =
+        chrono::duration< double >(chrono::steady_clock::now() - begin).count();
+    EncodedT d;
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i != iterations; ++i) {
+        srz::UnPack(buf.data(), d);
+        sink += d.Size();
+    }
+    const double ds =
+        chrono::duration< double >(chrono::steady_clock::now() - begin).count();
+    const double mib = double(iterations) * v.size() * sizeof(T) / (1 << 20);
+    cout << left << setw(46) << name
+         << right << setw(10) << fixed << setprecision(2)
+         << double(buf.size()) / plain << " of plain"
+         << setw(12) << setprecision(1) << mib / es << " MiB/s enc"
+         << setw(12) << setprecision(1) << mib / ds << " MiB/s dec"
+         << endl;
+}
+
+//Compressed size relative to plain vector, compress and decompress
+//throughput in MiB/s of input data.
+template< typename T >
+void Compression(const string& name, int iterations, const vector< T >& v,
+                 srz::Shuffle shuffle, unsigned threads) {
+    const size_t plain = srz::Sizeof(v);
+    const auto c = srz::AsCompressed(v, shuffle, threads);
+    srz::ByteArray buf;
+    srz::Pack(buf, c);
+    auto begin = chrono::steady_clock::now();
+    for(int i = 0; i != iterations; ++i) {
+        buf.clear();
+        sink += srz::Pack(buf, c);
+    }
+    const double cs =
+        chrono::duration< double >(chrono::steady_clock::now() - begin).count();
+    srz::Compressed< T > d;
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i != iterations; ++i) {
+        srz::UnPack(buf.data(), d);
+        sink += d.Size();
+    }
+    const double ds =
+        chrono::duration< double >(chrono::steady_clock::now() - begin).count();
+    const double mib = double(iterations) * plain / (1 << 20);
+    cout << left << setw(46) << name
+         << right << setw(10) << fixed << setprecision(2)
+         << double(buf.size()) / plain << " of plain"
+         << setw(12) << setprecision(1) << mib / cs << " MiB/s enc"
+         << setw(12) << setprecision(1) << mib / ds << " MiB/s dec"
+         << endl;
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    const string file = "This is the file content";
+    vector< string > lines;
+    for(int i = 0; i != 100; ++i) lines.push_back("line " + to_string(i));
+    map< string, string > params;
+    for(int i = 0; i != 20; ++i)
+        params["key" + to_string(i)] = "value" + to_string(i);
+    const vector< float > samples(1 << 16, 1.0f);
+    Compare("RESIZE: id, int, int", iterations,
+            ServerEventId::RESIZE, 960, 540);
+    //volatile: keep the loop from being folded into a constant
+    volatile int width = 960;
+    Run("RESIZE: id, int, int (PackFixed)", iterations, [&]() {
+        const auto m = srz::PackFixed(ServerEventId::RESIZE, int(width), 540);
+        sink += m[4];
+        return m;
+    });
+    Compare("PRINT: id, string", iterations,
+            ServerEventId::PRINT, to_string(123456));
+    Compare("FILE_DOWNLOAD: id, string", iterations,
+            ServerEventId::FILE_DOWNLOAD, file);
+    Compare("id, vector<string>(100)", iterations / 10,
+            ServerEventId::PRINT, lines);
+    Compare("id, map<string, string>(20)", iterations / 10,
+            ServerEventId::PRINT, params);
+    Compare("id, int, int, vector<float>(64k)", iterations / 100,
+            ServerEventId::RESIZE, 960, 540, samples);
+    CompareUnPack("UnPack id, string, vector<string>(100)", iterations / 10,
+                  int(ServerEventId::PRINT), file, lines);
+    //maps of numbers: same layout, node based vs contiguous storage
+    map< int, float > levels;
+    for(int i = 0; i != 1000; ++i) levels[3 * i] = float(i) / 8;
+    const srz::ByteArray lb = srz::Pack(levels);
+    srz::FlatMap< int, float > flat;
+    srz::UnPack(lb.begin(), flat);
+    Compare("id, map<int, float>(1000)", iterations / 100,
+            ServerEventId::PRINT, levels);
+    Compare("id, FlatMap<int, float>(1000)", iterations / 100,
+            ServerEventId::PRINT, flat);
+    Run("UnPack map<int, float>(1000)", iterations / 100, [&]() {
+        return Consumed{size_t(srz::UnPack(lb.data(), levels) - lb.data())};
+    });
+    Run("UnPack FlatMap<int, float>(1000)", iterations / 100, [&]() {
+        return Consumed{size_t(srz::UnPack(lb.data(), flat) - lb.data())};
+    });
+    //index buffer, monotonic particle ids, small histogram counts
+    vector< uint32_t > indices(1 << 16), ids(1 << 16), counts(1 << 16);
+    for(size_t i = 0; i != indices.size(); ++i) {
+        indices[i] = uint32_t(i / 3 + i % 3 * 17);
+        ids[i] = uint32_t(1000000 + 2 * i + i % 5);
+        counts[i] = uint32_t((i * 2654435761u) >> 26);
+    }
+    const int ci = max(1, iterations / 1000);
+    Codec< srz::Encoded< uint32_t, srz::Varint > >(
+        "indices varint", ci, indices);
+    Codec< srz::Encoded< uint32_t, srz::BitPacked > >(
+        "indices bit packed", ci, indices);
+    Codec< srz::Encoded< uint32_t, srz::Delta > >(
+        "ids delta", ci, ids);
+    Codec< srz::Encoded< uint32_t, srz::DeltaBitPacked > >(
+        "ids delta bit packed", ci, ids);
+    Codec< srz::Encoded< uint32_t, srz::Varint > >(
+        "counts varint", ci, counts);
+    Codec< srz::Encoded< uint32_t, srz::BitPacked > >(
+        "counts bit packed", ci, counts);
+    //2D scalar fields: full precision, two decimals, mostly empty
+    const size_t side = 1024;
+    vector< float > smooth(side * side), rounded(side * side),
+                    sparse(side * side);
+    for(size_t i = 0; i != smooth.size(); ++i) {
+        const double x = double(i % side), y = double(i / side);
+        smooth[i] = float(sin(x * 0.01) * cos(y * 0.013) * 100 + 10);
+        rounded[i] = roundf(smooth[i] * 100) / 100;
+        const double r2 = (x - 512) * (x - 512) + (y - 512) * (y - 512);
+        sparse[i] = r2 < 200 * 200 ? smooth[i] : 0.f;
+    }
+    const unsigned cores = max(1u, thread::hardware_concurrency());
+    const int zi = max(1, iterations / 20000);
+    for(srz::Shuffle s: {srz::Shuffle::NONE, srz::Shuffle::BYTE,
+                         srz::Shuffle::BIT}) {
+        const string mode = s == srz::Shuffle::NONE ? "no shuffle"
+                            : s == srz::Shuffle::BYTE ? "byte shuffle"
+                                                      : "bit shuffle";
+        Compression("float field, " + mode, zi, smooth, s, 1);
+        Compression("float field 2 decimals, " + mode, zi, rounded, s, 1);
+        Compression("sparse float field, " + mode, zi, sparse, s, 1);
+    }
+    Compression("float field, byte shuffle, " + to_string(cores)
+                + " threads", zi, smooth, srz::Shuffle::BYTE, cores);
+    Codec< srz::Quantized< srz::Half > >("float field, half", zi, smooth);
+    Codec< srz::Quantized< srz::Fixed16 > >("float field, 16 bit fixed", zi,
+                                             smooth);
+    Codec< srz::Quantized< srz::Fixed8 > >("float field, 8 bit fixed", zi,
+                                            smooth);
+    return EXIT_SUCCESS;
+}
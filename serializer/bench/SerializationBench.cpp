@@ -0,0 +1,216 @@
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+// Serialization benchmark: time and heap allocations per message of
+// Pack into a new buffer, Pack into a reused sink, UnPackInto and
+// UnPackChecked into existing variables, compared with a memcpy of the
+// serialized bytes. Messages are PODs, strings, vectors of PODs and
+// strings, maps, tuples and nested structs from a few bytes up to
+// max-bytes; containers of non-POD elements up to max-bytes / 16.
+// Results are printed as JSON, one record per message and operation:
+// "memcpy_ratio" is the time relative to the memcpy baseline.
+//
+// usage: serialization-bench [max-bytes] [min-seconds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Serialize.h"
+#include "Fields.h"
+#include "Sinks.h"
+#include "AllocationCounter.h"
+
+using namespace std;
+
+namespace test {
+struct Vec3 {
+    float x, y, z;
+};
+SRZ_FIELDS(Vec3, x, y, z)
+
+struct Particle {
+    int32_t id;
+    Vec3 pos;
+    string name;
+    vector< float > weights;
+};
+SRZ_FIELDS(Particle, id, pos, name, weights)
+}
+
+namespace {
+volatile size_t sink = 0;
+double minSeconds = 0.2;
+
+//Time and allocations per call.
+struct Sample {
+    size_t iterations;
+    double ns;
+    double allocs;
+    double allocatedBytes;
+};
+
+//Call f until at least minSeconds elapsed, increasing the number of calls
+//from the time of the previous run.
+template< typename F >
+Sample Measure(F&& f) {
+    f(); //warm up: caches, sink capacity
+    for(size_t n = 1;;) {
+        const size_t a = bench::allocations.load();
+        const size_t b = bench::allocatedBytes.load();
+        const auto begin = chrono::steady_clock::now();
+        for(size_t i = 0; i != n; ++i) f();
+        const double s = chrono::duration< double >(
+            chrono::steady_clock::now() - begin).count();
+        if(s >= minSeconds || n >= (size_t(1) << 40))
+            return Sample{n, s * 1e9 / n,
+                          double(bench::allocations.load() - a) / n,
+                          double(bench::allocatedBytes.load() - b) / n};
+        n = s > 0 ? max(2 * n, size_t(1.2 * minSeconds / s * n)) : 2 * n;
+    }
+}
+
+string Escape(const string& s) {
+    string e;
+    for(char c: s) {
+        if(c == '"' || c == '\\') e += '\\';
+        e += c;
+    }
+    return e;
+}
+
+bool firstRecord = true;
+
+void Report(const string& name, size_t elements, size_t bytes,
+            const string& op, const Sample& s, const Sample& baseline) {
+    ostringstream os;
+    os << (firstRecord ? "\n" : ",\n")
+       << "    {\"message\": \"" << Escape(name) << "\""
+       << ", \"elements\": " << elements
+       << ", \"bytes\": " << bytes
+       << ", \"op\": \"" << op << "\""
+       << ", \"iterations\": " << s.iterations
+       << ", \"ns_per_op\": " << s.ns
+       << ", \"mib_per_s\": " << bytes / (s.ns * 1e-9) / (1 << 20)
+       << ", \"allocs_per_op\": " << s.allocs
+       << ", \"allocated_bytes_per_op\": " << s.allocatedBytes
+       << ", \"memcpy_ratio\": " << s.ns / baseline.ns << "}";
+    cout << os.str() << flush;
+    firstRecord = false;
+}
+
+//Measure all operations on one message; args are overwritten by the
+//unpack operations with the same values.
+template< typename... ArgsT >
+void Bench(const string& name, size_t elements, ArgsT&... args) {
+    const srz::ByteArray packed = srz::Pack(args...);
+    const Byte* begin = packed.data();
+    const Byte* end = begin + packed.size();
+    srz::ByteArray copy(packed.size());
+    const Sample baseline = Measure([&]() {
+        memcpy(copy.data(), begin, packed.size());
+        sink += size_t(copy[0]);
+    });
+    Report(name, elements, packed.size(), "memcpy", baseline, baseline);
+    Report(name, elements, packed.size(), "pack", Measure([&]() {
+        sink += srz::Pack(args...).size();
+    }), baseline);
+    srz::ByteArray reused;
+    srz::VectorSink<> vs(reused);
+    Report(name, elements, packed.size(), "pack_sink", Measure([&]() {
+        vs.Clear();
+        srz::Pack(vs, args...);
+        sink += vs.Size();
+    }), baseline);
+    Report(name, elements, packed.size(), "unpack", Measure([&]() {
+        sink += size_t(srz::UnPackInto(begin, args...) - begin);
+    }), baseline);
+    Report(name, elements, packed.size(), "unpack_checked", Measure([&]() {
+        sink += size_t(srz::UnPackChecked(begin, end, args...) - begin);
+    }), baseline);
+}
+
+string Text(size_t i, size_t length) {
+    string s = to_string(i);
+    s.resize(length, 'x');
+    return s;
+}
+}
+
+int main(int argc, char** argv) {
+    const size_t maxBytes =
+        argc > 1 ? size_t(atof(argv[1])) : size_t(256) << 20;
+    if(argc > 2) minSeconds = atof(argv[2]);
+    //message sizes: 64 B, 4 KiB, 256 KiB, 16 MiB ... and max-bytes
+    vector< size_t > sizes;
+    for(size_t s = 64; s < maxBytes; s *= 64) sizes.push_back(s);
+    sizes.push_back(maxBytes);
+    cout << "{\n  \"benchmark\": \"serialization-bench\",\n"
+         << "  \"size_bytes\": " << sizeof(Size) << ",\n"
+         << "  \"max_bytes\": " << maxBytes << ",\n"
+         << "  \"results\": [";
+    {
+        int32_t i = 42;
+        Bench("int32", 1, i);
+        tuple< int32_t, float, double > t(1, 2.f, 3.);
+        Bench("tuple<int32, float, double>", 1, t);
+        test::Vec3 v{1.f, 2.f, 3.f};
+        Bench("Vec3 (fields)", 1, v);
+    }
+    for(size_t bytes: sizes) {
+        string s(bytes, 'x');
+        Bench("string", bytes, s);
+        vector< float > f(bytes / sizeof(float), 0.5f);
+        Bench("vector<float>", f.size(), f);
+        vector< double > d(bytes / sizeof(double) / 2, 0.25);
+        int32_t id = 7;
+        string text(bytes / 2, 't');
+        Bench("int32, string, vector<double>", d.size(), id, text, d);
+    }
+    for(size_t bytes: sizes) {
+        if(bytes > maxBytes / 16 && bytes != sizes.front()) break;
+        vector< string > lines(bytes / 32);
+        for(size_t i = 0; i != lines.size(); ++i) lines[i] = Text(i, 24);
+        Bench("vector<string>", lines.size(), lines);
+        map< int32_t, float > levels;
+        for(size_t i = 0; i != bytes / 8; ++i)
+            levels.emplace_hint(levels.end(), int32_t(i), float(i));
+        Bench("map<int32, float>", levels.size(), levels);
+        map< string, string > params;
+        for(size_t i = 0; i != bytes / 48; ++i)
+            params[Text(i, 12)] = Text(i, 20);
+        Bench("map<string, string>", params.size(), params);
+        vector< test::Particle > particles(bytes / 80);
+        for(size_t i = 0; i != particles.size(); ++i)
+            particles[i] = test::Particle{int32_t(i), {1.f, 2.f, 3.f},
+                                          Text(i, 12),
+                                          vector< float >(8, 1.f)};
+        Bench("vector<Particle> (nested fields)", particles.size(),
+              particles);
+        map< string, vector< float > > series;
+        for(size_t i = 0; i != bytes / 256; ++i)
+            series[Text(i, 12)] = vector< float >(56, float(i));
+        Bench("map<string, vector<float>>", series.size(), series);
+    }
+    cout << "\n  ]\n}" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,697 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Compression.h
+//! \brief Block compression of POD arrays: byte or bit shuffle followed by
+//! a fast LZ codec.
+//!
+//! Compression is selected at \c Pack time by wrapping the data:
+//! \code
+//! srz::Pack(id, srz::AsCompressed(field, srz::Shuffle::BIT, 4));
+//! \endcode
+//! and reverted by unpacking into a \c Compressed< T > object.
+//! The array is split into blocks compressed independently, in parallel
+//! when more than one thread is requested.
+//!
+//! Layout: element count (\c Size), number of compressed bytes (\c Size),
+//! element size (\c uint8_t), shuffle mode (\c uint8_t), elements per block
+//! (\c uint32_t), blocks. Each block is a \c uint32_t data size, with the
+//! high bit set if the data is stored without LZ compression, followed by
+//! the data. Before compression each block of \c n elements of \c w bytes
+//! is filtered:
+//! - \c Shuffle::BYTE: byte \c b of element \c i is moved to position
+//!   \c b*n+i, grouping bytes of similar significance (SSE2)
+//! - \c Shuffle::BIT: byte shuffle, then the first \c m=n-n%8 bytes of each
+//!   byte plane are replaced by 8 bit planes of \c m/8 bytes: bit \c j of
+//!   byte \c i is stored in bit \c i%8 of byte \c j*m/8+i/8
+//!
+//! LZ data uses the LZ4 block format: sequences of a token (literal length
+//! in the high nibble, match length minus 4 in the low nibble, 15 meaning
+//! that length bytes follow, each adding up to 255), literals and a 16 bit
+//! little-endian match offset; the last sequence has literals only.
+//! Element bytes are in wire byte order.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Serialize.h"
+
+namespace srz {
+
+//! Shuffle filter applied before compression.
+enum class Shuffle : uint8_t {NONE = 0, BYTE = 1, BIT = 2};
+
+//! Block compression of raw buffers.
+namespace compress {
+
+//! Default number of bytes per block; blocks are compressed independently.
+const size_t BLOCK_BYTES = 0x10000;
+
+//! Block size flag: data stored without LZ compression.
+const uint32_t STORED = 0x80000000u;
+
+//! Bytes of header following element count and compressed size.
+const size_t HEADER_SIZE = 6;
+
+namespace detail {
+//! \defgroup Shuffle filters
+//! @{
+inline void ByteShuffleScalar(uint8_t* dst, const uint8_t* src,
+                              size_t begin, size_t n, size_t w) {
+    for(size_t i = begin; i != n; ++i)
+        for(size_t b = 0; b != w; ++b) dst[b * n + i] = src[i * w + b];
+}
+
+inline void ByteUnshuffleScalar(uint8_t* dst, const uint8_t* src,
+                                size_t begin, size_t n, size_t w) {
+    for(size_t i = begin; i != n; ++i)
+        for(size_t b = 0; b != w; ++b) dst[i * w + b] = src[b * n + i];
+}
+
+#if defined(__SSE2__)
+inline __m128i Unpack(__m128i a, __m128i b, int unit, bool hi) {
+    switch(unit) {
+    case 1: return hi ? _mm_unpackhi_epi8(a, b) : _mm_unpacklo_epi8(a, b);
+    case 2: return hi ? _mm_unpackhi_epi16(a, b) : _mm_unpacklo_epi16(a, b);
+    case 4: return hi ? _mm_unpackhi_epi32(a, b) : _mm_unpacklo_epi32(a, b);
+    default: return hi ? _mm_unpackhi_epi64(a, b) : _mm_unpacklo_epi64(a, b);
+    }
+}
+
+//! Interleave registers whose indices differ in bit \c bit, \c unit bytes
+//! at a time: lower halves into the lower index, upper halves into the
+//! upper index.
+inline void UnpackPairs(__m128i* r, size_t count, size_t bit, int unit) {
+    const size_t m = size_t(1) << bit;
+    for(size_t i = 0; i != count; ++i) {
+        if(i & m) continue;
+        const __m128i lo = Unpack(r[i], r[i | m], unit, false);
+        r[i | m] = Unpack(r[i], r[i | m], unit, true);
+        r[i] = lo;
+    }
+}
+
+//! Reverse lower \c bits bits of \c i.
+inline size_t ReverseBits(size_t i, size_t bits) {
+    size_t r = 0;
+    for(size_t b = 0; b != bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+    return r;
+}
+
+//! Byte shuffle of groups of 16 elements of 2, 4 or 8 bytes: transpose of
+//! \c w registers through unpack operations; byte plane \c b ends up in
+//! register \c ReverseBits(b).
+//! \return number of elements processed
+inline size_t ByteShuffleSSE2(uint8_t* dst, const uint8_t* src,
+                              size_t n, size_t w) {
+    if(w != 2 && w != 4 && w != 8) return 0;
+    const size_t bits = w == 2 ? 1 : w == 4 ? 2 : 3;
+    const size_t groups = n / 16;
+    for(size_t g = 0; g != groups; ++g) {
+        __m128i r[8];
+        const uint8_t* s = src + g * 16 * w;
+        for(size_t k = 0; k != w; ++k)
+            r[k] = _mm_loadu_si128(
+                reinterpret_cast< const __m128i* >(s + 16 * k));
+        if(w == 2) {
+            for(int k = 0; k != 4; ++k) UnpackPairs(r, 2, 0, 1);
+        } else if(w == 4) {
+            for(int k = 0; k != 3; ++k) UnpackPairs(r, 4, 0, 1);
+            UnpackPairs(r, 4, 1, 8);
+        } else {
+            UnpackPairs(r, 8, 0, 1);
+            UnpackPairs(r, 8, 0, 1);
+            UnpackPairs(r, 8, 1, 4);
+            UnpackPairs(r, 8, 2, 8);
+        }
+        for(size_t b = 0; b != w; ++b)
+            _mm_storeu_si128(
+                reinterpret_cast< __m128i* >(dst + b * n + g * 16),
+                r[ReverseBits(b, bits)]);
+    }
+    return groups * 16;
+}
+
+//! Inverse of \c ByteShuffleSSE2.
+inline size_t ByteUnshuffleSSE2(uint8_t* dst, const uint8_t* src,
+                                size_t n, size_t w) {
+    if(w != 2 && w != 4 && w != 8) return 0;
+    const size_t bits = w == 2 ? 1 : w == 4 ? 2 : 3;
+    const size_t groups = n / 16;
+    for(size_t g = 0; g != groups; ++g) {
+        __m128i r[8];
+        for(size_t b = 0; b != w; ++b)
+            r[b] = _mm_loadu_si128(
+                reinterpret_cast< const __m128i* >(src + b * n + g * 16));
+        UnpackPairs(r, w, 0, 1);
+        if(w > 2) UnpackPairs(r, w, 1, 2);
+        if(w > 4) UnpackPairs(r, w, 2, 4);
+        uint8_t* d = dst + g * 16 * w;
+        for(size_t k = 0; k != w; ++k)
+            _mm_storeu_si128(reinterpret_cast< __m128i* >(d + 16 * k),
+                             r[ReverseBits(k, bits)]);
+    }
+    return groups * 16;
+}
+#endif
+
+//! Byte shuffle \c n elements of \c w bytes.
+inline void ByteShuffle(uint8_t* dst, const uint8_t* src, size_t n,
+                        size_t w) {
+#if defined(__SSE2__)
+    const size_t done = ByteShuffleSSE2(dst, src, n, w);
+#else
+    const size_t done = 0;
+#endif
+    ByteShuffleScalar(dst, src, done, n, w);
+}
+
+//! Inverse of \c ByteShuffle.
+inline void ByteUnshuffle(uint8_t* dst, const uint8_t* src, size_t n,
+                          size_t w) {
+#if defined(__SSE2__)
+    const size_t done = ByteUnshuffleSSE2(dst, src, n, w);
+#else
+    const size_t done = 0;
+#endif
+    ByteUnshuffleScalar(dst, src, done, n, w);
+}
+
+//! Transpose 8x8 bit matrix: bit \c j of byte \c k is moved to bit \c k of
+//! byte \c j, bytes in little-endian order.
+inline uint64_t Transpose8(uint64_t x) {
+    uint64_t t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaull;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000cccc0000ccccull;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ull;
+    return x ^ t ^ (t << 28);
+}
+
+//! Replace first \c n-n%8 bytes of byte plane with 8 bit planes.
+inline void BitShufflePlane(uint8_t* plane, size_t n, uint8_t* tmp) {
+    const size_t m = n & ~size_t(7);
+    const size_t stride = m / 8;
+    size_t i = 0;
+#if defined(__SSE2__)
+    for(; i + 16 <= m; i += 16) {
+        __m128i x = _mm_loadu_si128(
+            reinterpret_cast< const __m128i* >(plane + i));
+        for(int j = 7; j >= 0; --j) {
+            //most significant bit of each byte, byte k to bit k
+            const int bitsOfBytes = _mm_movemask_epi8(x);
+            tmp[j * stride + i / 8] = uint8_t(bitsOfBytes);
+            tmp[j * stride + i / 8 + 1] = uint8_t(bitsOfBytes >> 8);
+            x = _mm_slli_epi16(x, 1);
+        }
+    }
+#endif
+    for(; i != m; i += 8) {
+        uint64_t x = 0;
+        for(size_t k = 0; k != 8; ++k) x |= uint64_t(plane[i + k]) << (8 * k);
+        x = Transpose8(x);
+        for(size_t j = 0; j != 8; ++j)
+            tmp[j * stride + i / 8] = uint8_t(x >> (8 * j));
+    }
+    memcpy(plane, tmp, m);
+}
+
+//! Inverse of \c BitShufflePlane.
+inline void BitUnshufflePlane(uint8_t* plane, size_t n, uint8_t* tmp) {
+    const size_t m = n & ~size_t(7);
+    const size_t stride = m / 8;
+    for(size_t i = 0; i != m; i += 8) {
+        uint64_t x = 0;
+        for(size_t j = 0; j != 8; ++j)
+            x |= uint64_t(plane[j * stride + i / 8]) << (8 * j);
+        x = Transpose8(x);
+        for(size_t k = 0; k != 8; ++k) tmp[i + k] = uint8_t(x >> (8 * k));
+    }
+    memcpy(plane, tmp, m);
+}
+//! @}
+
+//! \defgroup LZ codec
+//! @{
+const size_t MIN_MATCH = 4;
+const size_t LAST_LITERALS = 5;
+const size_t MF_LIMIT = 12;
+const size_t MAX_OFFSET = 0xffff;
+const unsigned HASH_LOG = 13;
+
+inline uint32_t Load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t Hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+//! Number of equal bytes at \c a and \c b, up to \c limit.
+inline size_t MatchLength(const uint8_t* a, const uint8_t* b, size_t limit) {
+    size_t n = 0;
+#if defined(__GNUC__)
+    if(endian::HostLittleEndian) {
+        for(; n + 8 <= limit; n += 8) {
+            uint64_t x, y;
+            memcpy(&x, a + n, 8);
+            memcpy(&y, b + n, 8);
+            if(x != y) return n + size_t(__builtin_ctzll(x ^ y) / 8);
+        }
+    }
+#endif
+    while(n != limit && a[n] == b[n]) ++n;
+    return n;
+}
+
+inline uint8_t* WriteLength(uint8_t* op, size_t len) {
+    for(len -= 15; len >= 255; len -= 255) *op++ = 255;
+    *op++ = uint8_t(len);
+    return op;
+}
+
+//! Write sequence; no match if \c offset is zero.
+inline uint8_t* WriteSequence(uint8_t* op, const uint8_t* literals,
+                              size_t literalLength, size_t offset,
+                              size_t matchLength) {
+    uint8_t* token = op++;
+    *token = uint8_t(std::min(literalLength, size_t(15)) << 4);
+    if(literalLength >= 15) op = WriteLength(op, literalLength);
+    memcpy(op, literals, literalLength);
+    op += literalLength;
+    if(!offset) return op;
+    *op++ = uint8_t(offset);
+    *op++ = uint8_t(offset >> 8);
+    const size_t ml = matchLength - MIN_MATCH;
+    *token |= uint8_t(std::min(ml, size_t(15)));
+    return ml >= 15 ? WriteLength(op, ml) : op;
+}
+
+//! Maximum size of \c n bytes compressed with \c LZCompress.
+inline size_t LZBound(size_t n) { return n + n / 255 + 16; }
+
+//! Compress \c n bytes, output buffer must be at least \c LZBound(n) bytes.
+//! \return number of bytes written
+inline size_t LZCompress(const uint8_t* src, size_t n, uint8_t* dst) {
+    uint8_t* op = dst;
+    size_t anchor = 0;
+    if(n > MF_LIMIT) {
+        uint32_t table[1 << HASH_LOG];
+        memset(table, 0, sizeof(table));
+        //matches start before limit and end before the last literals
+        const size_t limit = n - MF_LIMIT;
+        const size_t matchLimit = n - LAST_LITERALS;
+        size_t ip = 1;
+        size_t misses = 0;
+        while(ip < limit) {
+            const uint32_t seq = Load32(src + ip);
+            const uint32_t h = Hash(seq);
+            size_t ref = table[h];
+            table[h] = uint32_t(ip);
+            if(ip - ref > MAX_OFFSET || Load32(src + ref) != seq) {
+                //skip faster through incompressible data
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            while(ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            const size_t ml = MIN_MATCH
+                + MatchLength(src + ip + MIN_MATCH, src + ref + MIN_MATCH,
+                              matchLimit - ip - MIN_MATCH);
+            op = WriteSequence(op, src + anchor, ip - anchor, ip - ref, ml);
+            ip += ml;
+            anchor = ip;
+            misses = 0;
+            if(ip < limit) table[Hash(Load32(src + ip - 2))] = uint32_t(ip - 2);
+        }
+    }
+    op = WriteSequence(op, src + anchor, n - anchor, 0, 0);
+    return size_t(op - dst);
+}
+
+inline size_t ReadLength(const uint8_t*& in, const uint8_t* end) {
+    size_t len = 0;
+    for(;;) {
+        if(in == end) throw std::runtime_error("srz: truncated LZ data");
+        const uint8_t b = *in++;
+        len += b;
+        if(b != 255) return len;
+    }
+}
+
+//! Decompress exactly \c n bytes from [in, end); throws
+//! \c std::runtime_error on invalid data.
+inline void LZDecompress(const uint8_t* in, const uint8_t* end,
+                         uint8_t* out, size_t n) {
+    uint8_t* op = out;
+    uint8_t* const oend = out + n;
+    for(;;) {
+        if(in == end) throw std::runtime_error("srz: truncated LZ data");
+        const uint8_t token = *in++;
+        size_t lit = token >> 4;
+        if(lit == 15) lit += ReadLength(in, end);
+        if(lit > size_t(end - in) || lit > size_t(oend - op))
+            throw std::runtime_error("srz: invalid LZ literals");
+        memcpy(op, in, lit);
+        op += lit;
+        in += lit;
+        if(in == end) break;
+        if(end - in < 2) throw std::runtime_error("srz: truncated LZ data");
+        const size_t offset = size_t(in[0]) | (size_t(in[1]) << 8);
+        in += 2;
+        size_t ml = (token & 15) + MIN_MATCH;
+        if((token & 15) == 15) ml += ReadLength(in, end);
+        if(!offset || offset > size_t(op - out) || ml > size_t(oend - op))
+            throw std::runtime_error("srz: invalid LZ match");
+        const uint8_t* m = op - offset;
+        if(offset >= ml) memcpy(op, m, ml);
+        else for(size_t i = 0; i != ml; ++i) op[i] = m[i];
+        op += ml;
+    }
+    if(op != oend) throw std::runtime_error("srz: LZ size mismatch");
+}
+//! @}
+
+inline void WriteU32(uint8_t* p, uint32_t v) {
+    srz::detail::Write(p, v);
+}
+
+inline uint32_t ReadU32(const uint8_t* p) {
+    uint32_t v = 0;
+    srz::detail::Read(p, v);
+    return v;
+}
+
+//! Compress block of \c n elements, scratch buffers must be at least
+//! \c n*sizeof(T) bytes.
+//! \return pointer past compressed block
+template< typename T >
+uint8_t* CompressBlock(const T* src, size_t n, Shuffle s, uint8_t* out,
+                       uint8_t* scratch, uint8_t* filtered) {
+    const size_t w = sizeof(T);
+    const size_t bytes = n * w;
+    const uint8_t* data = reinterpret_cast< const uint8_t* >(src);
+    if(endian::SwapOnWire< T >::value) {
+        endian::CopyToWire(scratch, src, n);
+        data = scratch;
+    }
+    if(s != Shuffle::NONE) {
+        ByteShuffle(filtered, data, n, w);
+        if(s == Shuffle::BIT)
+            for(size_t b = 0; b != w; ++b)
+                BitShufflePlane(filtered + b * n, n, scratch);
+        data = filtered;
+    }
+    uint32_t size = uint32_t(LZCompress(data, bytes, out + 4));
+    if(size >= bytes) {
+        memcpy(out + 4, data, bytes);
+        size = uint32_t(bytes);
+        WriteU32(out, size | STORED);
+    } else WriteU32(out, size);
+    return out + 4 + size;
+}
+
+//! Decompress block of \c n elements from [in, end), scratch buffer must be
+//! at least \c n*sizeof(T) bytes.
+//! \return pointer past compressed block
+template< typename T >
+const uint8_t* DecompressBlock(const uint8_t* in, const uint8_t* end,
+                               T* dst, size_t n, Shuffle s,
+                               uint8_t* scratch) {
+    const size_t w = sizeof(T);
+    const size_t bytes = n * w;
+    if(end - in < 4) throw std::runtime_error("srz: truncated block");
+    const uint32_t header = ReadU32(in);
+    const size_t size = header & ~STORED;
+    in += 4;
+    if(size > size_t(end - in)) throw std::runtime_error("srz: truncated block");
+    uint8_t* out = reinterpret_cast< uint8_t* >(dst);
+    uint8_t* data = s == Shuffle::NONE ? out : scratch;
+    if(header & STORED) {
+        if(size != bytes) throw std::runtime_error("srz: invalid block size");
+        memcpy(data, in, bytes);
+    } else LZDecompress(in, in + size, data, bytes);
+    if(s == Shuffle::BIT)
+        for(size_t b = 0; b != w; ++b)
+            BitUnshufflePlane(data + b * n, n, out);
+    if(s != Shuffle::NONE) ByteUnshuffle(out, data, n, w);
+    if(endian::SwapOnWire< T >::value) endian::CopyFromWire(dst, dst, n);
+    return in + size;
+}
+
+template< typename T >
+size_t BlockElements() {
+    return std::max(BLOCK_BYTES / sizeof(T), size_t(1));
+}
+
+//! Space reserved for each compressed block before compaction.
+template< typename T >
+size_t BlockSlot() {
+    return 4 + LZBound(BlockElements< T >() * sizeof(T));
+}
+}
+
+//! Maximum compressed size of \c count elements of type \c T, excluding
+//! element count and compressed size.
+template< typename T >
+size_t MaxCompressedSize(size_t count) {
+    const size_t be = detail::BlockElements< T >();
+    return HEADER_SIZE + (count + be - 1) / be * detail::BlockSlot< T >();
+}
+
+//! Compress \c count elements; the output buffer must be at least
+//! \c MaxCompressedSize< T >(count) bytes. Blocks are compressed by up to
+//! \c threads threads into separate slots of the output buffer, then moved
+//! next to each other.
+//! \return pointer past compressed data
+template< typename T >
+uint8_t* Compress(const T* data, size_t count, Shuffle s, unsigned threads,
+                  uint8_t* out) {
+    static_assert(std::is_pod< T >::value, "POD type required");
+    const size_t be = detail::BlockElements< T >();
+    const size_t blocks = (count + be - 1) / be;
+    const size_t slot = detail::BlockSlot< T >();
+    out[0] = uint8_t(sizeof(T));
+    out[1] = uint8_t(s);
+    detail::WriteU32(out + 2, uint32_t(be));
+    uint8_t* first = out + HEADER_SIZE;
+    auto worker = [=](size_t b, size_t step) {
+        std::vector< uint8_t > scratch(2 * be * sizeof(T));
+        for(; b < blocks; b += step) {
+            const size_t n = std::min(be, count - b * be);
+            detail::CompressBlock(data + b * be, n, s, first + b * slot,
+                                  scratch.data(),
+                                  scratch.data() + be * sizeof(T));
+        }
+    };
+    const size_t nt = std::max(size_t(1), std::min(size_t(threads), blocks));
+    std::vector< std::thread > pool;
+    for(size_t t = 1; t < nt; ++t) pool.push_back(std::thread(worker, t, nt));
+    worker(0, nt);
+    for(auto& t: pool) t.join();
+    uint8_t* op = first;
+    for(size_t b = 0; b != blocks; ++b) {
+        const uint8_t* block = first + b * slot;
+        const size_t size = 4 + (detail::ReadU32(block) & ~STORED);
+        memmove(op, block, size);
+        op += size;
+    }
+    return op;
+}
+
+//! Decompress \c count elements from [in, end); throws
+//! \c std::runtime_error if the data is invalid or not compressed from
+//! elements of type \c T.
+//! \return pointer past compressed data
+template< typename T >
+const uint8_t* Decompress(const uint8_t* in, const uint8_t* end, T* dst,
+                          size_t count) {
+    if(size_t(end - in) < HEADER_SIZE)
+        throw std::runtime_error("srz: truncated compressed data");
+    if(in[0] != sizeof(T)) throw std::runtime_error("srz: element size");
+    if(in[1] > uint8_t(Shuffle::BIT))
+        throw std::runtime_error("srz: unknown shuffle");
+    const Shuffle s = Shuffle(in[1]);
+    const size_t be = detail::ReadU32(in + 2);
+    if(!be && count) throw std::runtime_error("srz: invalid block size");
+    in += HEADER_SIZE;
+    std::vector< uint8_t > scratch(std::min(be, count) * sizeof(T));
+    for(size_t i = 0; i < count; i += be) {
+        const size_t n = std::min(be, count - i);
+        in = detail::DecompressBlock(in, end, dst + i, n, s, scratch.data());
+    }
+    return in;
+}
+//! Check \c count elements compressed in [in, end) without decompressing
+//! them: header, size of each block against the data and against the
+//! uncompressed block size; LZ data expands at most 255:1, one length byte
+//! adding up to 255 bytes to a match. Used to reject data of untrusted
+//! sources before allocating the elements.
+//! \return pointer past compressed data, \c nullptr if invalid
+template< typename T >
+const uint8_t* ValidateBlocks(const uint8_t* in, const uint8_t* end,
+                              size_t count) {
+    if(size_t(end - in) < HEADER_SIZE || in[0] != sizeof(T)
+       || in[1] > uint8_t(Shuffle::BIT))
+        return nullptr;
+    const size_t be = detail::ReadU32(in + 2);
+    if(!be && count) return nullptr;
+    in += HEADER_SIZE;
+    //each block takes at least 4 bytes: at most (end - in) / 4 iterations
+    for(size_t i = 0; i < count; i += be) {
+        if(end - in < 4) return nullptr;
+        const uint32_t header = detail::ReadU32(in);
+        const size_t size = header & ~STORED;
+        in += 4;
+        if(size > size_t(end - in)) return nullptr;
+        const size_t bytes = std::min(be, count - i) * sizeof(T);
+        if(header & STORED ? size != bytes : bytes / 255 > size)
+            return nullptr;
+        in += size;
+    }
+    return in;
+}
+}
+
+//! Array of POD elements compressed when serialized: a view over existing
+//! data when packing, owning the decompressed elements when unpacked.
+template< typename T >
+class Compressed {
+public:
+    using value_type = T;
+    using const_iterator = const T*;
+    Compressed() : data_(nullptr), size_(0) {}
+    Compressed(const T* data, size_t size,
+               Shuffle shuffle = Shuffle::BYTE, unsigned threads = 1)
+        : data_(data), size_(size), shuffle_(shuffle), threads_(threads) {}
+    Compressed(const std::vector< T >& v,
+               Shuffle shuffle = Shuffle::BYTE, unsigned threads = 1)
+        : Compressed(v.data(), v.size(), shuffle, threads) {}
+    const T* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    //! Shuffle filter applied before compression.
+    Shuffle ShuffleMode() const { return shuffle_; }
+    //! Number of threads used for compression.
+    unsigned Threads() const { return threads_; }
+    //! Copy elements into new vector.
+    std::vector< T > ToVector() const {
+        return std::vector< T >(begin(), end());
+    }
+    //! Create object owning the values.
+    static Compressed Own(std::vector< T >&& values) {
+        Compressed c;
+        c.values_ = std::make_shared< std::vector< T > >(std::move(values));
+        c.data_ = c.values_->data();
+        c.size_ = c.values_->size();
+        return c;
+    }
+private:
+    const T* data_;
+    size_t size_;
+    Shuffle shuffle_ = Shuffle::BYTE;
+    unsigned threads_ = 1;
+    std::shared_ptr< std::vector< T > > values_;
+};
+
+//! Select compression at \c Pack time.
+template< typename T >
+Compressed< T > AsCompressed(const std::vector< T >& v,
+                             Shuffle shuffle = Shuffle::BYTE,
+                             unsigned threads = 1) {
+    return Compressed< T >(v, shuffle, threads);
+}
+
+//! Serialize \c Compressed arrays: element count, compressed size,
+//! compressed data.
+template< typename T >
+struct SerializeCompressed {
+    using C = Compressed< T >;
+    static ByteArray Pack(const C& d, ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const C& d, IteratorT i) {
+        i = detail::Write(i, Size(d.Size()));
+        uint8_t* begin = reinterpret_cast< uint8_t* >(&*i) + sizeof(Size);
+        uint8_t* end = compress::Compress(d.Data(), d.Size(), d.ShuffleMode(),
+                                          d.Threads(), begin);
+        detail::Write(i, Size(end - begin));
+        return i + sizeof(Size) + (end - begin);
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, C& d) {
+        Size n = 0;
+        Size bytes = 0;
+        i = detail::Read(detail::Read(i, n), bytes);
+        std::vector< T > v(n);
+        const uint8_t* begin = reinterpret_cast< const uint8_t* >(&*i);
+        if(compress::Decompress(begin, begin + bytes, v.data(), n)
+           != begin + bytes)
+            throw std::runtime_error("srz: compressed size mismatch");
+        d = C::Own(std::move(v));
+        return i + bytes;
+    }
+    //! Check sizes and block headers: the element count must match the
+    //! blocks, each block bounded by the maximum LZ expansion, so that
+    //! unpacking never allocates more than 255 times the size of the data;
+    //! block contents are checked while decompressing.
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        size_t n = 0, bytes = 0;
+        p = detail::ReadSize(detail::ReadSize(p, end, n), end, bytes);
+        if(!p || bytes > size_t(end - p)) return nullptr;
+        const uint8_t* b = reinterpret_cast< const uint8_t* >(p);
+        return compress::ValidateBlocks< T >(b, b + bytes, n) == b + bytes
+               ? p + bytes : nullptr;
+    }
+    //! Upper bound of serialized size.
+    static size_t Sizeof(const C& d) {
+        return 2 * sizeof(Size) + compress::MaxCompressedSize< T >(d.Size());
+    }
+};
+
+//! Select serializer for \c Compressed.
+template< typename T >
+struct GetSerializer< Compressed< T > > {
+    using Type = SerializeCompressed< T >;
+};
+
+//! Select serializer for \c [const Compressed].
+template< typename T >
+struct GetSerializer< const Compressed< T > > {
+    using Type = SerializeCompressed< T >;
+};
+
+}
@@ -0,0 +1,204 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Endian.h
+//! \brief Byte order conversion between host and wire format.
+//!
+//! When \c SRZ_WIRE_LE is defined arithmetic and enum values are written in
+//! little-endian order regardless of the host byte order; otherwise data is
+//! written in host order. On little-endian hosts the conversion is a plain
+//! copy; on big-endian hosts arrays are converted with a vectorized byte
+//! swap (SSSE3 or NEON when available, scalar loop otherwise).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(SRZ_BIG_ENDIAN_HOST)
+#define SRZ_HOST_LE_ 0
+#elif defined(SRZ_LITTLE_ENDIAN_HOST) || defined(_WIN32)
+#define SRZ_HOST_LE_ 1
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+#define SRZ_HOST_LE_ (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#else
+#error "Cannot detect host byte order: define SRZ_LITTLE_ENDIAN_HOST or \
+SRZ_BIG_ENDIAN_HOST"
+#endif
+
+namespace srz {
+//! Byte order conversion.
+namespace endian {
+
+//! \c true if host is little-endian.
+const bool HostLittleEndian = SRZ_HOST_LE_;
+
+//! \c value is \c true for types whose byte order can be reversed:
+//! arithmetic and enum types of size 2, 4 or 8.
+template< typename T >
+struct Swappable {
+    static const bool value = (std::is_arithmetic< T >::value
+                               || std::is_enum< T >::value)
+                              && (sizeof(T) == 2 || sizeof(T) == 4
+                                  || sizeof(T) == 8);
+};
+
+//! \c value is \c true if values of type \c T are byte swapped when
+//! written to or read from the wire.
+template< typename T >
+struct SwapOnWire {
+#ifdef SRZ_WIRE_LE
+    static const bool value = !HostLittleEndian && Swappable< T >::value;
+#else
+    static const bool value = false;
+#endif
+};
+
+namespace detail {
+inline uint16_t Swap(uint16_t v) {
+#if defined(__GNUC__)
+    return __builtin_bswap16(v);
+#else
+    return uint16_t((v >> 8) | (v << 8));
+#endif
+}
+
+inline uint32_t Swap(uint32_t v) {
+#if defined(__GNUC__)
+    return __builtin_bswap32(v);
+#else
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000)
+           | (v << 24);
+#endif
+}
+
+inline uint64_t Swap(uint64_t v) {
+#if defined(__GNUC__)
+    return __builtin_bswap64(v);
+#else
+    return (uint64_t(Swap(uint32_t(v))) << 32) | Swap(uint32_t(v >> 32));
+#endif
+}
+
+//! Reverse bytes of \c count elements of type \c U, scalar loop.
+template< typename U >
+void SwapElements(uint8_t* dst, const uint8_t* src, size_t count) {
+    for(size_t i = 0; i != count; ++i) {
+        U v;
+        memcpy(&v, src + i * sizeof(U), sizeof(U));
+        v = Swap(v);
+        memcpy(dst + i * sizeof(U), &v, sizeof(U));
+    }
+}
+
+//! Reverse bytes of elements of size \c width, scalar implementation.
+inline void ByteSwapScalar(uint8_t* dst, const uint8_t* src,
+                           size_t count, size_t width) {
+    switch(width) {
+    case 2: SwapElements< uint16_t >(dst, src, count); break;
+    case 4: SwapElements< uint32_t >(dst, src, count); break;
+    case 8: SwapElements< uint64_t >(dst, src, count); break;
+    default: if(dst != src) memmove(dst, src, count * width);
+    }
+}
+
+//! Reverse bytes of elements of size \c width in blocks of 16 bytes.
+//! \return number of bytes processed
+inline size_t ByteSwapSIMD(uint8_t* dst, const uint8_t* src,
+                           size_t bytes, size_t width) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    __m128i mask;
+    switch(width) {
+    case 2: mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                                 9, 8, 11, 10, 13, 12, 15, 14); break;
+    case 4: mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                 11, 10, 9, 8, 15, 14, 13, 12); break;
+    case 8: mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                                 15, 14, 13, 12, 11, 10, 9, 8); break;
+    default: return 0;
+    }
+    for(; i + 16 <= bytes; i += 16) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast< const __m128i* >(src + i));
+        _mm_storeu_si128(reinterpret_cast< __m128i* >(dst + i),
+                         _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(__ARM_NEON)
+    if(width != 2 && width != 4 && width != 8) return 0;
+    for(; i + 16 <= bytes; i += 16) {
+        const uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u8(dst + i, width == 2 ? vrev16q_u8(v)
+                          : width == 4 ? vrev32q_u8(v) : vrev64q_u8(v));
+    }
+#else
+    (void) dst; (void) src; (void) bytes; (void) width;
+#endif
+    return i;
+}
+}
+
+//! Reverse the bytes of \c count elements of \c width bytes each;
+//! \c dst and \c src can be the same buffer but must not partially
+//! overlap.
+inline void ByteSwap(void* dst, const void* src, size_t count,
+                     size_t width) {
+    uint8_t* d = static_cast< uint8_t* >(dst);
+    const uint8_t* s = static_cast< const uint8_t* >(src);
+    const size_t done = detail::ByteSwapSIMD(d, s, count * width, width);
+    detail::ByteSwapScalar(d + done, s + done, count - done / width, width);
+}
+
+//! Write value to unaligned memory in wire byte order.
+template< typename T >
+void StoreWire(void* dst, const T& v) {
+    if(SwapOnWire< T >::value) ByteSwap(dst, &v, 1, sizeof(T));
+    else memmove(dst, static_cast< const void* >(&v), sizeof(T));
+}
+
+//! Read value in wire byte order from unaligned memory.
+template< typename T >
+void LoadWire(T& v, const void* src) {
+    if(SwapOnWire< T >::value) ByteSwap(&v, src, 1, sizeof(T));
+    else memmove(static_cast< void* >(&v), src, sizeof(T));
+}
+
+//! Write array to memory in wire byte order.
+template< typename T >
+void CopyToWire(void* dst, const T* src, size_t count) {
+    if(!count) return;
+    if(SwapOnWire< T >::value) ByteSwap(dst, src, count, sizeof(T));
+    else memmove(dst, static_cast< const void* >(src), count * sizeof(T));
+}
+
+//! Read array in wire byte order from memory.
+template< typename T >
+void CopyFromWire(T* dst, const void* src, size_t count) {
+    if(!count) return;
+    if(SwapOnWire< T >::value) ByteSwap(dst, src, count, sizeof(T));
+    else memmove(static_cast< void* >(dst), src, count * sizeof(T));
+}
+
+}
+}
+
+#undef SRZ_HOST_LE_
@@ -0,0 +1,217 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Fields.h
+//! \brief Declarative field lists for user structs.
+//!
+//! \code
+//! struct Particle { int32_t id; float x, y, z; std::string name; };
+//! SRZ_FIELDS(Particle, id, x, y, z, name)
+//! \endcode
+//! declares, in the namespace of the struct, the functions
+//! \c SrzFields(T&) and \c SrzFields(const T&) returning a tuple of
+//! references to the fields, and \c SrzFieldNames(const T*). Types with a
+//! field list are serialized field by field by \c SerializeFields, in
+//! declaration order and without padding: if all the fields have a fixed
+//! serialized size so does the struct and the field offsets are
+//! compile-time constants, see \c FieldOffset.
+//! The macro must be used at namespace scope, in the namespace of the type;
+//! up to 24 fields are supported.
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Serialize.h"
+
+//! \defgroup Field list macros
+//! @{
+#define SRZ_PP_CAT_(a, b) a##b
+#define SRZ_PP_CAT(a, b) SRZ_PP_CAT_(a, b)
+#define SRZ_PP_NARG(...) SRZ_PP_NARG_(__VA_ARGS__, SRZ_PP_RSEQ_())
+#define SRZ_PP_NARG_(...) SRZ_PP_ARG_N_(__VA_ARGS__)
+#define SRZ_PP_ARG_N_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+    _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, N, ...) N
+#define SRZ_PP_RSEQ_() 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, \
+    12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+
+//map macro over arguments, comma separated
+#define SRZ_PP_MAP(m, ...) \
+    SRZ_PP_CAT(SRZ_PP_MAP_, SRZ_PP_NARG(__VA_ARGS__))(m, __VA_ARGS__)
+#define SRZ_PP_MAP_1(m, x) m(x)
+#define SRZ_PP_MAP_2(m, x, ...) m(x), SRZ_PP_MAP_1(m, __VA_ARGS__)
+#define SRZ_PP_MAP_3(m, x, ...) m(x), SRZ_PP_MAP_2(m, __VA_ARGS__)
+#define SRZ_PP_MAP_4(m, x, ...) m(x), SRZ_PP_MAP_3(m, __VA_ARGS__)
+#define SRZ_PP_MAP_5(m, x, ...) m(x), SRZ_PP_MAP_4(m, __VA_ARGS__)
+#define SRZ_PP_MAP_6(m, x, ...) m(x), SRZ_PP_MAP_5(m, __VA_ARGS__)
+#define SRZ_PP_MAP_7(m, x, ...) m(x), SRZ_PP_MAP_6(m, __VA_ARGS__)
+#define SRZ_PP_MAP_8(m, x, ...) m(x), SRZ_PP_MAP_7(m, __VA_ARGS__)
+#define SRZ_PP_MAP_9(m, x, ...) m(x), SRZ_PP_MAP_8(m, __VA_ARGS__)
+#define SRZ_PP_MAP_10(m, x, ...) m(x), SRZ_PP_MAP_9(m, __VA_ARGS__)
+#define SRZ_PP_MAP_11(m, x, ...) m(x), SRZ_PP_MAP_10(m, __VA_ARGS__)
+#define SRZ_PP_MAP_12(m, x, ...) m(x), SRZ_PP_MAP_11(m, __VA_ARGS__)
+#define SRZ_PP_MAP_13(m, x, ...) m(x), SRZ_PP_MAP_12(m, __VA_ARGS__)
+#define SRZ_PP_MAP_14(m, x, ...) m(x), SRZ_PP_MAP_13(m, __VA_ARGS__)
+#define SRZ_PP_MAP_15(m, x, ...) m(x), SRZ_PP_MAP_14(m, __VA_ARGS__)
+#define SRZ_PP_MAP_16(m, x, ...) m(x), SRZ_PP_MAP_15(m, __VA_ARGS__)
+#define SRZ_PP_MAP_17(m, x, ...) m(x), SRZ_PP_MAP_16(m, __VA_ARGS__)
+#define SRZ_PP_MAP_18(m, x, ...) m(x), SRZ_PP_MAP_17(m, __VA_ARGS__)
+#define SRZ_PP_MAP_19(m, x, ...) m(x), SRZ_PP_MAP_18(m, __VA_ARGS__)
+#define SRZ_PP_MAP_20(m, x, ...) m(x), SRZ_PP_MAP_19(m, __VA_ARGS__)
+#define SRZ_PP_MAP_21(m, x, ...) m(x), SRZ_PP_MAP_20(m, __VA_ARGS__)
+#define SRZ_PP_MAP_22(m, x, ...) m(x), SRZ_PP_MAP_21(m, __VA_ARGS__)
+#define SRZ_PP_MAP_23(m, x, ...) m(x), SRZ_PP_MAP_22(m, __VA_ARGS__)
+#define SRZ_PP_MAP_24(m, x, ...) m(x), SRZ_PP_MAP_23(m, __VA_ARGS__)
+
+#define SRZ_FIELD_REF_(f) srzObject_.f
+#define SRZ_FIELD_NAME_(f) #f
+
+//! Declare serialized fields of type \c T, in order.
+#define SRZ_FIELDS(T, ...) \
+    inline auto SrzFields(T& srzObject_) \
+        -> decltype(std::tie(SRZ_PP_MAP(SRZ_FIELD_REF_, __VA_ARGS__))) { \
+        return std::tie(SRZ_PP_MAP(SRZ_FIELD_REF_, __VA_ARGS__)); \
+    } \
+    inline auto SrzFields(const T& srzObject_) \
+        -> decltype(std::tie(SRZ_PP_MAP(SRZ_FIELD_REF_, __VA_ARGS__))) { \
+        return std::tie(SRZ_PP_MAP(SRZ_FIELD_REF_, __VA_ARGS__)); \
+    } \
+    inline const std::vector< std::string >& SrzFieldNames(const T*) { \
+        static const std::vector< std::string > names = { \
+            SRZ_PP_MAP(SRZ_FIELD_NAME_, __VA_ARGS__)}; \
+        return names; \
+    }
+//! @}
+
+namespace srz {
+
+namespace detail {
+//! Field types of type with field list, references and cv removed.
+template< typename T >
+struct FieldTypes;
+
+template< typename... ArgsT >
+struct FieldTypes< std::tuple< ArgsT&... > > {
+    using Type = std::tuple< typename std::remove_cv< ArgsT >::type... >;
+};
+
+//! Fields tuple type.
+template< typename T >
+using FieldsTuple = typename FieldTypes< decltype(
+    SrzFields(std::declval< T& >())) >::Type;
+
+//! Compile-time serialized sizes of tuple elements.
+template< typename TupleT >
+struct TupleStaticSizeof;
+
+template< typename... ArgsT >
+struct TupleStaticSizeof< std::tuple< ArgsT... > >
+    : StaticSizeof< ArgsT... > {};
+
+//! Offset of element \c I if all the previous elements have fixed size.
+template< typename TupleT, size_t I >
+struct TupleOffset {
+    using Prev = typename std::tuple_element< I - 1, TupleT >::type;
+    static const size_t Size = StaticSizeof< Prev >::Value;
+    static const bool Fixed =
+        StaticSizeof< Prev >::Fixed && TupleOffset< TupleT, I - 1 >::Fixed;
+    static const size_t Value =
+        Fixed ? TupleOffset< TupleT, I - 1 >::Value + Size : 0;
+};
+
+template< typename TupleT >
+struct TupleOffset< TupleT, 0 > {
+    static const bool Fixed = true;
+    static const size_t Value = 0;
+};
+
+template< typename IteratorT, typename TupleT, size_t... Is >
+IteratorT PackFields(IteratorT i, const TupleT& t, const Seq< Is... >&) {
+    return PackTo(i, std::get< Is >(t)...);
+}
+
+//! Validate serialized tuple elements.
+template< typename TupleT >
+struct ValidateTuple;
+
+template< typename... ArgsT >
+struct ValidateTuple< std::tuple< ArgsT... > > : ValidateArgs< ArgsT... > {};
+
+template< typename TupleT, size_t... Is >
+size_t SizeofFields(const TupleT& t, const Seq< Is... >&) {
+    return SizeofArgs(std::get< Is >(t)...);
+}
+}
+
+//! Serialize struct declared with \c SRZ_FIELDS, field by field.
+template< typename T >
+struct SerializeFields {
+    using Fields = detail::FieldsTuple< T >;
+    using Indices =
+        typename detail::GenSeq< std::tuple_size< Fields >::value >::Type;
+    static ByteArray Pack(const T& d, ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const T& d, IteratorT i) {
+        return detail::PackFields(i, SrzFields(d), Indices());
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, T& d) {
+        return detail::UnPackElements(i, SrzFields(d), Indices());
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return detail::TupleStaticSizeof< Fields >::Fixed
+               ? detail::Skip(p, end, detail::TupleStaticSizeof< Fields >::Value)
+               : detail::ValidateTuple< Fields >::Check(p, end);
+    }
+    //! Size of serialized data, constant if all the fields have fixed size.
+    static size_t Sizeof(const T& d) {
+        return detail::TupleStaticSizeof< Fields >::Fixed
+               ? size_t(detail::TupleStaticSizeof< Fields >::Value)
+               : detail::SizeofFields(SrzFields(d), Indices());
+    }
+};
+
+namespace detail {
+template< typename T >
+struct StaticSize< SerializeFields< T > > {
+    static const size_t Value = TupleStaticSizeof< FieldsTuple< T > >::Value;
+};
+}
+
+//! Compile-time offset of field \c I in serialized struct \c T: \c Fixed is
+//! \c true if all the previous fields have a fixed size.
+template< typename T, size_t I >
+struct FieldOffset : detail::TupleOffset< detail::FieldsTuple< T >, I > {};
+
+//! Number of fields of type declared with \c SRZ_FIELDS.
+template< typename T >
+struct FieldCount
+    : std::tuple_size< detail::FieldsTuple< T > > {};
+
+//! Field names of type declared with \c SRZ_FIELDS.
+template< typename T >
+const std::vector< std::string >& FieldNames() {
+    return SrzFieldNames(static_cast< const T* >(nullptr));
+}
+
+}
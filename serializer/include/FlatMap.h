@@ -0,0 +1,228 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file FlatMap.h
+//! \brief Sorted associative container stored as an array of keys and an
+//! array of values.
+//!
+//! \c FlatMap has the same wire layout as \c std::map and
+//! \c std::unordered_map with the same key and value types, data packed
+//! from any of them can be unpacked into any other:
+//! \code
+//! std::map< int, float > m = ...;
+//! srz::FlatMap< int, float > f;
+//! srz::UnPack(srz::Pack(m), f);
+//! const float* v = f.Find(3);
+//! \endcode
+//! With POD keys and values packing and unpacking copy the two arrays,
+//! unpacking into an existing object reuses its memory. Lookup is a binary
+//! search.
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Serialize.h"
+
+namespace srz {
+
+template< typename K, typename V >
+struct SerializeFlatMap;
+
+//! Map with keys sorted in a contiguous array and values stored in a
+//! parallel array.
+template< typename K, typename V >
+class FlatMap {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    FlatMap() = default;
+    //! Build from unsorted key, value pairs; for duplicate keys the first
+    //! value is kept.
+    explicit FlatMap(const std::vector< std::pair< K, V > >& items) {
+        Reserve(items.size());
+        for(auto& i: items) {
+            keys_.push_back(i.first);
+            values_.push_back(i.second);
+        }
+        Normalize();
+    }
+    size_t Size() const { return keys_.size(); }
+    bool Empty() const { return keys_.empty(); }
+    //! Sorted keys.
+    const std::vector< K >& Keys() const { return keys_; }
+    //! Values, \c Values()[i] is the value of \c Keys()[i].
+    const std::vector< V >& Values() const { return values_; }
+    const K& Key(size_t i) const { return keys_[i]; }
+    const V& Value(size_t i) const { return values_[i]; }
+    V& Value(size_t i) { return values_[i]; }
+    //! Return pointer to value or \c nullptr if key not found.
+    const V* Find(const K& key) const {
+        const size_t i = Index(key);
+        return i != Size() && !(key < keys_[i]) ? &values_[i] : nullptr;
+    }
+    V* Find(const K& key) {
+        return const_cast< V* >(static_cast< const FlatMap& >(*this).Find(key));
+    }
+    //! Return value, inserting default constructed value if key not found;
+    //! insertion is O(n).
+    V& operator[](const K& key) {
+        const size_t i = Index(key);
+        if(i == Size() || key < keys_[i]) {
+            keys_.insert(keys_.begin() + i, key);
+            values_.insert(values_.begin() + i, V());
+        }
+        return values_[i];
+    }
+    void Clear() {
+        keys_.clear();
+        values_.clear();
+    }
+    void Reserve(size_t n) {
+        keys_.reserve(n);
+        values_.reserve(n);
+    }
+private:
+    friend struct SerializeFlatMap< K, V >;
+    //! Index of first key not less than \c key.
+    size_t Index(const K& key) const {
+        return size_t(std::lower_bound(keys_.begin(), keys_.end(), key)
+                      - keys_.begin());
+    }
+    //! Sort by key and remove duplicates, keeping the first value; no-op
+    //! for sorted keys.
+    void Normalize() {
+        auto greaterEq = [](const K& a, const K& b) { return !(a < b); };
+        if(std::adjacent_find(keys_.begin(), keys_.end(), greaterEq)
+           == keys_.end())
+            return;
+        std::vector< size_t > order(keys_.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(),
+                         [this](size_t a, size_t b) {
+                             return keys_[a] < keys_[b];
+                         });
+        std::vector< K > keys;
+        std::vector< V > values;
+        keys.reserve(order.size());
+        values.reserve(order.size());
+        for(size_t i: order) {
+            if(!keys.empty() && !(keys.back() < keys_[i])) continue;
+            keys.push_back(std::move(keys_[i]));
+            values.push_back(std::move(values_[i]));
+        }
+        keys_.swap(keys);
+        values_.swap(values);
+    }
+    std::vector< K > keys_;
+    std::vector< V > values_;
+};
+
+//! Serialize \c FlatMap with the layout of \c SerializeMap: keys array
+//! followed by values array for POD types, key, value pairs otherwise.
+//! Unpacked data is sorted if not already in key order.
+template< typename K, typename V >
+struct SerializeFlatMap {
+    using M = FlatMap< K, V >;
+    using KS = typename GetSerializer< K >::Type;
+    using VS = typename GetSerializer< V >::Type;
+    using Flat = std::integral_constant< bool,
+                                         detail::FlatMapLayout< K, V >::value >;
+    static ByteArray Pack(const M& m, ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(m));
+        buf.resize(Pack(m, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const M& m, IteratorT i) {
+        return Pack(m, i, Flat());
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, M& m) {
+        i = UnPack(i, m, Flat());
+        m.Normalize();
+        return i;
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return SerializeMap< K, V >::Validate(p, end);
+    }
+    //! Compute size of serialized data; upper bound if
+    //! \c SRZ_WIRE_ALIGNED is defined
+    static size_t Sizeof(const M& m) {
+        if(Flat::value)
+            return 2 * sizeof(Size) + detail::MaxPad< K >()
+                   + detail::MaxPad< V >() + m.Size() * (sizeof(K) + sizeof(V));
+        size_t size = sizeof(Size);
+        for(size_t i = 0; i != m.Size(); ++i)
+            size += KS::Sizeof(m.Key(i)) + VS::Sizeof(m.Value(i));
+        return size;
+    }
+private:
+    template< typename IteratorT >
+    static IteratorT Pack(const M& m, IteratorT i, std::true_type) {
+        i = detail::WriteArray(i, m.keys_.data(), m.Size());
+        return detail::WriteArray(i, m.values_.data(), m.Size());
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const M& m, IteratorT i, std::false_type) {
+        i = detail::Write(i, Size(m.Size()));
+        for(size_t k = 0; k != m.Size(); ++k)
+            i = VS::Pack(m.Value(k), KS::Pack(m.Key(k), i));
+        return i;
+    }
+    template< typename T, typename IteratorT >
+    static IteratorT ReadArray(IteratorT i, std::vector< T >& v) {
+        Size n = 0;
+        i = detail::SkipPad(detail::Read(i, n));
+        v.resize(size_t(n));
+        endian::CopyFromWire(v.data(), &*i, v.size());
+        return i + n * sizeof(T);
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, M& m, std::true_type) {
+        i = ReadArray(ReadArray(i, m.keys_), m.values_);
+        if(m.keys_.size() != m.values_.size())
+            throw std::runtime_error("srz: map size mismatch");
+        return i;
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, M& m, std::false_type) {
+        Size n = 0;
+        i = detail::Read(i, n);
+        m.keys_.resize(size_t(n));
+        m.values_.resize(size_t(n));
+        for(size_t k = 0; k != m.Size(); ++k)
+            i = VS::UnPack(KS::UnPack(i, m.keys_[k]), m.values_[k]);
+        return i;
+    }
+};
+
+//! Select serializer for \c FlatMap.
+template< typename K, typename V >
+struct GetSerializer< FlatMap< K, V > > {
+    using Type = SerializeFlatMap< K, V >;
+};
+
+//! Select serializer for \c [const FlatMap].
+template< typename K, typename V >
+struct GetSerializer< const FlatMap< K, V > > {
+    using Type = SerializeFlatMap< K, V >;
+};
+
+}
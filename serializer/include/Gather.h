@@ -0,0 +1,228 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Gather.h
+//! \brief Scatter/gather serialization.
+//!
+//! \c PackGather serializes data into a list of memory segments instead of
+//! a contiguous buffer: small data is serialized inline into storage owned
+//! by the \c GatherBuffer, the payload of large POD vectors and strings is
+//! referenced in place. The concatenation of all the segments is identical
+//! to the output of \c Pack; with \c SRZ_WIRE_ALIGNED defined this holds
+//! for top-level arrays only, the padding of nested arrays copied inline
+//! may differ but is still decoded correctly.
+//! @warning referenced data must stay alive and unmodified until the
+//! segments have been consumed; use @c GatherBuffer::Hold() to tie the
+//! lifetime of the data to the lifetime of the buffer.
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Serialize.h"
+#include "Sinks.h"
+
+namespace srz {
+
+//! List of inline and referenced memory segments.
+//! Implements the sink interface for inline data.
+class GatherBuffer {
+public:
+    //! Memory segment: address and size in bytes.
+    using Segment = std::pair< const void*, size_t >;
+    //! Constructor.
+    //! \param threshold minimum size in bytes of payloads referenced
+    //! instead of copied
+    explicit GatherBuffer(size_t threshold = 0x10000)
+        : threshold_(threshold), size_(0), pending_(0) {}
+    GatherBuffer(const GatherBuffer&) = delete;
+    GatherBuffer& operator=(const GatherBuffer&) = delete;
+    //! Sink interface: reserve inline storage.
+    Byte* Reserve(size_t n) {
+        pending_ = inline_.size();
+        inline_.resize(pending_ + n);
+        return inline_.data() + pending_;
+    }
+    //! Sink interface: commit inline data written after @c Reserve().
+    void Commit(size_t n) {
+        inline_.resize(pending_ + n);
+        size_ += n;
+        if(!pieces_.empty() && !pieces_.back().ptr
+           && pieces_.back().offset + pieces_.back().size == pending_) {
+            pieces_.back().size += n;
+        } else if(n) {
+            pieces_.push_back(Piece{nullptr, pending_, n});
+        }
+    }
+    //! Add reference to external memory.
+    void Reference(const void* p, size_t n) {
+        if(!n) return;
+        pieces_.push_back(Piece{p, 0, n});
+        size_ += n;
+    }
+    //! Keep object alive as long as this buffer is alive.
+    void Hold(std::shared_ptr< const void > owner) {
+        owners_.push_back(std::move(owner));
+    }
+    //! Minimum size of referenced payloads.
+    size_t Threshold() const { return threshold_; }
+    //! Total size in bytes.
+    size_t Size() const { return size_; }
+    //! Number of bytes copied inline.
+    size_t InlineSize() const { return inline_.size(); }
+    //! Segments in order; inline segments are invalidated by further
+    //! packing.
+    std::vector< Segment > Segments() const {
+        std::vector< Segment > s;
+        s.reserve(pieces_.size());
+        for(auto& p: pieces_) {
+            s.push_back(Segment(p.ptr ? p.ptr : inline_.data() + p.offset,
+                                p.size));
+        }
+        return s;
+    }
+    //! Concatenate segments into contiguous buffer.
+    ByteArray Flatten() const {
+        ByteArray b(size_);
+        Byte* out = b.data();
+        for(auto& s: Segments()) {
+            memmove(out, s.first, s.second);
+            out += s.second;
+        }
+        return b;
+    }
+    //! Remove all segments and held objects.
+    void Clear() {
+        inline_.clear();
+        pieces_.clear();
+        owners_.clear();
+        size_ = 0;
+    }
+private:
+    //! Segment: inline at @c offset if @c ptr is null, external otherwise.
+    struct Piece {
+        const void* ptr;
+        size_t offset;
+        size_t size;
+    };
+private:
+    size_t threshold_;
+    size_t size_;
+    size_t pending_;
+    ByteArray inline_;
+    std::vector< Piece > pieces_;
+    std::vector< std::shared_ptr< const void > > owners_;
+};
+
+namespace detail {
+//! Add array payload: referenced if larger than the buffer threshold and
+//! already in wire byte order, copied inline otherwise.
+template< typename T >
+void GatherPayload(GatherBuffer& g, const T* data, size_t count) {
+    const size_t bytes = count * sizeof(T);
+    if(bytes >= g.Threshold() && !endian::SwapOnWire< T >::value) {
+        g.Reference(data, bytes);
+    } else if(bytes) {
+        endian::CopyToWire(g.Reserve(bytes), data, count);
+        g.Commit(bytes);
+    }
+}
+
+//! Serialize POD array: length and padding inline, payload inline or
+//! referenced depending on size; padding is computed from the offset in the
+//! message since the final address of the payload is not known.
+template< typename T >
+void GatherArray(GatherBuffer& g, const T* data, size_t count) {
+    Pack(g, Size(count));
+    if(WireAligned) {
+        const size_t pad = PadCount< T >(g.Size());
+        Byte* p = g.Reserve(1 + pad);
+        p[0] = Byte(pad);
+        memset(p + 1, 0, pad);
+        g.Commit(1 + pad);
+    }
+    GatherPayload(g, data, count);
+}
+
+//! Serialize string: length inline, characters inline or referenced.
+inline void GatherString(GatherBuffer& g, const char* data, size_t count) {
+    Pack(g, Size(count));
+    GatherPayload(g, data, count);
+}
+
+//! Gather serialization: default, inline.
+template< typename T, typename Enable = void >
+struct GatherPack {
+    static void Pack(GatherBuffer& g, const T& d) { srz::Pack(g, d); }
+};
+
+//! Gather serialization of POD vector.
+template< typename T >
+struct GatherPack< std::vector< T >,
+                   typename std::enable_if<
+                       std::is_pod< T >::value >::type > {
+    static void Pack(GatherBuffer& g, const std::vector< T >& d) {
+        GatherArray(g, d.data(), d.size());
+    }
+};
+
+//! Gather serialization of POD array view.
+template< typename T >
+struct GatherPack< ArrayView< T > > {
+    static void Pack(GatherBuffer& g, const ArrayView< T >& d) {
+        GatherArray(g, d.Data(), d.Size());
+    }
+};
+
+//! Gather serialization of string.
+template<>
+struct GatherPack< std::string > {
+    static void Pack(GatherBuffer& g, const std::string& d) {
+        GatherString(g, d.data(), d.size());
+    }
+};
+
+//! Gather serialization of string view.
+template<>
+struct GatherPack< StringView > {
+    static void Pack(GatherBuffer& g, const StringView& d) {
+        GatherString(g, d.Data(), d.Size());
+    }
+};
+
+inline void PackGatherArgs(GatherBuffer&) {}
+
+template< typename T, typename... ArgsT >
+void PackGatherArgs(GatherBuffer& g, const T& h, const ArgsT&... t) {
+    GatherPack< typename std::remove_cv< T >::type >::Pack(g, h);
+    PackGatherArgs(g, t...);
+}
+}
+
+//! Serialize arguments into gather buffer: top level POD vectors,
+//! strings and views larger than the buffer threshold are referenced,
+//! everything else is copied inline.
+//! \return number of bytes added
+template< typename... ArgsT >
+size_t PackGather(GatherBuffer& g, const ArgsT&... args) {
+    const size_t sz = g.Size();
+    detail::PackGatherArgs(g, args...);
+    return g.Size() - sz;
+}
+
+}
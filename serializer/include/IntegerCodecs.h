@@ -0,0 +1,467 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file IntegerCodecs.h
+//! \brief Compact encodings for integer arrays.
+//!
+//! The encoding is selected at \c Pack time by wrapping the data:
+//! \code
+//! srz::Pack(id, srz::AsDelta(particleIds), srz::AsBitPacked(counts));
+//! \endcode
+//! and decoded by unpacking into an \c Encoded< T, EncodingT > object.
+//!
+//! Layout: element count (\c Size), number of encoded bytes (\c Size),
+//! encoded bytes.
+//! - \c Varint: LEB128, 7 bits per byte, least significant group first
+//! - \c ZigZag: zigzag mapping (0, -1, 1, -2...  to 0, 1, 2, 3...) then
+//!   LEB128
+//! - \c Delta: difference from previous element (first element from zero),
+//!   zigzag, LEB128
+//! - \c BitPacked: blocks of 128 values, each block is one byte with the
+//!   bit width \c b followed by \c 4*b 32 bit words; value \c i of the block
+//!   is stored in lane \c i%4 at bit offset \c (i/4)*b of the lane, word
+//!   \c k of lane \c l is word \c 4*k+l of the block; remaining values are
+//!   LEB128 encoded. Packing and unpacking use SSE2 when available.
+//! - \c DeltaBitPacked: delta and zigzag, then bit packing
+//!
+//! Signed values are always zigzag mapped; bit packing supports element
+//! types up to 32 bits.
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Serialize.h"
+
+namespace srz {
+
+//! \defgroup Encodings
+//! Encoding tags.
+//! @{
+struct Varint {
+    static const bool UseDelta = false;
+    static const bool UseZigZag = false;
+    static const bool UsePacking = false;
+};
+struct ZigZag {
+    static const bool UseDelta = false;
+    static const bool UseZigZag = true;
+    static const bool UsePacking = false;
+};
+struct Delta {
+    static const bool UseDelta = true;
+    static const bool UseZigZag = true;
+    static const bool UsePacking = false;
+};
+struct BitPacked {
+    static const bool UseDelta = false;
+    static const bool UseZigZag = false;
+    static const bool UsePacking = true;
+};
+struct DeltaBitPacked {
+    static const bool UseDelta = true;
+    static const bool UseZigZag = true;
+    static const bool UsePacking = true;
+};
+//! @}
+
+//! Integer encoding and decoding of raw buffers.
+namespace codec {
+
+//! Number of values per bit packed block.
+const size_t BLOCK_SIZE = 128;
+
+//! Maximum number of bytes of LEB128 encoded value of type \c T.
+template< typename T >
+size_t MaxVarintSize() {
+    return (8 * sizeof(T) + 6) / 7;
+}
+
+//! Write LEB128 encoded value.
+//! \return pointer to byte after encoded value
+inline uint8_t* PutVarint(uint64_t v, uint8_t* out) {
+    while(v >= 0x80) {
+        *out++ = uint8_t(v | 0x80);
+        v >>= 7;
+    }
+    *out++ = uint8_t(v);
+    return out;
+}
+
+//! Read LEB128 encoded value; throws \c std::runtime_error if the value
+//! is truncated or longer than 10 bytes.
+//! \return pointer to byte after encoded value
+inline const uint8_t* GetVarint(const uint8_t* in, const uint8_t* end,
+                                uint64_t& v) {
+    v = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7) {
+        if(in == end) throw std::runtime_error("srz: truncated varint");
+        const uint8_t b = *in++;
+        v |= uint64_t(b & 0x7f) << shift;
+        if(!(b & 0x80)) return in;
+    }
+    throw std::runtime_error("srz: varint too long");
+}
+
+//! Map signed value stored in unsigned type to zigzag encoding.
+template< typename U >
+U ZigZagEncode(U v) {
+    return U(U(v << 1) ^ U(U(0) - U(v >> (8 * sizeof(U) - 1))));
+}
+
+//! Inverse of \c ZigZagEncode.
+template< typename U >
+U ZigZagDecode(U v) {
+    return U(U(v >> 1) ^ U(U(0) - U(v & 1)));
+}
+
+namespace detail {
+//! Map values to and from the unsigned values actually encoded.
+template< typename T, typename EncodingT >
+struct Transform {
+    static_assert(std::is_integral< T >::value
+                  && !std::is_same< T, bool >::value,
+                  "Integer encodings require integer types");
+    using U = typename std::make_unsigned< T >::type;
+    static const bool Zig = EncodingT::UseZigZag
+                            || std::is_signed< T >::value;
+    Transform() : prev(0) {}
+    U Forward(T v) {
+        const U u = U(v);
+        const U d = EncodingT::UseDelta ? U(u - prev) : u;
+        prev = u;
+        return Zig ? ZigZagEncode(d) : d;
+    }
+    T Inverse(U z) {
+        const U d = Zig ? ZigZagDecode(z) : z;
+        const U u = EncodingT::UseDelta ? U(prev + d) : d;
+        prev = u;
+        return T(u);
+    }
+    U prev;
+};
+
+//! Bit pack 128 values, scalar implementation.
+inline void PackBlockScalar(const uint32_t* in, unsigned b, uint32_t* out) {
+    if(!b) return;
+    for(unsigned lane = 0; lane != 4; ++lane) {
+        uint32_t acc = 0;
+        unsigned shift = 0;
+        uint32_t* o = out + lane;
+        for(unsigned r = 0; r != BLOCK_SIZE / 4; ++r) {
+            const uint32_t v = in[4 * r + lane];
+            acc |= v << shift;
+            shift += b;
+            if(shift >= 32) {
+                *o = acc;
+                o += 4;
+                shift -= 32;
+                acc = shift ? v >> (b - shift) : 0;
+            }
+        }
+    }
+}
+
+//! Unpack 128 values, scalar implementation.
+inline void UnpackBlockScalar(const uint32_t* in, unsigned b, uint32_t* out) {
+    const uint32_t mask = b == 32 ? ~uint32_t(0) : (uint32_t(1) << b) - 1;
+    for(unsigned lane = 0; lane != 4; ++lane) {
+        for(unsigned r = 0; r != BLOCK_SIZE / 4; ++r) {
+            const unsigned bit = r * b;
+            const unsigned k = bit >> 5;
+            const unsigned off = bit & 31;
+            uint32_t v = b ? in[4 * k + lane] >> off : 0;
+            if(off + b > 32) v |= in[4 * (k + 1) + lane] << (32 - off);
+            out[4 * r + lane] = v & mask;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+//! Bit pack 128 values, four lanes at a time.
+inline void PackBlockSSE2(const uint32_t* in, unsigned b, uint32_t* out) {
+    if(!b) return;
+    __m128i acc = _mm_setzero_si128();
+    unsigned shift = 0;
+    __m128i* o = reinterpret_cast< __m128i* >(out);
+    for(unsigned r = 0; r != BLOCK_SIZE / 4; ++r) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast< const __m128i* >(in + 4 * r));
+        acc = _mm_or_si128(acc, _mm_sll_epi32(v, _mm_cvtsi32_si128(shift)));
+        shift += b;
+        if(shift >= 32) {
+            _mm_storeu_si128(o++, acc);
+            shift -= 32;
+            acc = shift ? _mm_srl_epi32(v, _mm_cvtsi32_si128(b - shift))
+                        : _mm_setzero_si128();
+        }
+    }
+}
+
+//! Unpack 128 values, four lanes at a time.
+inline void UnpackBlockSSE2(const uint32_t* in, unsigned b, uint32_t* out) {
+    __m128i* o = reinterpret_cast< __m128i* >(out);
+    if(!b) {
+        for(unsigned r = 0; r != BLOCK_SIZE / 4; ++r)
+            _mm_storeu_si128(o + r, _mm_setzero_si128());
+        return;
+    }
+    const __m128i mask = _mm_set1_epi32(
+        int(b == 32 ? ~uint32_t(0) : (uint32_t(1) << b) - 1));
+    const __m128i* i = reinterpret_cast< const __m128i* >(in);
+    __m128i w = _mm_loadu_si128(i++);
+    unsigned shift = 0;
+    for(unsigned r = 0; r != BLOCK_SIZE / 4; ++r) {
+        __m128i v = _mm_srl_epi32(w, _mm_cvtsi32_si128(shift));
+        shift += b;
+        if(shift >= 32) {
+            shift -= 32;
+            //last word of the block is consumed exactly
+            if(r + 1 != BLOCK_SIZE / 4) w = _mm_loadu_si128(i++);
+            if(shift)
+                v = _mm_or_si128(v, _mm_sll_epi32(
+                                        w, _mm_cvtsi32_si128(b - shift)));
+        }
+        _mm_storeu_si128(o + r, _mm_and_si128(v, mask));
+    }
+}
+#endif
+
+//! Number of bits required to represent the largest value.
+inline unsigned MaxBits(const uint32_t* in, size_t n) {
+    uint32_t acc = 0;
+    for(size_t i = 0; i != n; ++i) acc |= in[i];
+    unsigned b = 0;
+    while(acc) {
+        ++b;
+        acc >>= 1;
+    }
+    return b;
+}
+}
+
+//! Bit pack 128 values into \c 4*b words.
+inline void PackBlock(const uint32_t* in, unsigned b, uint32_t* out) {
+#if defined(__SSE2__)
+    detail::PackBlockSSE2(in, b, out);
+#else
+    detail::PackBlockScalar(in, b, out);
+#endif
+}
+
+//! Unpack 128 values from \c 4*b words.
+inline void UnpackBlock(const uint32_t* in, unsigned b, uint32_t* out) {
+#if defined(__SSE2__)
+    detail::UnpackBlockSSE2(in, b, out);
+#else
+    detail::UnpackBlockScalar(in, b, out);
+#endif
+}
+
+//! Upper bound of encoded size in bytes of \c n elements.
+template< typename T, typename EncodingT >
+size_t MaxEncodedSize(size_t n) {
+    if(!EncodingT::UsePacking) return n * MaxVarintSize< T >();
+    return (n / BLOCK_SIZE) * (1 + BLOCK_SIZE * sizeof(uint32_t))
+           + (n % BLOCK_SIZE) * MaxVarintSize< uint32_t >();
+}
+
+//! Encode \c n elements, \c out must point to at least
+//! \c MaxEncodedSize< T, EncodingT >(n) bytes.
+//! \return pointer to byte after encoded data
+template< typename T, typename EncodingT >
+uint8_t* Encode(const T* in, size_t n, uint8_t* out) {
+    detail::Transform< T, EncodingT > t;
+    size_t i = 0;
+    if(EncodingT::UsePacking) {
+        static_assert(!EncodingT::UsePacking || sizeof(T) <= 4,
+                      "Bit packing requires types up to 32 bits");
+        uint32_t block[BLOCK_SIZE];
+        uint32_t words[BLOCK_SIZE];
+        for(; i + BLOCK_SIZE <= n; i += BLOCK_SIZE) {
+            for(size_t j = 0; j != BLOCK_SIZE; ++j)
+                block[j] = uint32_t(t.Forward(in[i + j]));
+            const unsigned b = detail::MaxBits(block, BLOCK_SIZE);
+            PackBlock(block, b, words);
+            *out++ = uint8_t(b);
+            endian::CopyToWire(out, words, 4 * b);
+            out += 4 * b * sizeof(uint32_t);
+        }
+    }
+    for(; i != n; ++i) out = PutVarint(uint64_t(t.Forward(in[i])), out);
+    return out;
+}
+
+//! Decode \c n elements from range [in, end); throws
+//! \c std::runtime_error if data is invalid.
+//! \return pointer to byte after encoded data
+template< typename T, typename EncodingT >
+const uint8_t* Decode(const uint8_t* in, const uint8_t* end, T* out,
+                      size_t n) {
+    using U = typename detail::Transform< T, EncodingT >::U;
+    detail::Transform< T, EncodingT > t;
+    size_t i = 0;
+    if(EncodingT::UsePacking) {
+        uint32_t block[BLOCK_SIZE];
+        uint32_t words[BLOCK_SIZE];
+        for(; i + BLOCK_SIZE <= n; i += BLOCK_SIZE) {
+            if(in == end) throw std::runtime_error("srz: truncated block");
+            const unsigned b = *in++;
+            const size_t bytes = 4 * b * sizeof(uint32_t);
+            if(b > 32 || size_t(end - in) < bytes)
+                throw std::runtime_error("srz: invalid block");
+            endian::CopyFromWire(words, in, 4 * b);
+            in += bytes;
+            UnpackBlock(words, b, block);
+            for(size_t j = 0; j != BLOCK_SIZE; ++j)
+                out[i + j] = t.Inverse(U(block[j]));
+        }
+    }
+    for(; i != n; ++i) {
+        uint64_t v = 0;
+        in = GetVarint(in, end, v);
+        if(v > uint64_t(U(~U(0))))
+            throw std::runtime_error("srz: encoded value out of range");
+        out[i] = t.Inverse(U(v));
+    }
+    return in;
+}
+}
+
+//! Integer array serialized with a compact encoding; views the data to
+//! pack or owns the values decoded by \c UnPack.
+template< typename T, typename EncodingT >
+class Encoded {
+public:
+    using value_type = T;
+    using Encoding = EncodingT;
+    using const_iterator = const T*;
+    Encoded() : data_(nullptr), size_(0) {}
+    Encoded(const T* data, size_t size) : data_(data), size_(size) {}
+    Encoded(const std::vector< T >& v) : data_(v.data()), size_(v.size()) {}
+    const T* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    //! Copy elements into new vector.
+    std::vector< T > ToVector() const {
+        return std::vector< T >(begin(), end());
+    }
+    //! Create object owning the values.
+    static Encoded Own(std::vector< T >&& values) {
+        Encoded e;
+        e.values_ = std::make_shared< std::vector< T > >(std::move(values));
+        e.data_ = e.values_->data();
+        e.size_ = e.values_->size();
+        return e;
+    }
+private:
+    const T* data_;
+    size_t size_;
+    std::shared_ptr< std::vector< T > > values_;
+};
+
+//! \defgroup Encoding selection
+//! @{
+template< typename T >
+Encoded< T, Varint > AsVarint(const std::vector< T >& v) { return v; }
+template< typename T >
+Encoded< T, ZigZag > AsZigZag(const std::vector< T >& v) { return v; }
+template< typename T >
+Encoded< T, Delta > AsDelta(const std::vector< T >& v) { return v; }
+template< typename T >
+Encoded< T, BitPacked > AsBitPacked(const std::vector< T >& v) { return v; }
+template< typename T >
+Encoded< T, DeltaBitPacked > AsDeltaBitPacked(const std::vector< T >& v) {
+    return v;
+}
+//! @}
+
+//! Serialize \c Encoded arrays: element count, encoded size, encoded data.
+template< typename T, typename EncodingT >
+struct SerializeEncoded {
+    using E = Encoded< T, EncodingT >;
+    static ByteArray Pack(const E& d, ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const E& d, IteratorT i) {
+        i = detail::Write(i, Size(d.Size()));
+        uint8_t* begin = reinterpret_cast< uint8_t* >(&*i) + sizeof(Size);
+        uint8_t* end =
+            codec::Encode< T, EncodingT >(d.Data(), d.Size(), begin);
+        detail::Write(i, Size(end - begin));
+        return i + sizeof(Size) + (end - begin);
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, E& d) {
+        Size n = 0;
+        Size bytes = 0;
+        i = detail::Read(detail::Read(i, n), bytes);
+        std::vector< T > v(n);
+        if(bytes) {
+            const uint8_t* begin = reinterpret_cast< const uint8_t* >(&*i);
+            if(codec::Decode< T, EncodingT >(begin, begin + bytes,
+                                            v.data(), n)
+               != begin + bytes)
+                throw std::runtime_error("srz: encoded size mismatch");
+        } else if(n) throw std::runtime_error("srz: missing encoded data");
+        d = E::Own(std::move(v));
+        return i + bytes;
+    }
+    //! Check sizes; the number of elements is limited to the number that
+    //! can be encoded in the declared bytes, the encoded data is checked
+    //! while decoding.
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        size_t n = 0, bytes = 0;
+        p = detail::ReadSize(detail::ReadSize(p, end, n), end, bytes);
+        if(!p || bytes > size_t(end - p)) return nullptr;
+        //bit packed blocks of 128 zero bits values take one byte
+        const size_t perByte = EncodingT::UsePacking ? codec::BLOCK_SIZE : 1;
+        return n / perByte > bytes ? nullptr : p + bytes;
+    }
+    //! Upper bound of serialized size.
+    static size_t Sizeof(const E& d) {
+        return 2 * sizeof(Size)
+               + codec::MaxEncodedSize< T, EncodingT >(d.Size());
+    }
+};
+
+//! Select serializer for \c Encoded.
+template< typename T, typename EncodingT >
+struct GetSerializer< Encoded< T, EncodingT > > {
+    using Type = SerializeEncoded< T, EncodingT >;
+};
+
+//! Select serializer for \c [const Encoded].
+template< typename T, typename EncodingT >
+struct GetSerializer< const Encoded< T, EncodingT > > {
+    using Type = SerializeEncoded< T, EncodingT >;
+};
+
+}
@@ -0,0 +1,308 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file JSDecoder.h
+//! \brief Generate JavaScript decoders for types declared with
+//! \c SRZ_FIELDS.
+//!
+//! \code
+//! srz::JSDecoderGenerator g;
+//! g.Add< Vec3 >("decodeVec3");
+//! g.Add< Particle >("decodeParticle"); //uses decodeVec3
+//! std::ofstream("messages.js") << g.Source();
+//! \endcode
+//! Each generated function takes an \c SrzReader (srz.js) and returns an
+//! object with one property per field. Structs whose fields are all
+//! numbers are read at fixed offsets with a single bounds check.
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include "Serialize.h"
+#include "Fields.h"
+#include "IntegerCodecs.h"
+#include "Compression.h"
+#include "Quantize.h"
+#include "FlatMap.h"
+
+namespace srz {
+
+class JSDecoderGenerator;
+
+namespace detail {
+//! Underlying type of enum, type itself otherwise.
+template< typename T, bool E = std::is_enum< T >::value >
+struct Underlying {
+    using Type = T;
+};
+
+template< typename T >
+struct Underlying< T, true > {
+    using Type = typename std::underlying_type< T >::type;
+};
+
+//! \c true for types read as a single JavaScript number.
+template< typename T >
+struct IsJSScalar {
+    static const bool Value = std::is_arithmetic< T >::value
+                              || std::is_enum< T >::value;
+};
+
+//! Element type name in srz.js: int8 ... uint64, float32, float64.
+template< typename T >
+std::string JSScalarName() {
+    using U = typename Underlying< T >::Type;
+    if(std::is_same< U, bool >::value) return "uint8";
+    if(std::is_floating_point< U >::value) {
+        if(sizeof(U) == 4) return "float32";
+        if(sizeof(U) == 8) return "float64";
+        throw std::logic_error("Unsupported floating point type");
+    }
+    return std::string(std::is_signed< U >::value ? "int" : "uint")
+           + std::to_string(8 * sizeof(U));
+}
+
+//! DataView getter of scalar type.
+template< typename T >
+std::string JSGetter() {
+    const std::string n = JSScalarName< T >();
+    if(n == "int64") return "getBigInt64";
+    if(n == "uint64") return "getBigUint64";
+    const size_t d = n.find_first_of("0123456789");
+    std::string g = "get" + n.substr(0, d);
+    g[3] = char(toupper(g[3]));
+    return g + n.substr(d);
+}
+
+//! Convert JavaScript number expression to field value.
+template< typename T >
+std::string JSValue(const std::string& e) {
+    return std::is_same< T, bool >::value ? "(" + e + " !== 0)" : e;
+}
+
+//! JavaScript expression reading a value of type \c T from reader \c r.
+template< typename T, typename Enable = void >
+struct JSReader;
+
+template< typename T >
+struct JSReader< T, typename std::enable_if<
+                        IsJSScalar< T >::Value >::type > {
+    static std::string Expr(const JSDecoderGenerator&) {
+        return JSValue< T >("r." + JSScalarName< T >() + "()");
+    }
+};
+
+template< typename T >
+struct JSReader< T, typename std::enable_if<
+                        HasFields< T >::Value >::type > {
+    static std::string Expr(const JSDecoderGenerator& g);
+};
+
+template<>
+struct JSReader< std::string > {
+    static std::string Expr(const JSDecoderGenerator&) {
+        return "r.string()";
+    }
+};
+
+template<>
+struct JSReader< StringView > : JSReader< std::string > {};
+
+template< typename T >
+struct JSReader< std::vector< T > > {
+    static std::string Expr(const JSDecoderGenerator& g) {
+        if(IsJSScalar< T >::Value && !std::is_same< T, bool >::value)
+            return "r.array('" + JSScalarName< T >() + "')";
+        return "r.vector(r => " + JSReader< T >::Expr(g) + ")";
+    }
+};
+
+template< typename T >
+struct JSReader< ArrayView< T > > : JSReader< std::vector< T > > {};
+
+//! Maps of numbers are read from arrays of keys and values.
+template< typename K, typename V >
+struct JSReader< std::map< K, V > > {
+    static std::string Expr(const JSDecoderGenerator& g) {
+        if(FlatMapLayout< K, V >::value)
+            return "r.scalarMap('" + JSScalarName< K >() + "', '"
+                   + JSScalarName< V >() + "')";
+        return "r.map(r => " + JSReader< K >::Expr(g) + ", r => "
+               + JSReader< V >::Expr(g) + ")";
+    }
+};
+
+template< typename K, typename V >
+struct JSReader< std::unordered_map< K, V > > : JSReader< std::map< K, V > > {};
+
+template< typename K, typename V >
+struct JSReader< FlatMap< K, V > > : JSReader< std::map< K, V > > {};
+
+template< typename F, typename S >
+struct JSReader< std::pair< F, S > > {
+    static std::string Expr(const JSDecoderGenerator& g) {
+        return "[" + JSReader< F >::Expr(g) + ", " + JSReader< S >::Expr(g)
+               + "]";
+    }
+};
+
+template< typename T, typename EncodingT >
+struct JSReader< Encoded< T, EncodingT > > {
+    static std::string Encoding() {
+        return EncodingT::UsePacking
+               ? (EncodingT::UseDelta ? "deltabitpacked" : "bitpacked")
+               : EncodingT::UseDelta
+                 ? "delta" : EncodingT::UseZigZag ? "zigzag" : "varint";
+    }
+    static std::string Expr(const JSDecoderGenerator&) {
+        return "r.encoded('" + JSScalarName< T >() + "', '" + Encoding()
+               + "')";
+    }
+};
+
+template< typename T >
+struct JSReader< Compressed< T > > {
+    static std::string Expr(const JSDecoderGenerator&) {
+        return "r.compressed('" + JSScalarName< T >() + "')";
+    }
+};
+
+template< typename EncodingT >
+struct JSReader< Quantized< EncodingT > > {
+    static std::string Expr(const JSDecoderGenerator&) {
+        return EncodingT::HasRange
+               ? "r.fixed('" + JSScalarName< typename EncodingT::Type >()
+                 + "')"
+               : "r.half()";
+    }
+};
+
+//! Field descriptions of type with field list.
+struct JSField {
+    std::string expr;   //sequential read expression
+    bool scalar;        //read as single number
+    std::string getter; //DataView getter if scalar
+    bool isBool;
+};
+
+template< typename T >
+JSField MakeJSField(const JSDecoderGenerator& g) {
+    return JSField{JSReader< T >::Expr(g), IsJSScalar< T >::Value,
+                   IsJSScalar< T >::Value ? JSGetter< T >() : "",
+                   std::is_same< T, bool >::value};
+}
+
+template< typename T, size_t... Is >
+std::vector< JSField > JSFields(const JSDecoderGenerator& g,
+                                const Seq< Is... >&) {
+    return {MakeJSField< typename std::tuple_element<
+        Is, FieldsTuple< T > >::type >(g)...};
+}
+
+template< typename T, size_t... Is >
+std::vector< size_t > JSOffsets(const Seq< Is... >&) {
+    return {size_t(FieldOffset< T, Is >::Value)...};
+}
+}
+
+//! Generate JavaScript decoders for types declared with \c SRZ_FIELDS; types
+//! used as fields of other types must be added first.
+class JSDecoderGenerator {
+public:
+    //! Add decoder function for type \c T.
+    template< typename T >
+    JSDecoderGenerator& Add(const std::string& functionName) {
+        using Indices = typename detail::GenSeq<
+            FieldCount< T >::value >::Type;
+        const std::vector< std::string >& names = FieldNames< T >();
+        const std::vector< detail::JSField > fields =
+            detail::JSFields< T >(*this, Indices());
+        const std::vector< size_t > offsets =
+            detail::JSOffsets< T >(Indices());
+        bool allScalar = true;
+        for(auto& f: fields) allScalar = allScalar && f.scalar;
+        std::ostringstream os;
+        os << "function " << functionName << "(r) {\n";
+        if(allScalar && StaticSizeof< T >::Fixed) {
+            //fixed layout: single bounds check, constant offsets
+            os << "  const o = r.offset;\n"
+               << "  r.skip(" << StaticSizeof< T >::Value << ");\n"
+               << "  return {\n";
+            for(size_t i = 0; i != fields.size(); ++i) {
+                std::string e = "r.view." + fields[i].getter + "(o";
+                if(offsets[i]) e += " + " + std::to_string(offsets[i]);
+                e += ", true)";
+                if(fields[i].isBool) e = "(" + e + " !== 0)";
+                os << "    " << names[i] << ": " << e
+                   << (i + 1 == fields.size() ? "\n" : ",\n");
+            }
+        } else {
+            //object literal properties are evaluated in order
+            os << "  return {\n";
+            for(size_t i = 0; i != fields.size(); ++i) {
+                os << "    " << names[i] << ": " << fields[i].expr
+                   << (i + 1 == fields.size() ? "\n" : ",\n");
+            }
+        }
+        os << "  };\n}\n";
+        functions_[std::type_index(typeid(T))] = functionName;
+        exports_ += (exports_.empty() ? "" : ", ") + functionName;
+        source_ += (source_.empty() ? "" : "\n") + os.str();
+        return *this;
+    }
+    //! Name of decoder function of type \c T; throws \c std::logic_error
+    //! if the type was not added.
+    template< typename T >
+    const std::string& FunctionName() const {
+        auto i = functions_.find(std::type_index(typeid(T)));
+        if(i == functions_.end())
+            throw std::logic_error(std::string("No JavaScript decoder for ")
+                                   + typeid(T).name()
+                                   + ": add field types first");
+        return i->second;
+    }
+    //! Generated JavaScript source.
+    std::string Source() const {
+        std::ostringstream os;
+        os << "// Generated by srz::JSDecoderGenerator, do not edit.\n"
+           << "// Decode with new SrzReader(data, {sizeBytes: "
+           << sizeof(Size) << ", aligned: "
+           << (WireAligned ? "true" : "false") << "}), see srz.js.\n\n"
+           << source_ << "\nif(typeof module !== 'undefined')\n"
+           << "  module.exports = {" << exports_ << "};\n";
+        return os.str();
+    }
+private:
+    std::map< std::type_index, std::string > functions_;
+    std::string source_;
+    std::string exports_;
+};
+
+namespace detail {
+template< typename T >
+std::string JSReader< T, typename std::enable_if<
+                             HasFields< T >::Value >::type >::Expr(
+    const JSDecoderGenerator& g) {
+    return g.FunctionName< T >() + "(r)";
+}
+}
+
+}
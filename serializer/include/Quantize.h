@@ -0,0 +1,536 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Quantize.h
+//! \brief Lossy reduced precision encodings for float arrays.
+//!
+//! The encoding is selected at \c Pack time by wrapping the data:
+//! \code
+//! srz::Pack(id, srz::AsHalf(positions), srz::AsFixed8(density));
+//! \endcode
+//! and decoded by unpacking into a \c Quantized< EncodingT > object.
+//!
+//! Layout:
+//! - \c Half: same as \c std::vector< uint16_t > of IEEE 754 binary16
+//!   values, rounded to nearest even (F16C when available). The relative
+//!   error is at most 2^-11 for magnitudes in [2^-14, 65504], the absolute
+//!   error at most 2^-25 below; larger magnitudes become infinity, NaN is
+//!   preserved.
+//! - \c Fixed8, \c Fixed16: range \c lo, \c hi (\c float), then same as
+//!   \c std::vector< uint8_t > or \c std::vector< uint16_t >. Value \c x is
+//!   encoded as \c q=round((x-lo)*(2^b-1)/(hi-lo)) and decoded as
+//!   \c lo+q*(hi-lo)/(2^b-1): the absolute error is at most half a step,
+//!   \c (hi-lo)/(2*(2^b-1)), plus float rounding. The range is the minimum
+//!   and maximum of the finite values unless specified; values outside the
+//!   range are clamped and NaN is encoded as \c lo. Conversion uses SSE2
+//!   when available.
+//!
+//! The payload is padded like any POD array when \c SRZ_WIRE_ALIGNED is
+//! defined, to be mapped as a typed array by JavaScript clients.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include "Serialize.h"
+
+namespace srz {
+
+//! \defgroup Precision reductions
+//! Encoding tags.
+//! @{
+struct Half {
+    using Type = uint16_t;
+    static const bool HasRange = false;
+};
+struct Fixed8 {
+    using Type = uint8_t;
+    static const bool HasRange = true;
+};
+struct Fixed16 {
+    using Type = uint16_t;
+    static const bool HasRange = true;
+};
+//! @}
+
+//! Conversion of float buffers to and from reduced precision values.
+namespace quantize {
+namespace detail {
+inline uint32_t FloatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+inline float BitsFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+template< typename U >
+U LoadU(const void* p, size_t i) {
+    U v;
+    memcpy(&v, static_cast< const uint8_t* >(p) + i * sizeof(U), sizeof(U));
+    return v;
+}
+
+template< typename U >
+void StoreU(void* p, size_t i, U v) {
+    memcpy(static_cast< uint8_t* >(p) + i * sizeof(U), &v, sizeof(U));
+}
+}
+
+//! Convert float to half, rounding to nearest even.
+inline uint16_t FloatToHalf(float f) {
+    uint32_t u = detail::FloatBits(f);
+    const uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+    uint32_t h;
+    if(u >= 0x47800000u) { //2^16: infinity or NaN
+        h = u > 0x7f800000u ? 0x7e00u | ((u >> 13) & 0x3ff) : 0x7c00u;
+    } else if(u < 0x38800000u) { //2^-14: subnormal or zero
+        //adding 0.5 aligns the half mantissa with the float mantissa LSBs
+        const float magic = detail::BitsFloat(126u << 23);
+        h = detail::FloatBits(detail::BitsFloat(u) + magic) - (126u << 23);
+    } else {
+        const uint32_t odd = (u >> 13) & 1;
+        u += (uint32_t(15 - 127) << 23) + 0xfff + odd;
+        h = u >> 13;
+    }
+    return uint16_t(h | (sign >> 16));
+}
+
+//! Convert half to float.
+inline float HalfToFloat(uint16_t h) {
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    uint32_t u = uint32_t(h & 0x7fff) << 13;
+    const uint32_t exp = u & 0x0f800000u;
+    u += uint32_t(127 - 15) << 23;
+    if(exp == 0x0f800000u) { //infinity, NaN made quiet as by F16C
+        u += uint32_t(128 - 16) << 23;
+        if(u & 0x007fffffu) u |= 0x00400000u;
+    } else if(!exp) { //subnormal: renormalize through float subtraction
+        u += 1u << 23;
+        u = detail::FloatBits(detail::BitsFloat(u)
+                              - detail::BitsFloat(113u << 23));
+    }
+    return detail::BitsFloat(u | sign);
+}
+
+//! Convert \c n floats to halves in host byte order, scalar implementation.
+inline void ToHalfScalar(const float* in, size_t n, void* out) {
+    for(size_t i = 0; i != n; ++i)
+        detail::StoreU(out, i, FloatToHalf(in[i]));
+}
+
+//! Convert \c n halves in host byte order to floats, scalar implementation.
+inline void FromHalfScalar(const void* in, size_t n, float* out) {
+    for(size_t i = 0; i != n; ++i)
+        out[i] = HalfToFloat(detail::LoadU< uint16_t >(in, i));
+}
+
+//! Convert \c n floats to halves in host byte order.
+inline void ToHalf(const float* in, size_t n, void* out) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for(; i + 4 <= n; i += 4) {
+        const __m128i h = _mm_cvtps_ph(_mm_loadu_ps(in + i),
+                                       _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64(reinterpret_cast< __m128i* >(
+            static_cast< uint8_t* >(out) + 2 * i), h);
+    }
+#endif
+    ToHalfScalar(in + i, n - i, static_cast< uint8_t* >(out) + 2 * i);
+}
+
+//! Convert \c n halves in host byte order to floats.
+inline void FromHalf(const void* in, size_t n, float* out) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for(; i + 4 <= n; i += 4) {
+        const __m128i h = _mm_loadl_epi64(reinterpret_cast< const __m128i* >(
+            static_cast< const uint8_t* >(in) + 2 * i));
+        _mm_storeu_ps(out + i, _mm_cvtph_ps(h));
+    }
+#endif
+    FromHalfScalar(static_cast< const uint8_t* >(in) + 2 * i, n - i,
+                   out + i);
+}
+
+//! Minimum and maximum of the finite values; {0, 0} if there are none.
+inline void Range(const float* in, size_t n, float& lo, float& hi) {
+    lo = std::numeric_limits< float >::max();
+    hi = -lo;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+    const __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 inf = _mm_set1_ps(std::numeric_limits< float >::infinity());
+    for(; i + 4 <= n; i += 4) {
+        const __m128 x = _mm_loadu_ps(in + i);
+        //false for infinity and NaN
+        const __m128 finite = _mm_cmplt_ps(_mm_and_ps(x, abs), inf);
+        vlo = _mm_min_ps(vlo, _mm_or_ps(_mm_and_ps(finite, x),
+                                        _mm_andnot_ps(finite, vlo)));
+        vhi = _mm_max_ps(vhi, _mm_or_ps(_mm_and_ps(finite, x),
+                                        _mm_andnot_ps(finite, vhi)));
+    }
+    float l[4], h[4];
+    _mm_storeu_ps(l, vlo);
+    _mm_storeu_ps(h, vhi);
+    for(int k = 0; k != 4; ++k) {
+        lo = std::min(lo, l[k]);
+        hi = std::max(hi, h[k]);
+    }
+#endif
+    for(; i != n; ++i) {
+        if(!std::isfinite(in[i])) continue;
+        lo = std::min(lo, in[i]);
+        hi = std::max(hi, in[i]);
+    }
+    if(lo > hi) lo = hi = 0.f;
+}
+
+//! Number of quantization steps of \c U values.
+template< typename U >
+float Steps() { return float(std::numeric_limits< U >::max()); }
+
+//! Quantize \c n floats over [lo, hi] to \c U values in host byte order,
+//! scalar implementation.
+template< typename U >
+void QuantizeScalar(const float* in, size_t n, float lo, float hi,
+                    void* out) {
+    const float maxq = Steps< U >();
+    const float scale = hi > lo ? maxq / (hi - lo) : 0.f;
+    for(size_t i = 0; i != n; ++i) {
+        float t = in[i] - lo;
+        t = t > 0.f ? t : 0.f; //NaN to zero
+        t = std::min(t * scale + 0.5f, maxq);
+        detail::StoreU(out, i, U(t));
+    }
+}
+
+//! Inverse of \c QuantizeScalar.
+template< typename U >
+void DequantizeScalar(const void* in, size_t n, float lo, float hi,
+                      float* out) {
+    const float step = (hi - lo) / Steps< U >();
+    for(size_t i = 0; i != n; ++i)
+        out[i] = lo + float(detail::LoadU< U >(in, i)) * step;
+}
+
+#if defined(__SSE2__)
+namespace detail {
+//! Quantized values of 4 floats as 32 bit integers.
+inline __m128i Quantize4(const float* in, __m128 lo, __m128 scale,
+                         __m128 maxq) {
+    //max returns the second operand if the first one is NaN
+    __m128 t = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(in), lo), _mm_setzero_ps());
+    t = _mm_min_ps(_mm_add_ps(_mm_mul_ps(t, scale), _mm_set1_ps(0.5f)), maxq);
+    return _mm_cvttps_epi32(t);
+}
+
+inline void Quantize16(const float* in, size_t n, float lo, float hi,
+                       void* out) {
+    const __m128 vlo = _mm_set1_ps(lo);
+    const float maxq = Steps< uint16_t >();
+    const __m128 scale = _mm_set1_ps(hi > lo ? maxq / (hi - lo) : 0.f);
+    const __m128 vmax = _mm_set1_ps(maxq);
+    //signed saturation: shift to [-32768, 32767] then back
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128i flip = _mm_set1_epi16(int16_t(0x8000));
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const __m128i a = _mm_sub_epi32(Quantize4(in + i, vlo, scale, vmax),
+                                        bias);
+        const __m128i b = _mm_sub_epi32(
+            Quantize4(in + i + 4, vlo, scale, vmax), bias);
+        _mm_storeu_si128(reinterpret_cast< __m128i* >(
+            static_cast< uint8_t* >(out) + 2 * i),
+            _mm_xor_si128(_mm_packs_epi32(a, b), flip));
+    }
+    QuantizeScalar< uint16_t >(in + i, n - i, lo, hi,
+                               static_cast< uint8_t* >(out) + 2 * i);
+}
+
+inline void Quantize8(const float* in, size_t n, float lo, float hi,
+                      void* out) {
+    const __m128 vlo = _mm_set1_ps(lo);
+    const float maxq = Steps< uint8_t >();
+    const __m128 scale = _mm_set1_ps(hi > lo ? maxq / (hi - lo) : 0.f);
+    const __m128 vmax = _mm_set1_ps(maxq);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        const __m128i a = _mm_packs_epi32(
+            Quantize4(in + i, vlo, scale, vmax),
+            Quantize4(in + i + 4, vlo, scale, vmax));
+        const __m128i b = _mm_packs_epi32(
+            Quantize4(in + i + 8, vlo, scale, vmax),
+            Quantize4(in + i + 12, vlo, scale, vmax));
+        _mm_storeu_si128(reinterpret_cast< __m128i* >(
+            static_cast< uint8_t* >(out) + i), _mm_packus_epi16(a, b));
+    }
+    QuantizeScalar< uint8_t >(in + i, n - i, lo, hi,
+                              static_cast< uint8_t* >(out) + i);
+}
+
+inline void Dequantize4(__m128i q, __m128 lo, __m128 step, float* out) {
+    _mm_storeu_ps(out, _mm_add_ps(lo, _mm_mul_ps(_mm_cvtepi32_ps(q), step)));
+}
+
+inline void Dequantize16(const void* in, size_t n, float lo, float hi,
+                         float* out) {
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 step = _mm_set1_ps((hi - lo) / Steps< uint16_t >());
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const __m128i q = _mm_loadu_si128(reinterpret_cast< const __m128i* >(
+            static_cast< const uint8_t* >(in) + 2 * i));
+        Dequantize4(_mm_unpacklo_epi16(q, zero), vlo, step, out + i);
+        Dequantize4(_mm_unpackhi_epi16(q, zero), vlo, step, out + i + 4);
+    }
+    DequantizeScalar< uint16_t >(static_cast< const uint8_t* >(in) + 2 * i,
+                                 n - i, lo, hi, out + i);
+}
+
+inline void Dequantize8(const void* in, size_t n, float lo, float hi,
+                        float* out) {
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 step = _mm_set1_ps((hi - lo) / Steps< uint8_t >());
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        const __m128i q = _mm_loadu_si128(reinterpret_cast< const __m128i* >(
+            static_cast< const uint8_t* >(in) + i));
+        const __m128i a = _mm_unpacklo_epi8(q, zero);
+        const __m128i b = _mm_unpackhi_epi8(q, zero);
+        Dequantize4(_mm_unpacklo_epi16(a, zero), vlo, step, out + i);
+        Dequantize4(_mm_unpackhi_epi16(a, zero), vlo, step, out + i + 4);
+        Dequantize4(_mm_unpacklo_epi16(b, zero), vlo, step, out + i + 8);
+        Dequantize4(_mm_unpackhi_epi16(b, zero), vlo, step, out + i + 12);
+    }
+    DequantizeScalar< uint8_t >(static_cast< const uint8_t* >(in) + i,
+                                n - i, lo, hi, out + i);
+}
+}
+#endif
+
+//! Quantize \c n floats over [lo, hi] to \c U values in host byte order.
+template< typename U >
+void Quantize(const float* in, size_t n, float lo, float hi, void* out) {
+#if defined(__SSE2__)
+    if(sizeof(U) == 1) detail::Quantize8(in, n, lo, hi, out);
+    else detail::Quantize16(in, n, lo, hi, out);
+#else
+    QuantizeScalar< U >(in, n, lo, hi, out);
+#endif
+}
+
+//! Inverse of \c Quantize.
+template< typename U >
+void Dequantize(const void* in, size_t n, float lo, float hi, float* out) {
+#if defined(__SSE2__)
+    if(sizeof(U) == 1) detail::Dequantize8(in, n, lo, hi, out);
+    else detail::Dequantize16(in, n, lo, hi, out);
+#else
+    DequantizeScalar< U >(in, n, lo, hi, out);
+#endif
+}
+
+//! Encode \c n floats as \c EncodingT values in host byte order.
+template< typename EncodingT >
+void Encode(const float* in, size_t n, float lo, float hi, void* out) {
+    if(EncodingT::HasRange)
+        Quantize< typename EncodingT::Type >(in, n, lo, hi, out);
+    else ToHalf(in, n, out);
+}
+
+//! Decode \c n \c EncodingT values in host byte order.
+template< typename EncodingT >
+void Decode(const void* in, size_t n, float lo, float hi, float* out) {
+    if(EncodingT::HasRange)
+        Dequantize< typename EncodingT::Type >(in, n, lo, hi, out);
+    else FromHalf(in, n, out);
+}
+}
+
+//! Float array serialized with reduced precision; views the data to pack
+//! or owns the values decoded by \c UnPack.
+template< typename EncodingT >
+class Quantized {
+public:
+    using value_type = float;
+    using Encoding = EncodingT;
+    using const_iterator = const float*;
+    Quantized() : data_(nullptr), size_(0) {}
+    //! View data, range computed at \c Pack time if the encoding has one.
+    Quantized(const float* data, size_t size)
+        : data_(data), size_(size) {}
+    Quantized(const std::vector< float >& v)
+        : data_(v.data()), size_(v.size()) {}
+    //! View data, quantized over range [lo, hi].
+    Quantized(const float* data, size_t size, float lo, float hi)
+        : data_(data), size_(size), ranged_(true), lo_(lo), hi_(hi) {
+        if(!(lo <= hi)) throw std::invalid_argument("srz: invalid range");
+    }
+    const float* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    const float* begin() const { return data_; }
+    const float* end() const { return data_ + size_; }
+    const float& operator[](size_t i) const { return data_[i]; }
+    //! \c true if the range was specified or received.
+    bool HasRange() const { return ranged_; }
+    //! Lower bound of quantization range.
+    float Min() const { return lo_; }
+    //! Upper bound of quantization range.
+    float Max() const { return hi_; }
+    //! Largest absolute difference between encoded and decoded values
+    //! within range, excluding float rounding.
+    float MaxError() const {
+        if(!EncodingT::HasRange) return 0.f;
+        return (hi_ - lo_)
+               / (2.f * quantize::Steps< typename EncodingT::Type >());
+    }
+    //! Copy elements into new vector.
+    std::vector< float > ToVector() const {
+        return std::vector< float >(begin(), end());
+    }
+    //! Create object owning the values.
+    static Quantized Own(std::vector< float >&& values, float lo = 0.f,
+                         float hi = 0.f) {
+        Quantized q;
+        q.values_ = std::make_shared< std::vector< float > >(
+            std::move(values));
+        q.data_ = q.values_->data();
+        q.size_ = q.values_->size();
+        q.ranged_ = EncodingT::HasRange;
+        q.lo_ = lo;
+        q.hi_ = hi;
+        return q;
+    }
+private:
+    const float* data_;
+    size_t size_;
+    bool ranged_ = false;
+    float lo_ = 0.f;
+    float hi_ = 0.f;
+    std::shared_ptr< std::vector< float > > values_;
+};
+
+//! \defgroup Precision selection
+//! @{
+inline Quantized< Half > AsHalf(const std::vector< float >& v) { return v; }
+inline Quantized< Fixed8 > AsFixed8(const std::vector< float >& v) {
+    return v;
+}
+inline Quantized< Fixed8 > AsFixed8(const std::vector< float >& v,
+                                    float lo, float hi) {
+    return Quantized< Fixed8 >(v.data(), v.size(), lo, hi);
+}
+inline Quantized< Fixed16 > AsFixed16(const std::vector< float >& v) {
+    return v;
+}
+inline Quantized< Fixed16 > AsFixed16(const std::vector< float >& v,
+                                      float lo, float hi) {
+    return Quantized< Fixed16 >(v.data(), v.size(), lo, hi);
+}
+//! @}
+
+//! Serialize \c Quantized arrays: range if any, then same layout as
+//! \c std::vector of the encoded type.
+template< typename EncodingT >
+struct SerializeQuantized {
+    using Q = Quantized< EncodingT >;
+    using U = typename EncodingT::Type;
+    static ByteArray Pack(const Q& d, ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const Q& d, IteratorT i) {
+        float lo = d.Min(), hi = d.Max();
+        if(EncodingT::HasRange) {
+            if(!d.HasRange()) quantize::Range(d.Data(), d.Size(), lo, hi);
+            i = detail::Write(detail::Write(i, lo), hi);
+        }
+        i = detail::WritePad< U >(detail::Write(i, Size(d.Size())));
+        void* out = &*i;
+        quantize::Encode< EncodingT >(d.Data(), d.Size(), lo, hi, out);
+        if(endian::SwapOnWire< U >::value)
+            endian::ByteSwap(out, out, d.Size(), sizeof(U));
+        return i + d.Size() * sizeof(U);
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, Q& d) {
+        float lo = 0.f, hi = 0.f;
+        if(EncodingT::HasRange) i = detail::Read(detail::Read(i, lo), hi);
+        Size n = 0;
+        i = detail::SkipPad(detail::Read(i, n));
+        std::vector< float > v(n);
+        const void* in = &*i;
+        std::vector< U > swapped;
+        if(endian::SwapOnWire< U >::value && n) {
+            swapped.resize(n);
+            endian::CopyFromWire(swapped.data(), in, n);
+            in = swapped.data();
+        }
+        if(n) quantize::Decode< EncodingT >(in, n, lo, hi, v.data());
+        d = Q::Own(std::move(v), lo, hi);
+        return i + n * sizeof(U);
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        if(EncodingT::HasRange) p = detail::Skip(p, end, 2 * sizeof(float));
+        return detail::ValidateArray< U >(p, end, true);
+    }
+    //! Size of serialized data; upper bound if \c SRZ_WIRE_ALIGNED is
+    //! defined.
+    static size_t Sizeof(const Q& d) {
+        return (EncodingT::HasRange ? 2 * sizeof(float) : 0) + sizeof(Size)
+               + detail::MaxPad< U >() + d.Size() * sizeof(U);
+    }
+};
+
+//! Select serializer for \c Quantized.
+template< typename EncodingT >
+struct GetSerializer< Quantized< EncodingT > > {
+    using Type = SerializeQuantized< EncodingT >;
+};
+
+//! Select serializer for \c [const Quantized].
+template< typename EncodingT >
+struct GetSerializer< const Quantized< EncodingT > > {
+    using Type = SerializeQuantized< EncodingT >;
+};
+
+}
@@ -27,9 +27,23 @@
 //! All serializers expose the inteface:
 //! \code
 //! static ByteArray Pack(const T &d, ByteArray buf = ByteArray())
-//! static ByteIterator Pack(const T &d, ByteIterator i)
-//! static ConstByteIterator UnPack(ConstByteIterator i, T& d)
+//! template< typename IteratorT >
+//! static IteratorT Pack(const T &d, IteratorT i)
+//! template< typename IteratorT >
+//! static IteratorT UnPack(IteratorT i, T& d)
 //! \endcode
+//! and, to unpack untrusted data with \c UnPackChecked,
+//! \code
+//! static const Byte* Validate(const Byte* p, const Byte* end)
+//! \endcode
+//! The iterator versions of \c Pack and \c UnPack accept any random access
+//! iterator over contiguous bytes, including raw pointers; see Sinks.h for
+//! packing into external buffers.
+//!
+//! Wire format: by default data is written in host byte order; define
+//! \c SRZ_WIRE_LE to write fixed-width little-endian sizes and numbers and
+//! \c SRZ_WIRE_ALIGNED to pad array payloads to their natural alignment;
+//! see Endian.h.
 //!
 //! The preferred way of serializing/deserializing data is through the
 //! \c Pack, \c UnPack and \c UnPackTuple functions.
@@ -38,9 +52,14 @@
 #pragma once
 #include <cstring>
 #include <vector>
+#include <array>
 #include <string>
 #include <type_traits>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
 
 #ifdef ZRF_UNSIGNED_CHAR
 using Byte = unsigned char;
@@ -52,10 +71,15 @@ static_assert(sizeof(char) == 1, "sizeof(char) != 1");
 #ifdef ZRF_int32_size
 #include <cstdint>
 using Size = int32_t;
+#elif defined(SRZ_WIRE_LE)
+//fixed width size in portable wire format
+using Size = uint64_t;
 #else
 using Size = size_t;
 #endif
 
+#include "Endian.h"
+
 //! Serialization framework
 namespace srz {
 using ByteArray = std::vector< Byte >;
@@ -65,27 +89,187 @@ using ConstByteIterator = ByteArray::const_iterator;
 template< typename T >
 struct GetSerializer;
 
+template< typename T >
+struct SerializeFields;
+
+namespace detail {
+//! \c Value is \c true if a field list was declared for type \c T with
+//! \c SRZ_FIELDS, see Fields.h.
+template< typename T >
+struct HasFields {
+    template< typename U >
+    static char Test(decltype(SrzFields(std::declval< U& >()))*);
+    template< typename U >
+    static long Test(...);
+    static const bool Value = sizeof(Test< T >(nullptr)) == 1;
+};
+}
+
+//! \defgroup Wire format
+//! Low level read/write of values in wire byte order and alignment padding
+//! of arrays.
+//!
+//! If \c SRZ_WIRE_ALIGNED is defined the payload of POD arrays is preceded
+//! by a one byte pad count followed by as many zero bytes as required to
+//! align the payload to the natural alignment of the element type; the pad
+//! is computed from the destination address, which for buffers allocated
+//! on the heap is equivalent to the offset from the start of the message.
+//! Decoders simply skip the pad bytes and can map aligned payloads
+//! directly (e.g. as a \c Float32Array in JavaScript).
+//! @{
+#ifdef SRZ_WIRE_ALIGNED
+const bool WireAligned = true;
+#else
+const bool WireAligned = false;
+#endif
+
+namespace detail {
+//! Write value in wire byte order.
+template< typename T, typename IteratorT >
+IteratorT Write(IteratorT i, const T& v) {
+    endian::StoreWire(&*i, v);
+    return i + sizeof(T);
+}
+
+//! Read value in wire byte order.
+template< typename T, typename IteratorT >
+IteratorT Read(IteratorT i, T& v) {
+    endian::LoadWire(v, &*i);
+    return i + sizeof(T);
+}
+
+//! Number of pad bytes following the pad count byte at \c position.
+template< typename T >
+size_t PadCount(std::uintptr_t position) {
+    const size_t a = std::alignment_of< T >::value;
+    return (a - (position + 1) % a) % a;
+}
+
+//! Upper bound of bytes inserted between length and payload of an array
+//! of \c T elements.
+template< typename T >
+size_t MaxPad() {
+    return WireAligned ? std::alignment_of< T >::value : 0;
+}
+
+//! Write alignment padding for an array of \c T elements.
+template< typename T, typename IteratorT >
+IteratorT WritePad(IteratorT i) {
+    if(!WireAligned) return i;
+    const size_t pad =
+        PadCount< T >(reinterpret_cast< std::uintptr_t >(&*i));
+    *i = Byte(pad);
+    memset(&*i + 1, 0, pad);
+    return i + 1 + pad;
+}
+
+//! Skip alignment padding.
+template< typename IteratorT >
+IteratorT SkipPad(IteratorT i) {
+    return WireAligned ? i + 1 + uint8_t(*i) : i;
+}
+
+//! Write array of POD elements: length, padding and payload.
+template< typename T, typename IteratorT >
+IteratorT WriteArray(IteratorT i, const T* data, size_t count) {
+    i = WritePad< T >(Write(i, Size(count)));
+    if(count) endian::CopyToWire(&*i, data, count);
+    return i + count * sizeof(T);
+}
+}
+//! @}
+
+//! \defgroup Validation
+//! Checks of serialized data against the end of the buffer, performed
+//! before unpacking untrusted data: the \c Validate method of serializers
+//! returns the pointer past the serialized value, or \c nullptr if the data
+//! is truncated or a declared length is invalid. Validating from a null
+//! pointer returns a null pointer, so that checks can be chained.
+//! @{
+namespace detail {
+//! Skip \c n bytes.
+inline const Byte* Skip(const Byte* p, const Byte* end, size_t n) {
+    return p && size_t(end - p) >= n ? p + n : nullptr;
+}
+
+//! Negative length: signed \c Size.
+template< typename S >
+bool NegativeSize(S s, std::true_type) { return s < S(0); }
+
+//! Negative length: unsigned \c Size, never.
+template< typename S >
+bool NegativeSize(S, std::false_type) { return false; }
+
+//! Return \c true if length read from data is negative; only possible
+//! with a signed \c Size, i.e. when \c ZRF_int32_size is defined.
+inline bool NegativeSize(Size s) {
+    return NegativeSize(s, std::is_signed< Size >());
+}
+
+//! Read length, negative lengths are invalid.
+inline const Byte* ReadSize(const Byte* p, const Byte* end, size_t& n) {
+    if(!Skip(p, end, sizeof(Size))) return nullptr;
+    Size s = 0;
+    p = Read(p, s);
+    if(NegativeSize(s)) return nullptr;
+    n = size_t(s);
+    return p;
+}
+
+//! Validate array of \c T elements: length, alignment padding if
+//! \c padded, payload.
+template< typename T >
+const Byte* ValidateArray(const Byte* p, const Byte* end, bool padded) {
+    size_t n = 0;
+    p = ReadSize(p, end, n);
+    if(p && padded && WireAligned) {
+        if(p == end || uint8_t(*p) >= std::alignment_of< T >::value)
+            return nullptr;
+        p = Skip(p, end, 1 + uint8_t(*p));
+    }
+    if(!p || n > size_t(end - p) / sizeof(T)) return nullptr;
+    return p + n * sizeof(T);
+}
+
+//! Validate length followed by elements validated by \c f; each element
+//! is assumed to take at least one byte, larger lengths are rejected
+//! without validating the elements.
+template< typename F >
+const Byte* ValidateElements(const Byte* p, const Byte* end, F f) {
+    size_t n = 0;
+    p = ReadSize(p, end, n);
+    if(!p || n > size_t(end - p)) return nullptr;
+    for(size_t i = 0; i != n && p; ++i) p = f(p);
+    return p;
+}
+}
+//! @}
+
 //Serializer definitions
 
 //! \defgroup Serializers
 //! @{
 //! Serialize POD data/
-//! Use \c memmove to copy data into buffer.
+//! Use \c memmove to copy data into buffer; arithmetic and enum types are
+//! written in wire byte order.
 template< typename T >
 struct SerializePOD {
     static ByteArray Pack(const T& d, ByteArray buf = ByteArray()) {
-        const Size sz = Size(buf.size());
+        const size_t sz = buf.size();
         buf.resize(buf.size() + sizeof(d));
-        memmove(buf.data() + sz, &d, sizeof(d));
+        Pack(d, buf.begin() + sz);
         return buf;
     }
-    static ByteIterator Pack(const T& d, ByteIterator i) {
-        memmove(&*i, &d, sizeof(d));
-        return i + sizeof(d);
+    template< typename IteratorT >
+    static IteratorT Pack(const T& d, IteratorT i) {
+        return detail::Write(i, d);
     }
-    static ConstByteIterator UnPack(ConstByteIterator i, T& d) {
-        memmove(&d, &*i, sizeof(T));
-        return i + sizeof(T);
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, T& d) {
+        return detail::Read(i, d);
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return detail::Skip(p, end, sizeof(T));
     }
     //size of serialized data
     static size_t Sizeof(const T& d) { return sizeof(d); }
@@ -104,14 +288,25 @@ struct Serialize {
         new(buf.data() + sz) T(d); //copy constructor
         return buf;
     }
-    static ByteIterator Pack(const T& d, ByteIterator i) {
+    template< typename IteratorT >
+    static IteratorT Pack(const T& d, IteratorT i) {
         new(&*i) T(d); //copy constructor
         return i + sizeof(d);
     }
-    static ConstByteIterator UnPack(ConstByteIterator i, T& d) {
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, T& d) {
         d = *reinterpret_cast< const T* >(&*i); //assignment operator
         return i + sizeof(T);
     }
+    //! Only trivially copyable types can be validated: the object
+    //! representation of other types, e.g. tuples holding strings,
+    //! contains pointers read from the data.
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        static_assert(std::is_trivially_copyable< T >::value,
+                      "srz: type not trivially copyable, cannot be "
+                      "unpacked from untrusted data");
+        return detail::Skip(p, end, sizeof(T));
+    }
     //size of serialized data
     static size_t Sizeof(const T& d) { return sizeof(d); }
 };
@@ -124,14 +319,18 @@ struct SerializePair {
     using FS = typename GetSerializer< F >::Type;
     using SS = typename GetSerializer< S >::Type;
     static ByteArray Pack(const P& p, ByteArray buf = ByteArray()) {
-        buf = FS::Pack(p.first, buf);
-        return SS::Pack(p.second, buf);
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(p));
+        buf.resize(Pack(p, buf.begin() + sz) - buf.begin());
+        return buf;
     }
-    static ByteIterator Pack(const P& p, ByteIterator i) {
+    template< typename IteratorT >
+    static IteratorT Pack(const P& p, IteratorT i) {
         i = FS::Pack(p.first, i);
         return SS::Pack(p.second, i);
     }
-    static ConstByteIterator UnPack(ConstByteIterator i, P& d) {
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, P& d) {
         F f;
         S s;
         i = FS::UnPack(i, f);
@@ -139,6 +338,9 @@ struct SerializePair {
         d = std::make_pair(f, s);
         return i;
     }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return SS::Validate(FS::Validate(p, end), end);
+    }
     //size of serialized data
     static size_t Sizeof(const P& p) {
         return FS::Sizeof(p.first) + SS::Sizeof(p.second);
@@ -151,29 +353,29 @@ struct SerializeVectorPOD {
     using ST = Size;//typename std::vector< T >::size_type;
     static ByteArray Pack(const std::vector< T >& d,
                           ByteArray buf = ByteArray()) {
-        const Size sz = Size(buf.size());
-        const ST s = ST(d.size());
-        buf.resize(buf.size() + sizeof(T) * d.size() + sizeof(ST));
-        memmove(buf.data() + sz, &s, sizeof(s));
-        memmove(buf.data() + sz + sizeof(s), d.data(), sizeof(T) * d.size());
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
         return buf;
     }
-    static ByteIterator Pack(const std::vector< T >& d, ByteIterator i) {
-        const ST s = d.size();
-        memmove(&*i, &s, sizeof(s));
-        memmove(&*i + sizeof(s), d.data(), d.size() * sizeof(T));
-        return i + sizeof(T) * d.size() + sizeof(s);
+    template< typename IteratorT >
+    static IteratorT Pack(const std::vector< T >& d, IteratorT i) {
+        return detail::WriteArray(i, d.data(), d.size());
     }
-    static ConstByteIterator UnPack(ConstByteIterator i, std::vector< T >& d) {
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, std::vector< T >& d) {
         ST s = 0;
-        memmove(&s, &*i, sizeof(s));
+        i = detail::SkipPad(detail::Read(i, s));
         d.resize(s);
-        memmove(d.data(), &*(i + sizeof(s)), s * sizeof(T));
-        return i + sizeof(s) + sizeof(T) * s;
+        if(s) endian::CopyFromWire(d.data(), &*i, s);
+        return i + sizeof(T) * s;
     }
-    //size of serialized data
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return detail::ValidateArray< T >(p, end, true);
+    }
+    //size of serialized data; upper bound if \c SRZ_WIRE_ALIGNED is defined
     static size_t Sizeof(const std::vector< T >& v) {
-        const size_t sz = sizeof(Size);
+        const size_t sz = sizeof(Size) + detail::MaxPad< T >();
         const size_t bs = sizeof(T) * v.size();
         return  sz + bs;
     }
@@ -188,19 +390,15 @@ struct SerializeVector {
         typename std::remove_cv< T >::type >::Type;
     static ByteArray Pack(const std::vector< T >& d,
                           ByteArray buf = ByteArray()) {
-        const Size sz = Size(buf.size());
-        const Size s = Size(d.size());
-        buf.resize(buf.size() + sizeof(s));
-        memmove(buf.data() + sz, &s, sizeof(s));
-        for(decltype(d.cbegin()) i = d.cbegin(); i != d.cend(); ++i) {
-            buf = TS::Pack(*i, buf);
-        }
+        //compute size first and resize buffer once
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
         return buf;
     }
-    static ByteIterator Pack(const std::vector< T >& d, ByteIterator bi) {
-        const ST s = ST(d.size());
-        memmove(&*bi, &s, sizeof(s));
-        bi += sizeof(s);
+    template< typename IteratorT >
+    static IteratorT Pack(const std::vector< T >& d, IteratorT bi) {
+        bi = detail::Write(bi, ST(d.size()));
 #if __cplusplus == 201402L
         for (decltype(cbegin(d)) i = cbegin(d); i != cend(d); ++i) {
             bi = TS::Pack(*i, bi);
@@ -212,18 +410,20 @@ struct SerializeVector {
 #endif
         return bi;
     }
-    static ConstByteIterator UnPack(ConstByteIterator bi, std::vector< T >& d) {
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT bi, std::vector< T >& d) {
         ST s = 0;
-        memmove(&s, &*bi, sizeof(s));
-        bi += sizeof(s);
-        d.reserve(s);
-        for (ST i = 0; i != s; ++i) {
-            T data;
-            bi = TS::UnPack(bi, data);
-            d.push_back(std::move(data));
-        }
+        bi = detail::Read(bi, s);
+        //unpack in place: existing elements are reused, e.g. by UnPackInto
+        d.resize(s);
+        for(auto& e: d) bi = TS::UnPack(bi, e);
         return bi;
     }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return detail::ValidateElements(p, end, [end](const Byte* e) {
+            return TS::Validate(e, end);
+        });
+    }
     //!size of serialized data
     //! @warning O(n) operation
     static size_t Sizeof(const std::vector< T >& v) {
@@ -238,76 +438,333 @@ struct SerializeVector {
 //! \c std::string serialization.
 struct SerializeString {
     using T = std::string::value_type;
-    using V = std::vector< T >;
     static ByteArray Pack(const std::string& d,
                           ByteArray buf = ByteArray()) {
-        return SerializeVectorPOD< T >::Pack(V(d.begin(), d.end()), buf);
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
+        return buf;
     }
-    static ByteIterator Pack(const std::string& d, ByteIterator bi) {
-        return SerializeVectorPOD< T >::Pack(V(d.begin(), d.end()), bi);
+    //same layout as \c SerializeVectorPOD without alignment padding,
+    //written without copying the string into a temporary vector
+    template< typename IteratorT >
+    static IteratorT Pack(const std::string& d, IteratorT bi) {
+        bi = detail::Write(bi, Size(d.size()));
+        if(!d.empty()) memmove(&*bi, d.data(), d.size() * sizeof(T));
+        return bi + d.size() * sizeof(T);
     }
-    static ConstByteIterator UnPack(ConstByteIterator bi, std::string& d) {
-        V v;
-        bi = SerializeVectorPOD< T >::UnPack(bi, v);
-        d = std::string(v.begin(), v.end());
-        return bi;
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT bi, std::string& d) {
+        Size s = 0;
+        bi = detail::Read(bi, s);
+        //assign from char pointer: reuses capacity; the iterator must
+        //refer to contiguous memory, read as chars whatever its value type
+        d.assign(s ? reinterpret_cast< const T* >(&*bi) : nullptr, size_t(s));
+        return bi + s;
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return detail::ValidateArray< T >(p, end, false);
     }
     //size of serialized data
     static size_t Sizeof(const std::string& v) {
-        return sizeof(size_t) + v.size() * sizeof(T);
+        return sizeof(Size) + v.size() * sizeof(T);
     }
 };
 
-//! Specialization for \c std::map
+namespace detail {
+//! \c value is \c true if keys and values are both serialized as POD data,
+//! in which case maps are serialized as an array of keys followed by an
+//! array of values.
+template< typename K, typename T >
+struct FlatMapLayout {
+    static const bool value =
+        std::is_same< typename GetSerializer< K >::Type,
+                      SerializePOD< K > >::value
+        && std::is_same< typename GetSerializer< T >::Type,
+                         SerializePOD< T > >::value;
+};
+
+//! Validate array of keys followed by array of values of the same length.
 template< typename K, typename T >
+const Byte* ValidateFlatMap(const Byte* p, const Byte* end) {
+    const Byte* values = ValidateArray< K >(p, end, true);
+    const Byte* e = ValidateArray< T >(values, end, true);
+    if(!e) return nullptr;
+    Size nk = 0, nv = 0;
+    Read(p, nk);
+    Read(values, nv);
+    return nk == nv ? e : nullptr;
+}
+
+//! Reserve space for \c n elements in hash maps before inserting.
+template< typename MapT >
+void ReserveMap(MapT&, size_t) {}
+
+template< typename K, typename T, typename H, typename E, typename A >
+void ReserveMap(std::unordered_map< K, T, H, E, A >& m, size_t n) {
+    m.reserve(n);
+}
+}
+
+//! Specialization for associative containers: \c std::map and
+//! \c std::unordered_map.
+//! Maps with POD keys and values are serialized as \c std::vector< K >
+//! followed by \c std::vector< T >, the size is computed in constant
+//! time; other maps as the number of elements followed by key, value
+//! pairs. Elements are inserted with a hint, in constant time for sorted
+//! data.
+template< typename K, typename T, typename MapT = std::map< K, T > >
 struct SerializeMap {
     using KS = typename GetSerializer< K >::Type;
     using VS = typename GetSerializer< T >::Type;
     using SS = SerializePOD< Size >;
-    static ByteArray Pack(const std::map< K, T >& m,
-                          ByteArray buf = ByteArray()) {
-        buf = SS::Pack(m.size(), buf);
+    using Flat = std::integral_constant< bool,
+                                         detail::FlatMapLayout< K, T >::value >;
+    static ByteArray Pack(const MapT& m, ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(m));
+        buf.resize(Pack(m, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const MapT& m, IteratorT bi) {
+        return Pack(m, bi, Flat());
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT bi, MapT& d) {
+        d.clear();
+        return UnPack(bi, d, Flat());
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        if(Flat::value) return detail::ValidateFlatMap< K, T >(p, end);
+        return detail::ValidateElements(p, end, [end](const Byte* e) {
+            return VS::Validate(KS::Validate(e, end), end);
+        });
+    }
+    //! Compute size of serialized data; upper bound if
+    //! \c SRZ_WIRE_ALIGNED is defined
+    //! @warning O(n) operation unless keys and values are POD
+    static size_t Sizeof(const MapT& m) {
+        if(Flat::value)
+            return 2 * sizeof(Size) + detail::MaxPad< K >()
+                   + detail::MaxPad< T >() + m.size() * (sizeof(K) + sizeof(T));
+        size_t size = sizeof(Size);
         for(auto& mi: m) {
-            buf = KS::Pack(mi.first, buf);
-            buf = VS::Pack(mi.second, buf);
+            size += KS::Sizeof(mi.first);
+            size += VS::Sizeof(mi.second);
         }
-        return buf;
+        return size;
+    }
+private:
+    template< typename IteratorT >
+    static IteratorT Pack(const MapT& m, IteratorT bi, std::true_type) {
+        bi = detail::WritePad< K >(detail::Write(bi, Size(m.size())));
+        for(auto& mi: m) bi = detail::Write(bi, mi.first);
+        bi = detail::WritePad< T >(detail::Write(bi, Size(m.size())));
+        for(auto& mi: m) bi = detail::Write(bi, mi.second);
+        return bi;
     }
-    static ByteIterator Pack(const std::map< K, T >& m, ByteIterator bi) {
-        bi = SS::Pack(m.size(), bi);
+    template< typename IteratorT >
+    static IteratorT Pack(const MapT& m, IteratorT bi, std::false_type) {
+        bi = SS::Pack(Size(m.size()), bi);
         for(auto& mi: m) {
             bi = KS::Pack(mi.first, bi);
             bi = VS::Pack(mi.second, bi);
         }
         return bi;
     }
-    static ConstByteIterator UnPack(ConstByteIterator bi,
-                                    std::map< K, T >& d) {
-
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT bi, MapT& d, std::true_type) {
+        Size n = 0, nv = 0;
+        IteratorT keys = detail::SkipPad(detail::Read(bi, n));
+        bi = detail::SkipPad(detail::Read(keys + n * sizeof(K), nv));
+        if(nv != n) throw std::runtime_error("srz: map size mismatch");
+        detail::ReserveMap(d, size_t(n));
+        for(Size i = 0; i != n; ++i) {
+            K key;
+            T value;
+            detail::Read(keys + i * sizeof(K), key);
+            detail::Read(bi + i * sizeof(T), value);
+            d.emplace_hint(d.end(), key, value);
+        }
+        return bi + n * sizeof(T);
+    }
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT bi, MapT& d, std::false_type) {
         Size size = 0;
         bi = SS::UnPack(bi, size);
+        detail::ReserveMap(d, size_t(size));
         for(Size i = 0; i != size; ++i) {
             K key;
             T value;
             bi = KS::UnPack(bi, key);
             bi = VS::UnPack(bi, value);
-            d.insert(std::make_pair(key, value));
+            d.emplace_hint(d.end(), std::move(key), std::move(value));
         }
         return bi;
     }
-    //! Compute size of serialized data
-    //! @warning O(n) operation
-    static size_t Sizeof(const std::map< K, T >& m) {
-        size_t size = sizeof(size_t);
-        for(auto& mi: m) {
-            size += KS::Sizeof(mi.first);
-            size += VS::Sizeof(mi.second);
-        }
-        return size;
+};
+
+
+//! \defgroup Views
+//! Non-owning views over serialized data: de-serializing into a view does
+//! not copy the payload, the view points directly into the serialized
+//! buffer and is valid only as long as the buffer is.
+//! @{
+
+//! Non-owning view of an array of POD elements.
+//! If the serialized elements are not properly aligned for type \c T the
+//! elements are copied into storage owned by the view, check with
+//! @c Copied(); call @c RequireInPlace() to turn the fallback copy into an
+//! error.
+template< typename T >
+class ArrayView {
+    static_assert(std::is_pod< T >::value, "ArrayView requires POD type");
+public:
+    using value_type = T;
+    using const_iterator = const T*;
+    ArrayView() : data_(nullptr), size_(0) {}
+    ArrayView(const T* data, size_t size) : data_(data), size_(size) {}
+    ArrayView(const std::vector< T >& v) : data_(v.data()), size_(v.size()) {}
+    const T* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    //! \c true if data was copied because not aligned in the source buffer.
+    bool Copied() const { return bool(copy_); }
+    //! Throw \c std::runtime_error if data was copied.
+    void RequireInPlace() const {
+        if(Copied())
+            throw std::runtime_error("ArrayView: misaligned data copied");
+    }
+    //! Copy elements into new vector.
+    std::vector< T > ToVector() const {
+        return std::vector< T >(begin(), end());
+    }
+    //! \c true if address is properly aligned for type \c T.
+    static bool Aligned(const void* p) {
+        return reinterpret_cast< std::uintptr_t >(p)
+               % std::alignment_of< T >::value == 0;
     }
+    //! Create view on serialized data, copying elements if misaligned.
+    static ArrayView FromBytes(const void* p, size_t size) {
+        if(size == 0 || Aligned(p))
+            return ArrayView(reinterpret_cast< const T* >(p), size);
+        std::vector< T > v(size);
+        memmove(v.data(), p, size * sizeof(T));
+        return Own(std::move(v));
+    }
+    //! Create view owning a copy of the data.
+    static ArrayView Own(std::vector< T >&& data) {
+        ArrayView v;
+        v.copy_ = std::make_shared< std::vector< T > >(std::move(data));
+        v.data_ = v.copy_->data();
+        v.size_ = v.copy_->size();
+        return v;
+    }
+private:
+    const T* data_;
+    size_t size_;
+    //! Owned copy of misaligned data.
+    std::shared_ptr< std::vector< T > > copy_;
 };
 
+//! Non-owning view of a string; no alignment requirements.
+class StringView {
+public:
+    using value_type = char;
+    using const_iterator = const char*;
+    StringView() : data_(nullptr), size_(0) {}
+    StringView(const char* data, size_t size) : data_(data), size_(size) {}
+    StringView(const std::string& s) : data_(s.data()), size_(s.size()) {}
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    const char& operator[](size_t i) const { return data_[i]; }
+    //! Copy characters into new string.
+    std::string ToString() const { return std::string(data_, size_); }
+    bool operator==(const StringView& s) const {
+        return size_ == s.size_
+               && (size_ == 0 || memcmp(data_, s.data_, size_) == 0);
+    }
+    bool operator!=(const StringView& s) const { return !(*this == s); }
+private:
+    const char* data_;
+    size_t size_;
+};
+
+//! Serialize \c ArrayView: same layout as \c SerializeVectorPOD, data
+//! can be unpacked into either a view or a vector.
+template< typename T >
+struct SerializeArrayView {
+    static ByteArray Pack(const ArrayView< T >& d,
+                          ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const ArrayView< T >& d, IteratorT i) {
+        return detail::WriteArray(i, d.Data(), d.Size());
+    }
+    //! Point view to data in buffer, no copy unless data is misaligned or
+    //! needs byte swapping.
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, ArrayView< T >& d) {
+        Size s = 0;
+        i = detail::SkipPad(detail::Read(i, s));
+        if(!s) d = ArrayView< T >();
+        else if(endian::SwapOnWire< T >::value) {
+            std::vector< T > v(s);
+            endian::CopyFromWire(v.data(), &*i, s);
+            d = ArrayView< T >::Own(std::move(v));
+        } else d = ArrayView< T >::FromBytes(&*i, size_t(s));
+        return i + sizeof(T) * s;
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return detail::ValidateArray< T >(p, end, true);
+    }
+    static size_t Sizeof(const ArrayView< T >& d) {
+        return sizeof(Size) + detail::MaxPad< T >() + d.Size() * sizeof(T);
+    }
+};
 
+//! Serialize \c StringView: same layout as \c SerializeString.
+struct SerializeStringView {
+    static ByteArray Pack(const StringView& d, ByteArray buf = ByteArray()) {
+        const size_t sz = buf.size();
+        buf.resize(sz + Sizeof(d));
+        buf.resize(Pack(d, buf.begin() + sz) - buf.begin());
+        return buf;
+    }
+    template< typename IteratorT >
+    static IteratorT Pack(const StringView& d, IteratorT i) {
+        i = detail::Write(i, Size(d.Size()));
+        if(d.Size()) memmove(&*i, d.Data(), d.Size());
+        return i + d.Size();
+    }
+    //! Point view to data in buffer, never copies.
+    template< typename IteratorT >
+    static IteratorT UnPack(IteratorT i, StringView& d) {
+        Size s = 0;
+        i = detail::Read(i, s);
+        d = s ? StringView(reinterpret_cast< const char* >(&*i), size_t(s))
+              : StringView();
+        return i + s;
+    }
+    static const Byte* Validate(const Byte* p, const Byte* end) {
+        return detail::ValidateArray< char >(p, end, false);
+    }
+    static size_t Sizeof(const StringView& d) {
+        return sizeof(Size) + d.Size();
+    }
+};
+//! @}
 
 //! @}
 
@@ -319,7 +776,8 @@ struct SerializeMap {
 template< typename T >
 struct GetSerializer< std::vector< T > > {
     using NCV = typename std::remove_cv< T >::type;
-    using Type = typename std::conditional< std::is_pod< NCV >::value,
+    using Type = typename std::conditional< std::is_pod< NCV >::value
+                                            && !detail::HasFields< NCV >::Value,
                                             SerializeVectorPOD< NCV >,
                                             SerializeVector< NCV > >::type;
 };
@@ -337,12 +795,16 @@ struct GetSerializer< volatile std::vector< T > > {
 };
 
 //! Select serializer for scalar type; also removing \cv qualifiers.
+//! Types with a field list are serialized field by field.
 template< typename T >
 struct GetSerializer {
     using NCV = typename std::remove_cv< T >::type;
-    using Type = typename std::conditional< std::is_pod< NCV >::value,
-                                            SerializePOD< NCV >,
-                                            Serialize< NCV > >::type;
+    using Type = typename std::conditional<
+        detail::HasFields< NCV >::Value,
+        SerializeFields< NCV >,
+        typename std::conditional< std::is_pod< NCV >::value,
+                                   SerializePOD< NCV >,
+                                   Serialize< NCV > >::type >::type;
 };
 
 //! Select serializer for \c std::string.
@@ -428,6 +890,46 @@ struct GetSerializer< std::map< K, T > > {
     using Type = SerializeMap< K, T >;
 };
 
+template < typename K, typename T >
+struct GetSerializer< const std::map< K, T > > {
+    using Type = SerializeMap< K, T >;
+};
+
+//! Select serializer for \c std::unordered_map.
+template < typename K, typename T >
+struct GetSerializer< std::unordered_map< K, T > > {
+    using Type = SerializeMap< K, T, std::unordered_map< K, T > >;
+};
+
+template < typename K, typename T >
+struct GetSerializer< const std::unordered_map< K, T > > {
+    using Type = SerializeMap< K, T, std::unordered_map< K, T > >;
+};
+
+//! Select serializer for \c ArrayView.
+template< typename T >
+struct GetSerializer< ArrayView< T > > {
+    using Type = SerializeArrayView< T >;
+};
+
+//! Select serializer for \c [const ArrayView].
+template< typename T >
+struct GetSerializer< const ArrayView< T > > {
+    using Type = SerializeArrayView< T >;
+};
+
+//! Select serializer for \c StringView.
+template<>
+struct GetSerializer< StringView > {
+    using Type = SerializeStringView;
+};
+
+//! Select serializer for \c [const StringView].
+template<>
+struct GetSerializer< const StringView > {
+    using Type = SerializeStringView;
+};
+
 //! \defgroup raw pointer serialization
 //! Prevent from automatically serializing raw pointers.
 //! @{
@@ -441,24 +943,99 @@ struct GetSerializer< volatile T* >;
 //! @}
 
 
-//! \defgroup Packing/Unpacking
-//! Serialize data to byte array: void specialization.
-inline ByteArray Pack(ByteArray&& ba) {
-    return ba;
+//! \defgroup Size computation
+//! @{
+namespace detail {
+//! Size of serialized data known at compile time: \c Value is the number of
+//! bytes written by fixed-size serializers, zero otherwise.
+template< typename S >
+struct StaticSize {
+    static const size_t Value = 0;
+};
+
+template< typename T >
+struct StaticSize< SerializePOD< T > > {
+    static const size_t Value = sizeof(T);
+};
+
+#ifndef SRZ_DISABLE_DEFAULT
+//! Generic serializer: fixed size only for trivially copyable types, the
+//! object representation of other types is not their value.
+template< typename T >
+struct StaticSize< Serialize< T > > {
+    static const size_t Value =
+        std::is_trivially_copyable< T >::value ? sizeof(T) : 0;
+};
+#endif
+
+template< typename F, typename S >
+struct StaticSize< SerializePair< F, S > > {
+    static const size_t FV =
+        StaticSize< typename GetSerializer< F >::Type >::Value;
+    static const size_t SV =
+        StaticSize< typename GetSerializer< S >::Type >::Value;
+    static const size_t Value = FV && SV ? FV + SV : 0;
+};
+
+//! Sum of serialized sizes computed at run-time, termination condition.
+inline size_t SizeofArgs() { return 0; }
+
+//! Sum of serialized sizes computed at run-time.
+template< typename T, typename... ArgsT >
+size_t SizeofArgs(const T& h, const ArgsT&... t) {
+    return GetSerializer< T >::Type::Sizeof(h) + SizeofArgs(t...);
+}
 }
 
-//! Serialize data to byte array.
+//! Compile-time size of serialized arguments: \c Fixed is \c true if all
+//! the argument types have a fixed serialized size, in which case \c Value
+//! is the total size in bytes.
+template< typename... ArgsT >
+struct StaticSizeof;
+
+//! Compile-time size of serialized arguments, termination condition.
+template<>
+struct StaticSizeof<> {
+    static const bool Fixed = true;
+    static const size_t Value = 0;
+};
+
+//! Compile-time size of serialized arguments.
 template< typename T, typename... ArgsT >
-ByteArray Pack(ByteArray&& ba, const T& h, const ArgsT&... t) {
-    return Pack(GetSerializer< T >::Type::Pack(h, std::move(ba)), t...);
+struct StaticSizeof< T, ArgsT... > {
+    using S = typename GetSerializer< T >::Type;
+    static const bool Fixed = detail::StaticSize< S >::Value != 0
+                              && StaticSizeof< ArgsT... >::Fixed;
+    static const size_t Value = Fixed ? detail::StaticSize< S >::Value
+                                        + StaticSizeof< ArgsT... >::Value
+                                      : 0;
 };
 
-//! Serialize data into newly created byte array.
+//! Total size of serialized arguments, constant when all the types have a
+//! fixed serialized size.
 template< typename... ArgsT >
-ByteArray Pack(const ArgsT&... t) {
-    return Pack(ByteArray(), t...);
-};
+size_t Sizeof(const ArgsT&... t) {
+    return StaticSizeof< ArgsT... >::Fixed
+           ? size_t(StaticSizeof< ArgsT... >::Value)
+           : detail::SizeofArgs(t...);
+}
+//! @}
+
+namespace detail {
+//! Serialize data at position pointed by iterator, termination condition.
+template< typename IteratorT >
+IteratorT PackTo(IteratorT i) {
+    return i;
+}
+
+//! Serialize data at position pointed by any byte iterator.
+template< typename IteratorT, typename T, typename... ArgsT >
+IteratorT PackTo(IteratorT i, const T& h, const ArgsT&... t) {
+    return PackTo(GetSerializer< T >::Type::Pack(h, i), t...);
+}
+}
 
+//! \defgroup Packing/Unpacking
 //! Serialize data to byte array at position pointed by iterator,
 //! void specialization
 inline ByteIterator Pack(ByteIterator bi) {
@@ -468,25 +1045,84 @@ inline ByteIterator Pack(ByteIterator bi) {
 //! Serialize data to byte array at position pointed by iterator
 template< typename T, typename... ArgsT >
 ByteIterator Pack(ByteIterator&& bi, const T& h, const ArgsT&... t) {
-    return Pack(GetSerializer< T >::Type::Pack(h, std::move(bi)), t...);
+    return detail::PackTo(bi, h, t...);
 };
 
+//! Serialize data to raw memory; the memory area must be at least
+//! \c Sizeof(h, t...) bytes, the number of bytes written can be smaller
+//! when alignment padding is enabled.
+//! \return pointer to end of written data
+template< typename T, typename... ArgsT >
+Byte* Pack(Byte* p, const T& h, const ArgsT&... t) {
+    return detail::PackTo(p, h, t...);
+};
+
+//! Serialize data to byte array: void specialization.
+inline ByteArray Pack(ByteArray&& ba) {
+    return std::move(ba);
+}
+
+//! Serialize data to byte array.
+//! The total size is computed first, the buffer is resized once and data
+//! written through the iterator overloads; the buffer is then shrunk to the
+//! number of bytes actually written, smaller than the computed size when
+//! alignment padding is enabled.
+template< typename T, typename... ArgsT >
+ByteArray Pack(ByteArray&& ba, const T& h, const ArgsT&... t) {
+    const size_t sz = ba.size();
+    ba.resize(sz + Sizeof(h, t...));
+    ba.resize(Pack(ba.begin() + sz, h, t...) - ba.begin());
+    return std::move(ba);
+};
+
+//! Serialize data into newly created byte array.
+template< typename... ArgsT >
+ByteArray Pack(const ArgsT&... t) {
+    return Pack(ByteArray(), t...);
+};
 
 //! Serialize data to byte array in place, termination condition
 inline size_t Pack(ByteArray&) {
     return 0;
 }
 
-//! Serialize data to byte array in place
+//! Serialize data to byte array in place: data is appended to the array
+//! which is resized only once.
+//! \return number of bytes written
 template< typename T, typename... ArgsT >
 size_t Pack(ByteArray& ba, const T& h, const ArgsT&... t) {
     const size_t sz = ba.size();
-    const size_t size = GetSerializer< T >::Type::Sizeof(h);
-    ba.resize(sz + size);
-    GetSerializer< T >::Type::Pack(h, ba.begin() + sz);
-    return size + Pack(ba, t...);
+    ba.resize(sz + Sizeof(h, t...));
+    ba.resize(Pack(ba.begin() + sz, h, t...) - ba.begin());
+    return ba.size() - sz;
 };
 
+//! Fixed size message: array large enough for the serialized arguments,
+//! the size is a compile-time constant.
+template< typename... ArgsT >
+using FixedMessage = std::array< Byte, StaticSizeof< ArgsT... >::Value >;
+
+//! Serialize arguments of fixed size types into a \c std::array, e.g. on
+//! the stack: no heap memory is allocated.
+template< typename... ArgsT >
+FixedMessage< ArgsT... > PackFixed(const ArgsT&... args) {
+    static_assert(StaticSizeof< ArgsT... >::Fixed,
+                  "PackFixed requires fixed size types");
+    FixedMessage< ArgsT... > m;
+    detail::PackTo(m.data(), args...);
+    return m;
+}
+
+//! Serialize arguments of fixed size types into a caller provided buffer.
+//! \return pointer to end of written data
+template< size_t N, typename... ArgsT >
+Byte* PackFixed(Byte (&buf)[N], const ArgsT&... args) {
+    static_assert(StaticSizeof< ArgsT... >::Fixed,
+                  "PackFixed requires fixed size types");
+    static_assert(N >= StaticSizeof< ArgsT... >::Value, "Buffer too small");
+    return detail::PackTo(static_cast< Byte* >(buf), args...);
+}
+
 template< typename... ArgsT >
 ByteArray PackArgs(ArgsT...args) {
     return Pack(ByteArray(), args...);
@@ -495,10 +1131,10 @@ ByteArray PackArgs(ArgsT...args) {
 
 //! Return de-serialized data from byte array iterator
 //! (e.g. \code [const char*]).
-template< typename T >
+template< typename T, typename IteratorT >
 typename std::remove_reference<
     typename std::remove_cv< T >::type >::type
-UnPack(ConstByteIterator bi) {
+UnPack(IteratorT bi) {
     using U = typename std::remove_reference<
         typename std::remove_cv< T >::type >::type;
     U d;
@@ -508,8 +1144,8 @@ UnPack(ConstByteIterator bi) {
 
 //! De-serialize data from byte array iterator (e.g. \code [const char*])
 //! into reference.
-template< typename T >
-ConstByteIterator UnPack(ConstByteIterator bi, T& d) {
+template< typename T, typename IteratorT >
+IteratorT UnPack(IteratorT bi, T& d) {
     return GetSerializer< T >::Type::UnPack(bi, d);
 }
 
@@ -543,55 +1179,112 @@ struct GenSeq< 0, Ints... > {
     using Type = Seq< Ints... >;
 };
 
-//! Construct new tuple instance from new head element and other tuple, use
-//! compile time index sequence to expand parameter pack into \code[make_tuple]
-//! invocation.
-template< typename H, typename... T, size_t... Is >
-std::tuple< H, T... > TupleConsHelper(const H& h,
-                                      const std::tuple< T... >& t,
-                                      const Seq< Is... >&) {
-    return std::make_tuple(h, std::get< Is >(t)...);
+//! Unpack tuple elements in order, in place; works with tuples of values
+//! and tuples of references.
+template< typename IteratorT, typename TupleT, size_t... Is >
+IteratorT UnPackElements(IteratorT bi, TupleT&& t, const Seq< Is... >&) {
+    //braced initializer lists are evaluated left to right
+    const int sequence[] = {0, (bi = UnPack(bi, std::get< Is >(t)), 0)...};
+    (void) sequence;
+    return bi;
+}
+}
+
+//! Unpack consecutive values into existing variables, no temporaries are
+//! created: return updated iterator.
+//! \code
+//! int id; float x, y;
+//! i = UnPackInto(i, id, x, y);
+//! \endcode
+template< typename IteratorT, typename...ArgsT >
+IteratorT UnPackInto(IteratorT bi, ArgsT&... args) {
+    return detail::UnPackElements(
+        bi, std::tie(args...),
+        typename detail::GenSeq< sizeof...(ArgsT) >::Type());
 }
 
-//! Construct new tuple by addind head element to other tuple.
-template< typename H, typename...T >
-std::tuple< H, T... > TupleCons(const H& h, const std::tuple< T... >& t) {
-    return TupleConsHelper(h, t, typename GenSeq< sizeof...(T) >::Type());
+namespace detail {
+//! Validate consecutive values of types \c ArgsT.
+template< typename... ArgsT >
+struct ValidateArgs;
+
+template<>
+struct ValidateArgs<> {
+    static const Byte* Check(const Byte* p, const Byte*) { return p; }
 };
 
-//! Helper for unpacking element into tuple.
-template< typename T, typename...ArgsT >
-struct UnpackTHelper {
-    static std::tuple< T, ArgsT... > Unpack(ConstByteIterator& bi) {
-        T d = T();
-        bi = UnPack(bi, d);
-        std::tuple< ArgsT... > t =
-            UnpackTHelper< ArgsT... >::Unpack(bi);
-        return TupleCons(d, t);
+template< typename T, typename... ArgsT >
+struct ValidateArgs< T, ArgsT... > {
+    static const Byte* Check(const Byte* p, const Byte* end) {
+        return ValidateArgs< ArgsT... >::Check(
+            GetSerializer< T >::Type::Validate(p, end), end);
     }
 };
+}
 
-//! Helper for unpacking element into tuple: termination specialization.
+namespace detail {
+//! \c value is \c true if data unpacked by serializer \c S can be
+//! validated.
+template< typename S >
+struct ValidatableSerializer : std::true_type {};
+
+#ifndef SRZ_DISABLE_DEFAULT
 template< typename T >
-struct UnpackTHelper< T > {
-    static std::tuple< T > Unpack(ConstByteIterator& bi) {
-        T d = T();
-        bi = UnPack(bi, d);
-        return std::make_tuple(d);
-    }
-};
+struct ValidatableSerializer< Serialize< T > >
+    : std::is_trivially_copyable< T > {};
+#endif
+}
+
+//! \c value is \c false if values of type \c T cannot be validated, in
+//! which case \c Validate and \c UnPackChecked fail to compile: types
+//! copied by the generic serializer which are not trivially copyable.
+//! Elements of containers are not inspected.
+template< typename T >
+struct Validatable
+    : detail::ValidatableSerializer< typename GetSerializer< T >::Type > {};
+
+//! Check that [begin, end) starts with serialized values of types
+//! \c ArgsT: all the declared lengths are checked against the end of the
+//! data in a single pass, without unpacking.
+//! \return pointer past the values or \c nullptr if the data is invalid
+template< typename... ArgsT, typename ByteT >
+const ByteT* Validate(const ByteT* begin, const ByteT* end) {
+    static_assert(sizeof(ByteT) == 1, "byte pointer required");
+    const Byte* e = reinterpret_cast< const Byte* >(end);
+    const Byte* p = detail::ValidateArgs< ArgsT... >::Check(
+        reinterpret_cast< const Byte* >(begin), e);
+    return p ? begin + (p - reinterpret_cast< const Byte* >(begin))
+             : nullptr;
+}
+
+//! Unpack consecutive values received from untrusted sources, e.g.
+//! websocket clients: data is validated with \c Validate, then unpacked
+//! with \c UnPackInto; throws \c std::runtime_error if the data is
+//! invalid, in which case the arguments are not modified.
+//! \return pointer past the unpacked data
+template< typename ByteT, typename...ArgsT >
+const ByteT* UnPackChecked(const ByteT* begin, const ByteT* end,
+                           ArgsT&... args) {
+    if(!Validate< ArgsT... >(begin, end))
+        throw std::runtime_error("srz: invalid or truncated data");
+    return UnPackInto(begin, args...);
 }
 
 //! Unpack individual values into tuple: updated iterator
 template< typename...ArgsT >
 std::tuple< ArgsT... > UnPackTuple(ConstByteIterator& bi) {
-    return detail::UnpackTHelper< ArgsT... >::Unpack(bi);
+    //tuple is constructed once and filled in place
+    std::tuple< ArgsT... > t;
+    bi = detail::UnPackElements(
+        bi, t, typename detail::GenSeq< sizeof...(ArgsT) >::Type());
+    return t;
 }
 
 //! Unpack individual values into tuple: from temporary iterator (e.g. .begin())
 template< typename...ArgsT >
 std::tuple< ArgsT... > UnPackTuple(const ConstByteIterator& bi) {
-    return detail::UnpackTHelper< ArgsT... >::Unpack(bi);
+    ConstByteIterator i = bi;
+    return UnPackTuple< ArgsT... >(i);
 }
 
 
@@ -599,7 +1292,7 @@ std::tuple< ArgsT... > UnPackTuple(const ConstByteIterator& bi) {
 template< typename...ArgsT >
 std::tuple< ArgsT... > UnPackTuple(const ByteArray& ba) {
     ConstByteIterator bi = ba.begin();
-    return detail::UnpackTHelper< ArgsT... >::Unpack(bi);
+    return UnPackTuple< ArgsT... >(bi);
 }
 
 }
@@ -0,0 +1,150 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file Sinks.h
+//! \brief Output sinks: serialize data directly into external memory.
+//!
+//! A sink is any type exposing the interface:
+//! \code
+//! //return pointer to at least n writable bytes at the current position
+//! PointerT Reserve(size_t n);
+//! //advance current position by n <= reserved bytes
+//! void Commit(size_t n);
+//! \endcode
+//! where \c PointerT is a pointer to a byte type.
+//! \c Pack(sink, args...) computes the serialized size, reserves memory
+//! once, writes data in place and commits the number of bytes written.
+
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Serialize.h"
+
+namespace srz {
+
+//! Write into fixed size raw memory buffer; throws \c std::length_error
+//! if the buffer is not big enough.
+template< typename ByteT = Byte >
+class RawSink {
+public:
+    RawSink(ByteT* buffer, size_t capacity)
+        : buffer_(buffer), capacity_(capacity), size_(0) {}
+    ByteT* Reserve(size_t n) {
+        if(n > capacity_ - size_)
+            throw std::length_error("RawSink: buffer too small");
+        return buffer_ + size_;
+    }
+    void Commit(size_t n) { size_ += n; }
+    //! Number of bytes written.
+    size_t Size() const { return size_; }
+    size_t Capacity() const { return capacity_; }
+    ByteT* Data() const { return buffer_; }
+    //! Restart writing from the beginning of the buffer.
+    void Clear() { size_ = 0; }
+private:
+    ByteT* buffer_;
+    size_t capacity_;
+    size_t size_;
+};
+
+//! Append to growable vector; the vector can be reused across messages
+//! (e.g. taken from a pool) and keeps its capacity when cleared.
+template< typename VectorT = ByteArray >
+class VectorSink {
+public:
+    using ByteT = typename VectorT::value_type;
+    static_assert(sizeof(ByteT) == 1, "VectorSink requires byte vector");
+    //! Data is appended after current vector content.
+    explicit VectorSink(VectorT& v) : v_(v), size_(v.size()) {}
+    ByteT* Reserve(size_t n) {
+        v_.resize(size_ + n);
+        return v_.data() + size_;
+    }
+    void Commit(size_t n) {
+        size_ += n;
+        v_.resize(size_);
+    }
+    size_t Size() const { return size_; }
+    VectorT& Vector() const { return v_; }
+    //! Discard content, keep allocated memory.
+    void Clear() {
+        size_ = 0;
+        v_.resize(0);
+    }
+private:
+    VectorT& v_;
+    size_t size_;
+};
+
+//! Append to vector after a reserved region of \c padding bytes, e.g.
+//! \c LWS_PRE bytes required by libwebsockets in front of the data to send.
+template< typename VectorT = ByteArray >
+class PrePaddedSink : public VectorSink< VectorT > {
+public:
+    using ByteT = typename VectorT::value_type;
+    //! Vector content is discarded and replaced by \c padding bytes.
+    PrePaddedSink(VectorT& v, size_t padding)
+        : VectorSink< VectorT >(Init(v, padding)), padding_(padding) {}
+    size_t Padding() const { return padding_; }
+    //! Pointer to serialized data, after padding.
+    ByteT* Payload() const { return this->Vector().data() + padding_; }
+    //! Size of serialized data, excluding padding.
+    size_t PayloadSize() const { return this->Size() - padding_; }
+    //! Discard serialized data, keep padding.
+    void Clear() {
+        VectorSink< VectorT >::Clear();
+        this->Reserve(padding_);
+        this->Commit(padding_);
+    }
+private:
+    static VectorT& Init(VectorT& v, size_t padding) {
+        v.resize(padding);
+        return v;
+    }
+private:
+    size_t padding_;
+};
+
+namespace detail {
+//! \c Value is \c true if type implements the sink interface.
+template< typename S >
+struct IsSink {
+    template< typename U >
+    static char Test(decltype(std::declval< U& >().Reserve(size_t())
+                              + 0,
+                              std::declval< U& >().Commit(size_t()),
+                              0)*);
+    template< typename U >
+    static long Test(...);
+    static const bool Value = sizeof(Test< S >(nullptr)) == 1;
+};
+}
+
+//! Serialize data into sink: memory is reserved once for the whole
+//! message.
+//! \return number of bytes written
+template< typename SinkT, typename T, typename... ArgsT >
+typename std::enable_if< detail::IsSink< SinkT >::Value, size_t >::type
+Pack(SinkT& sink, const T& h, const ArgsT&... t) {
+    auto p = sink.Reserve(Sizeof(h, t...));
+    const size_t n = size_t(detail::PackTo(p, h, t...) - p);
+    sink.Commit(n);
+    return n;
+}
+
+}
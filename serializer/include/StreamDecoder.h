@@ -0,0 +1,214 @@
+#pragma once
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+//! \file StreamDecoder.h
+//! \brief Resumable decoder for messages received in fragments.
+//!
+//! The fields expected next are queued with \c Read and \c ReadChunks, each
+//! with an optional callback invoked as soon as the field is complete; the
+//! callback can queue the following fields, e.g. after reading a message id.
+//! Data is passed to \c Feed in chunks of any size, as received; strings and
+//! vectors are written straight into their destination and \c ReadChunks
+//! forwards array payloads to a sink without buffering, so the memory used
+//! does not depend on the message size.
+//! \code
+//! srz::StreamDecoder d;
+//! int id = 0;
+//! d.Read(id, [&]() {
+//!     if(id == UPLOAD)
+//!         d.ReadChunks< char >([&](const Byte* p, size_t n) {
+//!             file.write(reinterpret_cast< const char* >(p), n); });
+//! });
+//! //websocket callback
+//! d.Feed(in, len);
+//! \endcode
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Serialize.h"
+
+namespace srz {
+
+//! Resumable decoder: decode fields of a message from chunks of data.
+class StreamDecoder {
+public:
+    //! Invoked when a field is complete.
+    using Callback = std::function< void () >;
+    //! Receives chunks of array payload.
+    using ChunkSink = std::function< void (const Byte*, size_t) >;
+    //! Constructor.
+    //! \param maxSize maximum size in bytes of string and array payloads,
+    //! larger sizes throw \c std::runtime_error
+    explicit StreamDecoder(size_t maxSize = size_t(-1)) : maxSize_(maxSize) {}
+    //! Queue POD value.
+    template< typename T >
+    StreamDecoder& Read(T& v, Callback done = Callback()) {
+        static_assert(std::is_pod< T >::value, "POD type required");
+        return Queue(new ValueStep< T >(v), std::move(done));
+    }
+    //! Queue string, characters are appended as received.
+    StreamDecoder& Read(std::string& s, Callback done = Callback()) {
+        auto begin = [&s](size_t n) { s.resize(n); };
+        auto payload = [&s](const Byte* p, size_t n, size_t offset) {
+            memmove(&s[offset], p, n);
+        };
+        return Queue(new ArrayStep(1, false, maxSize_, begin, payload,
+                                   Callback()), std::move(done));
+    }
+    //! Queue vector of POD elements, received straight into the vector.
+    template< typename T >
+    StreamDecoder& Read(std::vector< T >& v, Callback done = Callback()) {
+        static_assert(std::is_pod< T >::value, "POD type required");
+        auto begin = [&v](size_t n) { v.resize(n); };
+        auto payload = [&v](const Byte* p, size_t n, size_t offset) {
+            memmove(reinterpret_cast< Byte* >(v.data()) + offset, p, n);
+        };
+        auto end = [&v]() {
+            if(!v.empty()) endian::CopyFromWire(v.data(), v.data(), v.size());
+        };
+        return Queue(new ArrayStep(sizeof(T), true, maxSize_, begin, payload,
+                                   end), std::move(done));
+    }
+    //! Queue array of \c T elements (\c std::vector or \c ArrayView on the
+    //! sending side), forwarding the payload to \c sink in wire byte order
+    //! as received.
+    template< typename T >
+    StreamDecoder& ReadChunks(ChunkSink sink, Callback done = Callback()) {
+        static_assert(std::is_pod< T >::value, "POD type required");
+        auto payload = [sink](const Byte* p, size_t n, size_t) {
+            sink(p, n);
+        };
+        return Queue(new ArrayStep(sizeof(T), true, maxSize_,
+                                   [](size_t) {}, payload, Callback()),
+                     std::move(done));
+    }
+    //! Consume data; invoke the callbacks of completed fields.
+    //! Throws \c std::runtime_error if data is received when no field is
+    //! expected or a size exceeds the limit.
+    void Feed(const void* data, size_t size) {
+        const Byte* p = reinterpret_cast< const Byte* >(data);
+        const Byte* end = p + size;
+        while(p != end) {
+            if(steps_.empty())
+                throw std::runtime_error("StreamDecoder: unexpected data");
+            Step& s = *steps_.front();
+            p = s.Consume(p, end);
+            if(s.Done()) Complete();
+        }
+    }
+    //! \c true if no more fields are expected.
+    bool Done() const { return steps_.empty(); }
+    //! Discard the expected fields, e.g. after a truncated message.
+    void Reset() { steps_.clear(); }
+private:
+    struct Step {
+        virtual ~Step() {}
+        //! Consume data in [p, end), return pointer past consumed data.
+        virtual const Byte* Consume(const Byte* p, const Byte* end) = 0;
+        virtual bool Done() const = 0;
+        Callback done;
+    };
+    //! Fixed size value, possibly split across chunks.
+    template< typename T >
+    struct ValueStep : Step {
+        explicit ValueStep(T& v) : value(v) {}
+        const Byte* Consume(const Byte* p, const Byte* end) {
+            const size_t n = std::min(size_t(end - p), sizeof(T) - received);
+            memmove(buffer + received, p, n);
+            received += n;
+            if(Done()) detail::Read(static_cast< const Byte* >(buffer), value);
+            return p + n;
+        }
+        bool Done() const { return received == sizeof(T); }
+        T& value;
+        Byte buffer[sizeof(T)];
+        size_t received = 0;
+    };
+    //! Array: length, padding, payload.
+    struct ArrayStep : Step {
+        using Begin = std::function< void (size_t) >;
+        using Payload = std::function< void (const Byte*, size_t, size_t) >;
+        ArrayStep(size_t es, bool padded, size_t maxSize, Begin b,
+                  Payload p, Callback e)
+            : elementSize(es), padded(padded && WireAligned),
+              maxSize(maxSize), begin(b), payload(p), end(e),
+              length(count) {}
+        const Byte* Consume(const Byte* p, const Byte* e) {
+            if(!length.Done()) {
+                p = length.Consume(p, e);
+                if(!length.Done()) return p;
+                if(detail::NegativeSize(count)
+                   || size_t(count) > maxSize / elementSize)
+                    throw std::runtime_error("StreamDecoder: invalid size");
+                bytes = size_t(count) * elementSize;
+                begin(size_t(count));
+                padding = padded ? -1 : 0;
+            }
+            if(padding < 0) {
+                if(p == e) return p;
+                padding = uint8_t(*p++);
+            }
+            const size_t skip = std::min(size_t(e - p), size_t(padding));
+            p += skip;
+            padding -= int(skip);
+            if(padding) return p;
+            const size_t n = std::min(size_t(e - p), bytes - received);
+            if(n) payload(p, n, received);
+            received += n;
+            if(Done() && end) end();
+            return p + n;
+        }
+        bool Done() const {
+            return length.Done() && padding == 0 && received == bytes;
+        }
+        size_t elementSize;
+        bool padded;
+        size_t maxSize;
+        Begin begin;
+        Payload payload;
+        Callback end;
+        Size count = 0;
+        ValueStep< Size > length;
+        int padding = -1;
+        size_t bytes = 0;
+        size_t received = 0;
+    };
+    StreamDecoder& Queue(Step* s, Callback done) {
+        s->done = std::move(done);
+        steps_.push_back(std::unique_ptr< Step >(s));
+        return *this;
+    }
+    //! Remove completed field then invoke its callback, which may queue
+    //! more fields.
+    void Complete() {
+        Callback done = std::move(steps_.front()->done);
+        steps_.pop_front();
+        if(done) done();
+    }
+private:
+    std::deque< std::unique_ptr< Step > > steps_;
+    size_t maxSize_;
+};
+
+}
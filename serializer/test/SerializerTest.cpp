@@ -21,6 +21,11 @@
 #include <vector>
 #include <iostream>
 #include <tuple>
+#include <stdexcept>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <cmath>
 
 #ifdef LOG__
 #include <algorithm>
@@ -29,10 +34,35 @@
 
 #include "Serialize.h"
 #include "BufferToVector.h"
+#include "Sinks.h"
+#include "Gather.h"
+#include "IntegerCodecs.h"
+#include "Fields.h"
+#include "JSDecoder.h"
+#include "StreamDecoder.h"
+#include "Compression.h"
+#include "Quantize.h"
+#include "FlatMap.h"
 
 using namespace std;
 using namespace srz;
 
+namespace test {
+struct Vec3 {
+    float x, y, z;
+};
+SRZ_FIELDS(Vec3, x, y, z)
+
+struct Particle {
+    int32_t id;
+    Vec3 pos;
+    bool alive;
+    string name;
+    vector< float > weights;
+};
+SRZ_FIELDS(Particle, id, pos, alive, name, weights)
+}
+
 int main(int, char**) {
 
 //1. GetSerializer
@@ -159,7 +189,41 @@ int main(int, char**) {
             UnPackTuple< vector< int >, int >(packet);
     assert((get<0>(pvOut) == vector< int >{1,2,3,4}));
     assert(get<1>(pvOut) == plen);
+    //from temporary iterator
+    assert((UnPackTuple< vector< int >, int >(packet.cbegin()) == pvOut));
+    //2.1.1 UnPackInto existing variables
+    {
+        const ByteArray b = Pack(7, string("text"), p, 2.5f);
+        int id = 0;
+        string t;
+        vector< int > v;
+        float f = 0;
+        assert(UnPackInto(b.data(), id, t, v, f) == b.data() + b.size());
+        assert(id == 7 && t == "text" && v == p && f == 2.5f);
+    }
+
 
+    //2.1.2 fixed size messages
+    {
+        const auto m = PackFixed(3, 2.5, 'c', make_pair(1, 2.f));
+        static_assert(tuple_size< decltype(m) >::value
+                      == sizeof(int) * 2 + sizeof(double) + 1 + sizeof(float),
+                      "compile-time size");
+        assert(ByteArray(m.begin(), m.end())
+               == Pack(3, 2.5, 'c', make_pair(1, 2.f)));
+        Byte buf[64];
+        assert(PackFixed(buf, 3, 2.5) == buf + sizeof(int) + sizeof(double));
+        assert(UnPack< double >(buf + sizeof(int)) == 2.5);
+        static_assert(!StaticSizeof< int, string >::Fixed,
+                      "strings have variable size");
+        struct Named {
+            int id;
+            string name;
+        };
+        static_assert(!StaticSizeof< Named >::Fixed
+                      && !StaticSizeof< shared_ptr< int > >::Fixed,
+                      "not trivially copyable types have no fixed size");
+    }
 
     //2.2 Pack/Unpack vector<pair>
     const vector< pair<string,int> > m = {{"1",2},{"3",4}};
@@ -175,6 +239,589 @@ int main(int, char**) {
     UnPack(begin(mpacket), mOut);
     assert(mOut == m);
 
+//3. Views
+
+    //3.1 unpack from raw pointer
+    const ByteArray rp = Pack(7, string("raw"));
+    const char* raw = rp.data();
+    int rpi = 0;
+    string rps;
+    raw = UnPack(UnPack(raw, rpi), rps);
+    assert(rpi == 7 && rps == "raw");
+    assert(raw == rp.data() + rp.size());
+
+    //3.2 views point into buffer; same layout as vector and string
+    const vector< float > fv = {1.f, 2.f, 3.f};
+    const ByteArray vb = Pack(fv, string("text"));
+    ArrayView< float > fview;
+    StringView sview;
+    UnPack(UnPack(vb.begin(), fview), sview);
+    assert(fview.Size() == 3 && !fview.Copied());
+    assert(reinterpret_cast< const char* >(fview.Data())
+           == vb.data() + sizeof(Size));
+    assert(fview.ToVector() == fv);
+    assert(sview.ToString() == "text");
+    assert(sview.Data() > vb.data() && sview.Data() < vb.data() + vb.size());
+    //packing a view produces the same bytes as packing a vector
+    assert(Pack(ArrayView< float >(fv), StringView("text", 4)) == vb);
+
+    //3.3 misaligned data: checked fallback copy
+    ByteArray mis(1);
+    Pack(mis, fv);
+    ArrayView< float > mview;
+    UnPack(mis.begin() + 1, mview);
+    assert(mview.Copied());
+    assert(mview.ToVector() == fv);
+    bool thrown = false;
+    try {
+        mview.RequireInPlace();
+    } catch(const runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+//4. Sinks
+
+    //4.1 fixed raw buffer
+    const ByteArray ref41 = Pack(1, string("sink"), fv);
+    Byte raw41[64];
+    RawSink<> rs(raw41, sizeof(raw41));
+    assert(Pack(rs, 1, string("sink"), fv) == ref41.size());
+    assert(ByteArray(raw41, raw41 + rs.Size()) == ref41);
+    RawSink<> small(raw41, 4);
+    thrown = false;
+    try {
+        Pack(small, 1, 2);
+    } catch(const length_error&) {
+        thrown = true;
+    }
+    assert(thrown && small.Size() == 0);
+
+    //4.2 growable vector, appends and keeps capacity when cleared
+    ByteArray grow;
+    VectorSink<> vs(grow);
+    Pack(vs, 1, string("sink"));
+    Pack(vs, fv);
+    assert(grow == ref41);
+    const size_t cap = grow.capacity();
+    vs.Clear();
+    Pack(vs, 1);
+    assert(grow.size() == sizeof(int) && grow.capacity() == cap);
+
+    //4.3 pre-padded vector of different byte type
+    vector< unsigned char > padded(3, 0xff);
+    PrePaddedSink< vector< unsigned char > > ps(padded, 16);
+    Pack(ps, 1, string("sink"), fv);
+    assert(padded.size() == 16 + ref41.size());
+    assert(ps.PayloadSize() == ref41.size());
+    assert(memcmp(ps.Payload(), ref41.data(), ref41.size()) == 0);
+    ps.Clear();
+    assert(padded.size() == 16 && ps.PayloadSize() == 0);
+
+//5. Gather
+
+    //large payloads referenced, small ones and headers inline; segments
+    //concatenated match contiguous serialization
+    const vector< float > big(1000, 2.f);
+    const string bigs(500, 'x');
+    GatherBuffer gb(256);
+    PackGather(gb, 1, big, string("small"), bigs, fv);
+    assert(gb.Flatten() == Pack(1, big, string("small"), bigs, fv));
+    const vector< GatherBuffer::Segment > segs = gb.Segments();
+    assert(segs.size() == 5);
+    assert(segs[1].first == big.data());
+    assert(segs[1].second == big.size() * sizeof(float));
+    assert(segs[3].first == bigs.data());
+    assert(gb.InlineSize() == gb.Size() - segs[1].second - segs[3].second);
+
+//6. Integer encodings
+
+    //6.1 round trip and size reduction of monotonic ids and small counts
+    vector< uint32_t > ids(1000);
+    vector< int32_t > counts(1000);
+    for(size_t i = 0; i != ids.size(); ++i) {
+        ids[i] = uint32_t(100000 + 3 * i);
+        counts[i] = int32_t(i % 13) - 6;
+    }
+    const ByteArray plain = Pack(ids, counts);
+    const ByteArray varint = Pack(AsVarint(ids), AsZigZag(counts));
+    const ByteArray delta = Pack(AsDelta(ids), AsBitPacked(counts));
+    const ByteArray packed = Pack(AsDeltaBitPacked(ids), AsBitPacked(counts));
+    assert(varint.size() < plain.size() * 2 / 3);
+    assert(packed.size() < plain.size() / 4);
+    Encoded< uint32_t, DeltaBitPacked > idsIn;
+    Encoded< int32_t, BitPacked > countsIn;
+    UnPack(UnPack(packed.data(), idsIn), countsIn);
+    assert(idsIn.ToVector() == ids && countsIn.ToVector() == counts);
+    Encoded< uint32_t, Delta > didsIn;
+    UnPack(delta.data(), didsIn);
+    assert(didsIn.ToVector() == ids);
+    Encoded< uint32_t, Varint > vidsIn;
+    Encoded< int32_t, ZigZag > zcountsIn;
+    UnPack(UnPack(varint.data(), vidsIn), zcountsIn);
+    assert(vidsIn.ToVector() == ids && zcountsIn.ToVector() == counts);
+    //6.2 extreme values, 64 bit, empty and partial blocks
+    const vector< int64_t > ext = {0, -1, 1, numeric_limits< int64_t >::min(),
+                                   numeric_limits< int64_t >::max(), -5};
+    Encoded< int64_t, Delta > extIn;
+    UnPack(Pack(AsDelta(ext)).data(), extIn);
+    assert(extIn.ToVector() == ext);
+    const vector< uint16_t > empty;
+    Encoded< uint16_t, BitPacked > emptyIn;
+    UnPack(Pack(AsBitPacked(empty)).data(), emptyIn);
+    assert(emptyIn.Empty());
+    for(size_t n: {1, 127, 128, 129, 300}) {
+        vector< uint32_t > v(n);
+        for(size_t i = 0; i != n; ++i) v[i] = uint32_t(i * 2654435761u);
+        Encoded< uint32_t, BitPacked > vIn;
+        UnPack(Pack(AsBitPacked(v)).data(), vIn);
+        assert(vIn.ToVector() == v);
+    }
+    //6.3 scalar and SIMD block packing produce the same layout
+    {
+        uint32_t block[codec::BLOCK_SIZE];
+        uint32_t ws[codec::BLOCK_SIZE], wv[codec::BLOCK_SIZE];
+        uint32_t out[codec::BLOCK_SIZE];
+        for(unsigned b = 0; b <= 32; ++b) {
+            for(size_t i = 0; i != codec::BLOCK_SIZE; ++i)
+                block[i] = b == 32 ? uint32_t(i * 2654435761u)
+                                   : uint32_t(i * 2654435761u)
+                                     & ((uint32_t(1) << b) - 1);
+            codec::detail::PackBlockScalar(block, b, ws);
+            codec::PackBlock(block, b, wv);
+            assert(memcmp(ws, wv, 4 * b * sizeof(uint32_t)) == 0);
+            codec::UnpackBlock(wv, b, out);
+            assert(memcmp(out, block, sizeof(block)) == 0);
+            codec::detail::UnpackBlockScalar(ws, b, out);
+            assert(memcmp(out, block, sizeof(block)) == 0);
+        }
+    }
+    //6.4 corrupted data
+    {
+        //last value truncated
+        ByteArray bad = Pack(AsVarint(ids));
+        bad.pop_back();
+        Pack(bad.begin() + sizeof(Size), Size(bad.size() - 2 * sizeof(Size)));
+        Encoded< uint32_t, Varint > badIn;
+        bool thrown = false;
+        try {
+            UnPack(bad.data(), badIn);
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+//7. Field lists
+    {
+        using test::Vec3;
+        using test::Particle;
+        //7.1 fixed size structs: constant size and offsets
+        static_assert(StaticSizeof< Vec3 >::Fixed
+                      && StaticSizeof< Vec3 >::Value == 3 * sizeof(float),
+                      "Vec3 has fixed size");
+        static_assert(FieldOffset< Particle, 2 >::Fixed
+                      && FieldOffset< Particle, 2 >::Value
+                         == sizeof(int32_t) + 3 * sizeof(float),
+                      "offset of Particle::alive");
+        static_assert(!FieldOffset< Particle, 4 >::Fixed,
+                      "Particle::weights follows variable size field");
+        static_assert(FieldCount< Particle >::value == 5, "field count");
+        const Vec3 v = {1.f, 2.f, 3.f};
+        assert(Pack(v) == Pack(v.x, v.y, v.z));
+        //7.2 round trip of nested and variable size fields
+        const Particle p = {7, {1.f, -2.f, 3.5f}, true, "p7", {0.5f, 0.25f}};
+        const ByteArray b = Pack(p, 42);
+        assert(b == Pack(p.id, p.pos, p.alive, p.name, p.weights, 42));
+        assert(Sizeof(p) == Pack(p).size());
+        Particle q;
+        int tail = 0;
+        assert(UnPack(UnPack(b.data(), q), tail) == b.data() + b.size());
+        assert(q.id == p.id && q.pos.y == p.pos.y && q.alive && q.name == "p7"
+               && q.weights == p.weights && tail == 42);
+        //7.3 containers of structs with field lists
+        const vector< Particle > ps = {p, p};
+        vector< Particle > qs;
+        UnPack(Pack(ps).data(), qs);
+        assert(qs.size() == 2 && qs[1].name == "p7");
+        //POD structs with field lists are not copied as raw memory
+        assert(Pack(vector< Vec3 >{v}) == Pack(Size(1), v));
+        //7.4 generated JavaScript decoders
+        JSDecoderGenerator g;
+        bool thrown = false;
+        try {
+            g.Add< Particle >("decodeParticle");
+        } catch(const logic_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        const string js = g.Add< Vec3 >("decodeVec3")
+                              .Add< Particle >("decodeParticle")
+                              .Source();
+        assert(FieldNames< Particle >()[3] == "name");
+        assert(js.find("y: r.view.getFloat32(o + 4, true)") != string::npos);
+        assert(js.find("pos: decodeVec3(r)") != string::npos);
+        assert(js.find("alive: (r.uint8() !== 0)") != string::npos);
+        assert(js.find("weights: r.array('float32')") != string::npos);
+    }
+
+//8. Stream decoder
+    {
+        const string text = "streamed";
+        const vector< double > values = {1.5, -2, 3.25};
+        vector< char > file(1000);
+        for(size_t i = 0; i != file.size(); ++i) file[i] = char(i * 7);
+        const ByteArray msg = Pack(int(1), text, values, int(2),
+                                   ArrayView< char >(file.data(),
+                                                     file.size()));
+        //8.1 every chunk size, fields queued from callbacks
+        for(size_t chunk = 1; chunk <= msg.size(); chunk += 7) {
+            StreamDecoder d;
+            int id = 0, cmd = 0;
+            string t;
+            vector< double > v;
+            vector< char > received;
+            size_t completed = 0;
+            d.Read(id, [&]() {
+                assert(id == 1);
+                d.Read(t).Read(v, [&]() { ++completed; }).Read(cmd, [&]() {
+                    assert(cmd == 2);
+                    d.ReadChunks< char >([&](const Byte* p, size_t n) {
+                        received.insert(received.end(), p, p + n);
+                    }, [&]() { ++completed; });
+                });
+            });
+            for(size_t i = 0; i < msg.size(); i += chunk)
+                d.Feed(msg.data() + i, min(chunk, msg.size() - i));
+            assert(d.Done() && completed == 2);
+            assert(t == text && v == values && received == file);
+        }
+        //8.2 size limit, unexpected data
+        StreamDecoder d(100);
+        vector< char > big;
+        d.Read(big);
+        bool thrown = false;
+        try {
+            d.Feed(msg.data() + msg.size() - file.size() - sizeof(Size),
+                   sizeof(Size));
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        d.Reset();
+        thrown = false;
+        try {
+            d.Feed(msg.data(), 1);
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+//9. Compression
+    {
+        //9.1 shuffle filters: SIMD and scalar layouts match, round trip
+        for(size_t w: {1, 2, 3, 4, 8}) {
+            for(size_t n: {0, 1, 15, 16, 17, 40, 1000}) {
+                vector< uint8_t > in(n * w), a(n * w), b(n * w), r(n * w);
+                for(size_t i = 0; i != in.size(); ++i)
+                    in[i] = uint8_t(i * 2654435761u >> 13);
+                compress::detail::ByteShuffle(a.data(), in.data(), n, w);
+                compress::detail::ByteShuffleScalar(b.data(), in.data(),
+                                                    0, n, w);
+                assert(a == b);
+                compress::detail::ByteUnshuffle(r.data(), a.data(), n, w);
+                assert(r == in);
+                vector< uint8_t > tmp(n), plane(in.begin(),
+                                                in.begin() + n);
+                compress::detail::BitShufflePlane(plane.data(), n,
+                                                  tmp.data());
+                for(size_t i = 0; i != (n & ~size_t(7)); ++i)
+                    for(size_t j = 0; j != 8; ++j)
+                        assert(((in[i] >> j) & 1)
+                               == ((plane[j * (n / 8) + i / 8] >> (i % 8))
+                                   & 1));
+                compress::detail::BitUnshufflePlane(plane.data(), n,
+                                                    tmp.data());
+                assert(equal(plane.begin(), plane.end(), in.begin()));
+            }
+        }
+        //9.2 LZ: repetitive and random data
+        {
+            vector< uint8_t > text;
+            for(int i = 0; i != 5000; ++i) text.push_back(uint8_t("abcab"[i % 5]
+                                                          + i / 1000));
+            vector< uint8_t > noise(5000);
+            for(size_t i = 0; i != noise.size(); ++i)
+                noise[i] = uint8_t((i * 2654435761u) >> 24);
+            for(auto* v: {&text, &noise}) {
+                vector< uint8_t > c(compress::detail::LZBound(v->size()));
+                c.resize(compress::detail::LZCompress(v->data(), v->size(),
+                                                      c.data()));
+                vector< uint8_t > d(v->size());
+                compress::detail::LZDecompress(c.data(), c.data() + c.size(),
+                                               d.data(), d.size());
+                assert(d == *v);
+                if(v == &text) assert(c.size() < v->size() / 20);
+            }
+        }
+        //9.3 smooth field: all modes, parallel blocks, block boundaries
+        vector< float > field(100000);
+        for(size_t i = 0; i != field.size(); ++i)
+            field[i] = float(sin(i * 0.001) * 100 + 10);
+        size_t sizes[3] = {};
+        for(Shuffle s: {Shuffle::NONE, Shuffle::BYTE, Shuffle::BIT}) {
+            for(unsigned threads: {1u, 4u}) {
+                const ByteArray b = Pack(AsCompressed(field, s, threads), 7);
+                sizes[int(s)] = b.size();
+                Compressed< float > c;
+                int tail = 0;
+                assert(UnPack(UnPack(b.data(), c), tail) == b.data()
+                                                             + b.size());
+                assert(c.ToVector() == field && tail == 7);
+            }
+        }
+        //full precision values: low mantissa bits are noise
+        assert(sizes[0] > Sizeof(field) * 9 / 10);
+        assert(sizes[1] < sizes[0] * 3 / 4 && sizes[2] < sizes[0] * 3 / 4);
+        const size_t be = compress::detail::BlockElements< double >();
+        for(size_t n: {size_t(0), size_t(1), be, be + 1}) {
+            vector< double > v(n);
+            for(size_t i = 0; i != n; ++i) v[i] = double(i % 1000) * 0.5;
+            Compressed< double > c;
+            UnPack(Pack(AsCompressed(v, Shuffle::BIT, 2)).data(), c);
+            assert(c.ToVector() == v);
+        }
+        //9.4 invalid data
+        ByteArray bad = Pack(AsCompressed(field));
+        bad[2 * sizeof(Size)] = 8; //element size
+        Compressed< float > c;
+        bool thrown = false;
+        try {
+            UnPack(bad.data(), c);
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        {
+            //validated before allocating: element count larger than the
+            //blocks, maximum LZ expansion exceeded
+            const vector< double > v(4096, 1.);
+            ByteArray packed = Pack(AsCompressed(v));
+            const Byte* pb = packed.data();
+            const Byte* pe = pb + packed.size();
+            assert(Validate< Compressed< double > >(pb, pe) == pe);
+            Size huge = Size(1) << 30;
+            memcpy(&packed[0], &huge, sizeof(huge));
+            assert(!Validate< Compressed< double > >(pb, pe));
+            ByteArray lz(2 * sizeof(Size) + compress::HEADER_SIZE + 4 + 1);
+            Size n = Size(512);
+            memcpy(&lz[0], &n, sizeof(n));
+            const Size bytes = Size(compress::HEADER_SIZE + 4 + 1);
+            memcpy(&lz[sizeof(Size)], &bytes, sizeof(bytes));
+            memcpy(&lz[2 * sizeof(Size)], &packed[2 * sizeof(Size)],
+                   compress::HEADER_SIZE);
+            //one byte LZ block decoding to 512 doubles
+            const uint32_t header = 1;
+            memcpy(&lz[2 * sizeof(Size) + compress::HEADER_SIZE], &header, 4);
+            assert(!Validate< Compressed< double > >(lz.data(),
+                                                     lz.data() + lz.size()));
+        }
+        //9.5 JavaScript decoder
+        assert(detail::JSReader< Compressed< float > >::Expr(
+                   JSDecoderGenerator()) == "r.compressed('float32')");
+    }
+
+//10. Reduced precision
+    {
+        using namespace quantize;
+        //10.1 half conversion: exact round trip of every half, rounding
+        for(uint32_t h = 0; h != 0x10000; ++h) {
+            const float f = HalfToFloat(uint16_t(h));
+            if(std::isnan(f)) assert((h & 0x7c00) == 0x7c00 && (h & 0x3ff));
+            else assert(FloatToHalf(f) == h);
+        }
+        const float e11 = ldexp(1.f, -11), e25 = ldexp(1.f, -25);
+        assert(FloatToHalf(1.f + e11) == 0x3c00);     //tie to even
+        assert(FloatToHalf(1.f + 3 * e11) == 0x3c02); //tie to even
+        assert(FloatToHalf(-2.f) == 0xc000);
+        assert(FloatToHalf(65519.f) == 0x7bff);
+        assert(FloatToHalf(65520.f) == 0x7c00);       //overflow
+        assert(FloatToHalf(e25) == 0 && FloatToHalf(3 * e25) == 2);
+        assert(std::isnan(HalfToFloat(FloatToHalf(NAN))));
+        vector< float > v(1003);
+        for(size_t i = 0; i != v.size(); ++i)
+            v[i] = float(sin(i * 0.37) * pow(10., double(i % 9) - 4));
+        Quantized< Half > h;
+        const ByteArray hb = Pack(AsHalf(v));
+        assert(hb.size() == Sizeof(AsHalf(v)) || WireAligned);
+        assert(UnPack(hb.data(), h) == hb.data() + hb.size());
+        assert(h.Size() == v.size());
+        for(size_t i = 0; i != v.size(); ++i) {
+            if(fabs(v[i]) >= ldexp(1.f, -14))
+                assert(fabs(h[i] - v[i]) <= fabs(v[i]) * e11);
+            else assert(fabs(h[i] - v[i]) <= e25);
+        }
+        //10.2 fixed point: range transmitted, error at most half a step
+        Quantized< Fixed8 > q8;
+        Quantized< Fixed16 > q16;
+        UnPack(UnPack(Pack(AsFixed8(v), AsFixed16(v)).data(), q8), q16);
+        const auto range = minmax_element(v.begin(), v.end());
+        assert(q8.HasRange() && q8.Min() == *range.first
+               && q8.Max() == *range.second && q16.Max() == q8.Max());
+        //float rounding of values of the order of the range bounds
+        const float ulps = 4 * numeric_limits< float >::epsilon()
+                           * max(fabs(q8.Min()), fabs(q8.Max()));
+        for(size_t i = 0; i != v.size(); ++i) {
+            assert(fabs(q8[i] - v[i]) <= q8.MaxError() + ulps);
+            assert(fabs(q16[i] - v[i]) <= q16.MaxError() + ulps);
+        }
+        //explicit range: values clamped, NaN encoded as lower bound
+        const vector< float > w = {-5.f, 0.f, 0.5f, 1.f, 7.f, NAN};
+        UnPack(Pack(AsFixed8(w, 0.f, 1.f)).data(), q8);
+        assert(q8.Min() == 0.f && q8.Max() == 1.f);
+        assert(q8[0] == 0.f && q8[1] == 0.f && q8[5] == 0.f);
+        assert(fabs(q8[3] - 1.f) < 1e-6f && q8[4] == q8[3]);
+        assert(fabs(q8[2] - 0.5f) <= q8.MaxError() + 1e-6f);
+        //range of finite values only
+        const float inf = numeric_limits< float >::infinity();
+        float lo = 0, hi = 0;
+        const vector< float > x = {2.f, inf, NAN, 3.f, -inf, -1.f, 9.f, NAN,
+                                   0.5f};
+        Range(x.data(), x.size(), lo, hi);
+        assert(lo == -1.f && hi == 9.f);
+        //constant data
+        UnPack(Pack(AsFixed16(vector< float >(20, 3.f))).data(), q16);
+        assert(q16.Size() == 20 && q16[19] == 3.f);
+        //10.3 SIMD and scalar conversions match
+        vector< uint16_t > a(v.size()), b(v.size());
+        Quantize< uint16_t >(v.data(), v.size(), -.5f, .5f, a.data());
+        QuantizeScalar< uint16_t >(v.data(), v.size(), -.5f, .5f, b.data());
+        assert(a == b);
+        vector< uint8_t > a8(v.size()), b8(v.size());
+        Quantize< uint8_t >(v.data(), v.size(), -.5f, .5f, a8.data());
+        QuantizeScalar< uint8_t >(v.data(), v.size(), -.5f, .5f, b8.data());
+        assert(a8 == b8);
+        vector< float > fa(v.size()), fb(v.size());
+        Dequantize< uint8_t >(a8.data(), a8.size(), -.5f, .5f, fa.data());
+        DequantizeScalar< uint8_t >(a8.data(), a8.size(), -.5f, .5f,
+                                    fb.data());
+        assert(fa == fb);
+        ToHalf(v.data(), v.size(), a.data());
+        ToHalfScalar(v.data(), v.size(), b.data());
+        assert(a == b);
+        //10.4 JavaScript decoders
+        const JSDecoderGenerator g;
+        assert(srz::detail::JSReader< Quantized< Half > >::Expr(g) == "r.half()");
+        assert(srz::detail::JSReader< Quantized< Fixed8 > >::Expr(g)
+               == "r.fixed('uint8')");
+    }
+
+//11. Checked unpacking
+    {
+        const vector< string > lines = {"a", "bc"};
+        const ByteArray b = Pack(7, lines, vector< double >{1.5});
+        const char* begin = b.data();
+        const char* end = begin + b.size();
+        assert((Validate< int, vector< string >, vector< double > >(begin, end)
+                == end));
+        int id = 0;
+        vector< string > l;
+        vector< double > d;
+        assert(UnPackChecked(begin, end, id, l, d) == end);
+        assert(id == 7 && l == lines && d.size() == 1 && d[0] == 1.5);
+        //truncated data
+        assert((!Validate< int, vector< string >, vector< double > >(
+                   begin, end - 1)));
+        bool thrown = false;
+        try {
+            UnPackChecked(begin, end - 1, id, l, d);
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        //declared length larger than the data
+        ByteArray bad = b;
+        Size huge = Size(1) << 30;
+        memcpy(&bad[sizeof(int)], &huge, sizeof(huge));
+        assert((!Validate< int, vector< string > >(bad.data(),
+                                                    bad.data() + bad.size())));
+        //types copied through their object representation must be
+        //trivially copyable: a tuple holding a string would unpack a
+        //string pointer and size read from the data
+        static_assert(!Validatable< tuple< int, string > >::value,
+                      "non trivially copyable tuple rejected");
+        static_assert(Validatable< tuple< int, float > >::value
+                      && Validatable< vector< string > >::value,
+                      "POD tuples and containers validated");
+    }
+
+//12. Maps
+    {
+        //12.1 POD maps: keys array followed by values array, same layout
+        //as two vectors
+        const map< int, float > m = {{3, 0.5f}, {-1, 2.f}, {7, -4.f}};
+        const ByteArray b = Pack(m);
+        assert(b == Pack(vector< int >{-1, 3, 7},
+                         vector< float >{2.f, 0.5f, -4.f}));
+        assert((GetSerializer< map< int, float > >::Type::Sizeof(m)
+                >= b.size()));
+        map< int, float > mo;
+        UnPack(b.begin(), mo);
+        assert(mo == m);
+        //12.2 std::map, std::unordered_map and FlatMap are interchangeable
+        unordered_map< int, float > u;
+        UnPack(b.begin(), u);
+        assert(u.size() == 3 && u.at(7) == -4.f);
+        FlatMap< int, float > f;
+        UnPack(b.begin(), f);
+        assert(f.Size() == 3 && f.Keys() == (vector< int >{-1, 3, 7}));
+        assert(*f.Find(3) == 0.5f && !f.Find(4));
+        assert(Pack(f) == b);
+        mo.clear();
+        UnPack(Pack(u).begin(), mo);
+        assert(mo == m);
+        //12.3 unsorted data is sorted, first value of duplicate keys kept
+        const ByteArray unsorted =
+            Pack(vector< int >{5, 1, 5}, vector< float >{1.f, 2.f, 3.f});
+        UnPack(unsorted.begin(), f);
+        assert(f.Keys() == (vector< int >{1, 5}));
+        assert(f.Values() == (vector< float >{2.f, 1.f}));
+        const FlatMap< int, float > fp({{2, 1.f}, {1, 0.f}, {2, 9.f}});
+        assert(fp.Size() == 2 && fp.Value(1) == 1.f);
+        //12.4 unpacking reuses memory
+        UnPack(b.begin(), f);
+        const float* values = f.Values().data();
+        UnPack(b.begin(), f);
+        assert(f.Values().data() == values && f.Size() == 3);
+        //12.5 non-POD maps: key, value pairs
+        const map< string, int > sm = {{"a", 1}, {"bc", 2}};
+        FlatMap< string, int > sf;
+        UnPack(Pack(sm).begin(), sf);
+        assert(sf.Size() == 2 && *sf.Find("bc") == 2);
+        sf["ab"] = 3;
+        map< string, int > smo;
+        UnPack(Pack(sf).begin(), smo);
+        assert(smo.size() == 3 && smo.at("ab") == 3);
+        //12.6 keys and values arrays of different length
+        const ByteArray bad = Pack(vector< int >{1, 2}, vector< float >{1.f});
+        assert((!Validate< map< int, float > >(bad.data(),
+                                                bad.data() + bad.size())));
+        bool thrown = false;
+        try {
+            UnPack(bad.begin(), mo);
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        //12.7 JavaScript decoder
+        const JSDecoderGenerator g;
+        assert((srz::detail::JSReader< FlatMap< int16_t, float > >::Expr(g)
+                == "r.scalarMap('int16', 'float32')"));
+        assert((srz::detail::JSReader< map< string, int > >::Expr(g)
+                == "r.map(r => r.string(), r => r.int32())"));
+    }
+
     cout << "PASSED" << endl;
 
     return EXIT_SUCCESS;
@@ -0,0 +1,203 @@
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+// Fuzz test of UnPackChecked: data accepted by the validation pass must be
+// unpacked by the unchecked decoder consuming exactly the validated bytes
+// and yielding the same values; truncated messages must be rejected.
+// Standalone: random messages, truncations and mutations, usage
+// unpack-fuzz [iterations] [seed]. Built with -DSRZ_LIBFUZZER and
+// -fsanitize=fuzzer the input is provided by libFuzzer.
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Serialize.h"
+#include "Fields.h"
+#include "IntegerCodecs.h"
+#include "Compression.h"
+#include "Quantize.h"
+#include "FlatMap.h"
+
+using namespace std;
+using namespace srz;
+
+namespace test {
+struct Vec3 {
+    float x, y, z;
+};
+SRZ_FIELDS(Vec3, x, y, z)
+
+struct Particle {
+    int32_t id;
+    Vec3 pos;
+    string name;
+    vector< float > weights;
+};
+SRZ_FIELDS(Particle, id, pos, name, weights)
+}
+
+//Message exercising every serializer that validates lengths.
+struct Message {
+    int32_t id = 0;
+    string text;
+    vector< float > samples;
+    vector< string > lines;
+    map< int32_t, string > names;
+    map< int16_t, float > levels;
+    FlatMap< uint32_t, double > scores;
+    pair< int16_t, double > range;
+    vector< test::Particle > particles;
+    Encoded< uint32_t, DeltaBitPacked > ids;
+    Quantized< Fixed8 > field;
+    Compressed< uint16_t > counts;
+};
+
+ByteArray PackMessage(const Message& m) {
+    return Pack(m.id, m.text, m.samples, m.lines, m.names, m.levels, m.scores,
+                m.range, m.particles, m.ids, m.field, m.counts);
+}
+
+const Byte* UnPackUnchecked(const Byte* p, Message& m) {
+    return UnPackInto(p, m.id, m.text, m.samples, m.lines, m.names, m.levels,
+                      m.scores, m.range, m.particles, m.ids, m.field,
+                      m.counts);
+}
+
+const Byte* UnPackValidated(const Byte* p, const Byte* end, Message& m) {
+    return UnPackChecked(p, end, m.id, m.text, m.samples, m.lines, m.names,
+                         m.levels, m.scores, m.range, m.particles, m.ids,
+                         m.field, m.counts);
+}
+
+//Decode with both decoders and compare; return false if rejected.
+bool Check(const Byte* data, size_t size) {
+    //exact copy: reads past the end are caught by sanitizers
+    const ByteArray in(data, data + size);
+    const Byte* begin = in.data();
+    const Byte* end = begin + in.size();
+    Message a, b;
+    const Byte* ca = nullptr;
+    try {
+        ca = UnPackValidated(begin, end, a);
+    } catch(const runtime_error&) {
+        //invalid lengths, or invalid encoded data detected while decoding
+        if(!Validate< int32_t, string, vector< float >, vector< string >,
+                      map< int32_t, string >, map< int16_t, float >,
+                      FlatMap< uint32_t, double >, pair< int16_t, double >,
+                      vector< test::Particle >,
+                      Encoded< uint32_t, DeltaBitPacked >,
+                      Quantized< Fixed8 >, Compressed< uint16_t > >(begin,
+                                                                    end))
+            return false;
+        bool thrown = false;
+        try {
+            UnPackUnchecked(begin, b);
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        return true;
+    }
+    assert(ca <= end);
+    const Byte* cb = UnPackUnchecked(begin, b);
+    assert(ca == cb);
+    assert(PackMessage(a) == PackMessage(b));
+    return true;
+}
+
+#ifdef SRZ_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    Check(reinterpret_cast< const Byte* >(data), size);
+    return 0;
+}
+#else
+//Random valid message.
+ByteArray RandomMessage(mt19937& rng) {
+    uniform_int_distribution< int > len(0, 40);
+    uniform_int_distribution< int > byte(0, 255);
+    uniform_real_distribution< float > real(-100, 100);
+    auto text = [&]() {
+        string s(size_t(len(rng)), ' ');
+        for(auto& c: s) c = char(byte(rng));
+        return s;
+    };
+    Message m;
+    m.id = int32_t(rng());
+    m.text = text();
+    m.samples.resize(size_t(len(rng)));
+    for(auto& f: m.samples) f = real(rng);
+    m.lines.resize(size_t(len(rng) / 4));
+    for(auto& l: m.lines) l = text();
+    for(int i = len(rng) / 4; i; --i) m.names[int32_t(rng())] = text();
+    for(int i = len(rng); i; --i) m.levels[int16_t(rng())] = real(rng);
+    for(int i = len(rng); i; --i) m.scores[uint32_t(rng())] = real(rng);
+    m.range = make_pair(int16_t(rng()), double(real(rng)));
+    m.particles.resize(size_t(len(rng) / 8));
+    for(auto& p: m.particles) {
+        p.id = int32_t(rng());
+        p.pos = {real(rng), real(rng), real(rng)};
+        p.name = text();
+        p.weights.resize(size_t(len(rng) / 4), real(rng));
+    }
+    vector< uint32_t > ids(size_t(len(rng) * 8));
+    uint32_t id = uint32_t(rng() % 1000);
+    for(auto& i: ids) i = id += uint32_t(rng() % 4);
+    vector< float > field(size_t(len(rng)));
+    for(auto& f: field) f = real(rng);
+    vector< uint16_t > counts(size_t(len(rng) * 8));
+    for(size_t i = 0; i != counts.size(); ++i) counts[i] = uint16_t(i / 7);
+    m.ids = AsDeltaBitPacked(ids);
+    m.field = AsFixed8(field);
+    m.counts = AsCompressed(counts);
+    return PackMessage(m);
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    mt19937 rng(argc > 2 ? unsigned(atoi(argv[2])) : 5489u);
+    size_t accepted = 0, rejected = 0;
+    for(int it = 0; it != iterations; ++it) {
+        const ByteArray msg = RandomMessage(rng);
+        assert(Check(msg.data(), msg.size()));
+        //every truncation is rejected
+        for(size_t n = 0; n < msg.size(); n += 1 + n / 16)
+            assert(!Check(msg.data(), n));
+        //mutations: byte values, e.g. lengths, and random garbage
+        for(int k = 0; k != 8; ++k) {
+            ByteArray bad = msg;
+            for(int f = 1 + int(rng() % 4); f; --f)
+                bad[rng() % bad.size()] = Byte(rng());
+            if(Check(bad.data(), bad.size())) ++accepted;
+            else ++rejected;
+        }
+        ByteArray noise(rng() % 256);
+        for(auto& c: noise) c = Byte(rng());
+        if(Check(noise.data(), noise.size())) ++accepted;
+        else ++rejected;
+    }
+    cout << "mutated messages accepted: " << accepted
+         << ", rejected: " << rejected << endl;
+    cout << "PASSED" << endl;
+    return EXIT_SUCCESS;
+}
+#endif
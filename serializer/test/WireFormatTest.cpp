@@ -0,0 +1,261 @@
+//Author: Ugo Varetto
+//
+//SeRialiZation Framework (SRZ).
+//This code is distributed under the terms of the GNU General Public License
+//as published by the Free Software Foundation, either version 3 of the License,
+//or (at your option) any later version.
+//
+//srz is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with srz.  If not, see <http://www.gnu.org/licenses/>.
+
+// Wire format conformance test: little-endian, aligned wire format as
+// decoded by the JavaScript client; the golden messages must match the ones
+// in webappclient/test/srz-conformance/srz-conformance.js.
+
+#define ZRF_UNSIGNED_CHAR
+#define ZRF_int32_size
+#define SRZ_WIRE_LE
+#define SRZ_WIRE_ALIGNED
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Serialize.h"
+#include "Sinks.h"
+#include "Gather.h"
+#include "IntegerCodecs.h"
+#include "StreamDecoder.h"
+#include "Compression.h"
+#include "Quantize.h"
+
+using namespace std;
+using namespace srz;
+
+//int32 0x01020304, uint16 0xa1b2, double 1.5, string "hi",
+//vector<float> {1, -2}, vector<uint8_t> {7}, vector<double> {0.25}
+const Byte GOLDEN[] = {
+    0x04, 0x03, 0x02, 0x01,
+    0xb2, 0xa1,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0x3f,
+    0x02, 0x00, 0x00, 0x00, 'h', 'i',
+    0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x00, 0xc0,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x07,
+    0x01, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x3f
+};
+
+//AsDelta(vector<uint32_t> {100, 101, 103, 103, 90})
+const Byte GOLDEN_DELTA[] = {
+    0x05, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00,
+    0xc8, 0x01, 0x02, 0x04, 0x00, 0x19
+};
+
+//AsBitPacked(vector<uint32_t>): 128 values i % 4, then 5, 300
+const Byte GOLDEN_BITPACKED[] = {
+    0x82, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00,
+    0x02,
+    0x00, 0x00, 0x00, 0x00, 0x55, 0x55, 0x55, 0x55,
+    0xaa, 0xaa, 0xaa, 0xaa, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x00, 0x00, 0x00, 0x55, 0x55, 0x55, 0x55,
+    0xaa, 0xaa, 0xaa, 0xaa, 0xff, 0xff, 0xff, 0xff,
+    0x05, 0xac, 0x02
+};
+
+//AsCompressed(vector<uint16_t>, Shuffle::BYTE): 64 values 1000 + i / 8
+const Byte GOLDEN_BYTE_SHUFFLED[] = {
+    0x40, 0x00, 0x00, 0x00, 0x35, 0x00, 0x00, 0x00,
+    0x02, 0x01, 0x00, 0x80, 0x00, 0x00,
+    0x2b, 0x00, 0x00, 0x00,
+    0x13, 0xe8, 0x01, 0x00, 0x13, 0xe9, 0x01, 0x00, 0x13, 0xea, 0x01, 0x00,
+    0x13, 0xeb, 0x01, 0x00, 0x13, 0xec, 0x01, 0x00, 0x13, 0xed, 0x01, 0x00,
+    0x13, 0xee, 0x01, 0x00, 0x13, 0xef, 0x01, 0x00, 0x1f, 0x03, 0x01, 0x00,
+    0x27, 0x50, 0x03, 0x03, 0x03, 0x03, 0x03
+};
+
+//AsCompressed(vector<uint16_t>, Shuffle::BIT): same values
+const Byte GOLDEN_BIT_SHUFFLED[] = {
+    0x40, 0x00, 0x00, 0x00, 0x34, 0x00, 0x00, 0x00,
+    0x02, 0x02, 0x00, 0x80, 0x00, 0x00,
+    0x2a, 0x00, 0x00, 0x00,
+    0x23, 0x00, 0xff, 0x02, 0x00, 0x23, 0x00, 0xff, 0x04, 0x00, 0x37, 0x00,
+    0x00, 0xff, 0x01, 0x00, 0x00, 0x10, 0x00, 0x00, 0x02, 0x00, 0x07, 0x13,
+    0x00, 0x0f, 0x02, 0x00, 0x0a, 0x00, 0x2c, 0x00, 0x0f, 0x02, 0x00, 0x14,
+    0x50, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+//AsHalf({1, -2, 0.5, 65504, 1e-7}), AsFixed8 and AsFixed16 of
+//{0, 0.25, 1, -1}
+const Byte GOLDEN_QUANTIZED[] = {
+    0x05, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x3c, 0x00, 0xc0, 0x00, 0x38, 0xff, 0x7b, 0x02, 0x00,
+    0x00, 0x00, 0x80, 0xbf, 0x00, 0x00, 0x80, 0x3f,
+    0x04, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x9f, 0xff, 0x00,
+    0x00, 0x00, 0x80, 0xbf, 0x00, 0x00, 0x80, 0x3f,
+    0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0xff, 0x9f, 0xff, 0xff, 0x00, 0x00
+};
+
+int main(int, char**) {
+    const int32_t i32 = 0x01020304;
+    const uint16_t u16 = 0xa1b2;
+    const double d = 1.5;
+    const string s = "hi";
+    const vector< float > vf = {1.f, -2.f};
+    const vector< uint8_t > vb = {7};
+    const vector< double > vd = {0.25};
+
+//1. Golden message
+    const ByteArray golden(begin(GOLDEN), end(GOLDEN));
+    const ByteArray msg = Pack(i32, u16, d, s, vf, vb, vd);
+    assert(msg == golden);
+    //computed size is an upper bound: padding depends on position
+    assert(Sizeof(i32, u16, d, s, vf, vb, vd) >= msg.size());
+    ByteArray appended;
+    assert(Pack(appended, i32, u16, d, s, vf, vb, vd) == golden.size());
+    assert(appended == golden);
+    ByteArray sunk;
+    VectorSink<> sink(sunk);
+    assert(Pack(sink, i32, u16, d, s, vf, vb, vd) == golden.size());
+    assert(sunk == golden);
+    GatherBuffer g(4);
+    PackGather(g, i32, u16, d, s, vf, vb, vd);
+    assert(g.Flatten() == golden);
+
+//2. Round trip
+    {
+        int32_t ri = 0;
+        uint16_t ru = 0;
+        double rd = 0;
+        string rs;
+        ArrayView< float > rvf;
+        vector< uint8_t > rvb;
+        ArrayView< double > rvd;
+        const Byte* p = golden.data();
+        p = UnPack(p, ri);
+        p = UnPack(p, ru);
+        p = UnPack(p, rd);
+        p = UnPack(p, rs);
+        p = UnPack(p, rvf);
+        p = UnPack(p, rvb);
+        p = UnPack(p, rvd);
+        assert(p == golden.data() + golden.size());
+        assert(ri == i32 && ru == u16 && rd == d && rs == s);
+        assert(rvf.ToVector() == vf && rvb == vb && rvd.ToVector() == vd);
+        //padded payloads are mapped in place
+        assert(!rvf.Copied() && !rvd.Copied());
+    }
+    //padding adapts to position of array in buffer
+    for(size_t offset = 0; offset != 8; ++offset) {
+        ByteArray b(offset);
+        Pack(b, vd);
+        vector< double > r;
+        UnPack(b.data() + offset, r);
+        assert(r == vd);
+        ArrayView< double > v;
+        UnPack(b.data() + offset, v);
+        assert(!v.Copied());
+    }
+
+//3. Byte swap
+    {
+        mt19937 rng(1);
+        for(size_t width: {2, 4, 8}) {
+            for(size_t count: {0, 1, 3, 7, 16, 33, 1000}) {
+                vector< uint8_t > src(count * width);
+                for(auto& b: src) b = uint8_t(rng());
+                vector< uint8_t > dst(src.size());
+                endian::ByteSwap(dst.data(), src.data(), count, width);
+                for(size_t e = 0; e != count; ++e)
+                    for(size_t b = 0; b != width; ++b)
+                        assert(dst[e * width + b]
+                               == src[e * width + width - 1 - b]);
+                //in place, twice yields original
+                endian::ByteSwap(dst.data(), dst.data(), count, width);
+                assert(dst == src);
+            }
+        }
+    }
+
+//4. Integer encodings
+    {
+        const vector< uint32_t > ids = {100, 101, 103, 103, 90};
+        assert(Pack(AsDelta(ids))
+               == ByteArray(begin(GOLDEN_DELTA), end(GOLDEN_DELTA)));
+        vector< uint32_t > v;
+        for(uint32_t i = 0; i != 128; ++i) v.push_back(i % 4);
+        v.push_back(5);
+        v.push_back(300);
+        const ByteArray b(begin(GOLDEN_BITPACKED), end(GOLDEN_BITPACKED));
+        assert(Pack(AsBitPacked(v)) == b);
+        Encoded< uint32_t, BitPacked > in;
+        UnPack(b.data(), in);
+        assert(in.ToVector() == v);
+    }
+
+//5. Stream decoder: golden message one byte at a time, padding skipped
+    {
+        int32_t ri = 0;
+        uint16_t ru = 0;
+        double rd = 0;
+        string rs;
+        vector< float > rvf;
+        vector< uint8_t > rvb;
+        vector< double > rvd;
+        StreamDecoder sd;
+        sd.Read(ri).Read(ru).Read(rd).Read(rs).Read(rvf).Read(rvb).Read(rvd);
+        for(Byte b: golden) sd.Feed(&b, 1);
+        assert(sd.Done());
+        assert(ri == i32 && ru == u16 && rd == d && rs == s);
+        assert(rvf == vf && rvb == vb && rvd == vd);
+    }
+
+//6. Compression: shuffled LZ blocks
+    {
+        vector< uint16_t > v;
+        for(uint16_t i = 0; i != 64; ++i) v.push_back(uint16_t(1000 + i / 8));
+        const ByteArray bs(begin(GOLDEN_BYTE_SHUFFLED),
+                           end(GOLDEN_BYTE_SHUFFLED));
+        const ByteArray bb(begin(GOLDEN_BIT_SHUFFLED),
+                           end(GOLDEN_BIT_SHUFFLED));
+        assert(Pack(AsCompressed(v, Shuffle::BYTE)) == bs);
+        assert(Pack(AsCompressed(v, Shuffle::BIT)) == bb);
+        Compressed< uint16_t > c;
+        UnPack(bb.data(), c);
+        assert(vector< uint16_t >(c.begin(), c.end()) == v);
+    }
+
+//7. Reduced precision; SIMD conversions when compiled with F16C
+    {
+        const vector< float > h = {1.f, -2.f, 0.5f, 65504.f, 1e-7f};
+        const vector< float > q = {0.f, 0.25f, 1.f, -1.f};
+        const ByteArray b(begin(GOLDEN_QUANTIZED), end(GOLDEN_QUANTIZED));
+        assert(Pack(AsHalf(h), AsFixed8(q), AsFixed16(q)) == b);
+        vector< float > f(0x10000), g(0x10000);
+        vector< uint16_t > halves(0x10000), a(0x10000), c(0x10000);
+        for(uint32_t i = 0; i != 0x10000; ++i) halves[i] = uint16_t(i);
+        quantize::FromHalf(halves.data(), halves.size(), f.data());
+        quantize::FromHalfScalar(halves.data(), halves.size(), g.data());
+        assert(memcmp(f.data(), g.data(), f.size() * sizeof(float)) == 0);
+        //every rounding case between consecutive halves
+        for(uint32_t i = 0; i != 0x10000; ++i)
+            f[i] = quantize::HalfToFloat(uint16_t(i & 0x7bff)) * 1.0003f;
+        quantize::ToHalf(f.data(), f.size(), a.data());
+        quantize::ToHalfScalar(f.data(), f.size(), c.data());
+        assert(a == c);
+    }
+
+    cout << "PASSED" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+//! \file CoalescingQueue.h
+//! \brief Synchronized queue merging elements with the same key
+//!
+//! Queue for high-rate events: each element carries a key and an element
+//! pushed with the same key as a queued element can be merged into the
+//! last queued element with that key instead of being appended, also when
+//! elements with other keys were pushed in between, e.g. interleaved mouse
+//! drag and wheel events. A merged element takes the position of the
+//! element it is merged into; elements that must not be reordered, e.g.
+//! button and key presses, are declared as barriers: no element is merged
+//! into an element queued before a barrier.
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//! Synchronized coalescing queue:
+//! @c Push(key, e) invokes the merge function when an element with the
+//! same key was queued after the last barrier; if the merge function
+//! returns @c true the incoming element is discarded, otherwise it is
+//! appended.
+//! Barriers, and elements whose merge function always returns @c false,
+//! are never merged; barriers are also never reordered with respect to
+//! other elements.
+//! @c Pop() waits for data, @c PopAll() drains the queue without waiting.
+//! \tparam KeyT key type, must be equality comparable
+template< typename T, typename KeyT = int >
+class CoalescingQueue {
+public:
+    //! Merge incoming element into queued element with the same key;
+    //! return @c true if merged, @c false to append the incoming element.
+    //! Invoked with the queue lock held.
+    using Merge = std::function< bool (const KeyT& key, T& queued,
+                                       T&& incoming) >;
+    //! Merge function: replace queued element with incoming one.
+    static bool Replace(const KeyT&, T& queued, T&& incoming) {
+        queued = std::move(incoming);
+        return true;
+    }
+    //! Merge function: never merge.
+    static bool Append(const KeyT&, T&, T&&) { return false; }
+    //! Return @c true if elements with key are barriers.
+    using Barrier = std::function< bool (const KeyT& key) >;
+public:
+    //! \param merge merge function
+    //! \param barrier barrier predicate, no barriers if empty
+    explicit CoalescingQueue(Merge merge = Merge(&CoalescingQueue::Append),
+                             Barrier barrier = Barrier())
+        : merge_(std::move(merge)), barrier_(std::move(barrier)) {}
+    //! Push data to back of the queue or merge it with the last element
+    //! with the same key queued after the last barrier.
+    //! \return @c true if element merged, @c false if appended
+    bool Push(const KeyT& key, T&& e) {
+        std::lock_guard< std::mutex > guard(mutex_);
+        auto last = last_.begin();
+        while(last != last_.end() && !(last->first == key)) ++last;
+        if(last != last_.end() && last->second >= popped_
+           && last->second >= barrierEnd_
+           && merge_(key, queue_[last->second - popped_].second,
+                     std::move(e))) {
+            ++coalesced_;
+            return true;
+        }
+        const size_t i = popped_ + queue_.size();
+        queue_.emplace_back(key, std::move(e));
+        if(last != last_.end()) last->second = i;
+        else last_.emplace_back(key, i);
+        if(barrier_ && barrier_(key)) barrierEnd_ = i + 1;
+        cond_.notify_one(); //notify
+        return false;
+    }
+    //! Push copy of data.
+    bool Push(const KeyT& key, const T& e) {
+        return Push(key, T(e));
+    }
+    //! Return and remove element in front of queue.
+    //! Waits indefinitely for an element to be available.
+    T Pop() {
+        std::unique_lock< std::mutex > lock(mutex_);
+        cond_.wait(lock, [this] { return !queue_.empty() || done_; });
+        if(done_) return T();
+        T e(std::move(queue_.front().second));
+        queue_.pop_front();
+        ++popped_;
+        if(queue_.empty()) last_.clear();
+        return e;
+    }
+    //! Move all elements into @c out, in order, without waiting.
+    //! Elements are appended to @c out so that the same vector can be reused
+    //! across calls.
+    //! \return number of elements extracted
+    size_t PopAll(std::vector< T >& out) {
+        std::lock_guard< std::mutex > guard(mutex_);
+        const size_t n = queue_.size();
+        out.reserve(out.size() + n);
+        for(auto& e: queue_) out.push_back(std::move(e.second));
+        queue_.clear();
+        popped_ += n;
+        last_.clear();
+        return n;
+    }
+    //! Return all elements, in order, without waiting.
+    std::vector< T > PopAll() {
+        std::vector< T > v;
+        PopAll(v);
+        return v;
+    }
+    //! Empty ?
+    bool Empty() const {
+        std::lock_guard< std::mutex > guard(mutex_);
+        return queue_.empty();
+    }
+    size_t Size() const {
+        std::lock_guard< std::mutex > guard(mutex_);
+        return queue_.size();
+    }
+    //! Number of elements merged into queued elements since construction.
+    size_t Coalesced() const {
+        std::lock_guard< std::mutex > guard(mutex_);
+        return coalesced_;
+    }
+    //! Notify end of operations: will set end of operations flag to true
+    //! and notify condition variable
+    void Stop() {
+        std::lock_guard< std::mutex > guard(mutex_);
+        done_ = true;
+        cond_.notify_all(); //notify
+    }
+    //! Reset end of operations flag: allow reuse of current queue instance
+    void Reset() {
+        std::lock_guard< std::mutex > guard(mutex_);
+        done_ = false;
+    }
+    //! End of operations requested ?
+    bool Done() const {
+        std::lock_guard< std::mutex > guard(mutex_);
+        return done_;
+    }
+private:
+    std::deque< std::pair< KeyT, T > > queue_;
+    //! Position of the last element pushed with each key: number of
+    //! elements pushed before it; positions of popped elements are stale.
+    //! Searched linearly, the number of distinct keys is expected to be
+    //! small and keys are only required to be equality comparable.
+    std::vector< std::pair< KeyT, size_t > > last_;
+    //! Number of elements popped since construction.
+    size_t popped_ = 0;
+    //! Position following the last barrier.
+    size_t barrierEnd_ = 0;
+    Merge merge_;
+    Barrier barrier_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    size_t coalesced_ = 0;
+    bool done_ = false;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+//! \file MPSCQueue.h
+//! \brief Lock-free multiple producer, single consumer queue
+//!
+//! Unbounded intrusive linked list queue: producers link a new node with
+//! a single atomic exchange, the consumer follows the links without any
+//! atomic read-modify-write. Algorithm by D. Vyukov, "Non-intrusive MPSC
+//! node-based queue", 1024cores.net.
+
+#include <atomic>
+#include <utility>
+
+//! Multiple producer, single consumer queue:
+//! @c Push() can be called from any thread, @c Pop() and @c Empty() must
+//! only be called by the consumer thread.
+//! Each push allocates one node; elements must be default constructible,
+//! the popped node keeps a moved-from element until the next pop.
+//! A push in progress hides the elements pushed after it from the
+//! consumer until its node is linked: producers that need the consumer
+//! to see their element shall notify it after @c Push() returns.
+template< typename T >
+class MPSCQueue {
+public:
+    MPSCQueue() : head_(new Node), tail_(head_.load()) {}
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+    ~MPSCQueue() {
+        T e;
+        while(Pop(e));
+        delete tail_;
+    }
+    //! Push element; callable from any thread.
+    void Push(T e) {
+        Node* n = new Node(std::move(e));
+        Node* prev = head_.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+    //! Pop element; consumer thread only.
+    //! \return \c false if the queue is empty
+    bool Pop(T& e) {
+        Node* next = tail_->next.load(std::memory_order_acquire);
+        if(!next) return false;
+        e = std::move(next->value);
+        delete tail_;
+        tail_ = next;
+        return true;
+    }
+    //! Return \c true if no element can be popped; consumer thread only.
+    bool Empty() const {
+        return tail_->next.load(std::memory_order_acquire) == nullptr;
+    }
+private:
+    struct Node {
+        Node() : next(nullptr) {}
+        explicit Node(T&& e) : next(nullptr), value(std::move(e)) {}
+        std::atomic< Node* > next;
+        T value;
+    };
+    //! Last pushed node, updated by producers.
+    std::atomic< Node* > head_;
+    //! Node preceding the next element, owned by the consumer.
+    Node* tail_;
+};
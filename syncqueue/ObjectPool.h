@@ -0,0 +1,278 @@
+#pragma once
+
+//! \file ObjectPool.h
+//! \brief Pool of reusable objects
+//!
+//! Objects are leased from the pool through RAII handles which put the
+//! object back into the pool when destroyed.
+//! Each thread keeps a small cache of free objects so that most
+//! acquire/release operations do not touch the shared lock; objects are
+//! moved between the thread cache and the shared list in batches.
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//! Object pool:
+//! @c Acquire() returns a free object or a new one created through the
+//! factory function if none available; objects are reset through the
+//! reset function when returned to the pool.
+//! At most @c Capacity() idle objects are kept, objects returned to a full
+//! pool are destroyed.
+//! The pool can be destroyed while objects are still leased: shared state
+//! is kept alive by the leases.
+template< typename T >
+class ObjectPool {
+    struct Core;
+public:
+    //! Create new object.
+    using Factory = std::function< T*() >;
+    //! Reset object before putting it back into the pool.
+    using Reset = std::function< void (T&) >;
+    //! Exclusive ownership of a pooled object; returns the object to the
+    //! pool when destroyed.
+    class Lease {
+    public:
+        Lease() : obj_(nullptr) {}
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease(Lease&& l) : obj_(l.obj_), core_(std::move(l.core_)) {
+            l.obj_ = nullptr;
+        }
+        Lease& operator=(Lease&& l) {
+            if(this == &l) return *this;
+            Release();
+            obj_ = l.obj_;
+            core_ = std::move(l.core_);
+            l.obj_ = nullptr;
+            return *this;
+        }
+        ~Lease() { Release(); }
+        T& operator*() const { return *obj_; }
+        T* operator->() const { return obj_; }
+        T* Get() const { return obj_; }
+        explicit operator bool() const { return obj_ != nullptr; }
+        //! Return object to pool.
+        void Release() {
+            if(!obj_) return;
+            core_->Put(obj_);
+            obj_ = nullptr;
+            core_.reset();
+        }
+    private:
+        friend class ObjectPool;
+        Lease(T* obj, const std::shared_ptr< Core >& core)
+            : obj_(obj), core_(core) {}
+    private:
+        T* obj_;
+        std::shared_ptr< Core > core_;
+    };
+public:
+    //! Constructor.
+    //! \param capacity maximum number of idle objects
+    //! \param factory function invoked to create new objects
+    //! \param reset function invoked on objects returned to the pool
+    //! \param threadCacheSize maximum number of idle objects cached by each
+    //! thread, set to zero to disable per-thread caching
+    explicit ObjectPool(size_t capacity = 64,
+                        Factory factory = Factory(&ObjectPool::New),
+                        Reset reset = Reset(),
+                        size_t threadCacheSize = 8)
+        : core_(std::make_shared< Core >(capacity, std::move(factory),
+                                         std::move(reset),
+                                         threadCacheSize)) {}
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    //! Lease object, creating a new one if the pool is empty.
+    Lease Acquire() {
+        return Lease(core_->Get(), core_);
+    }
+    //! Lease object through a \c shared_ptr: the object is returned to the
+    //! pool when the last reference is destroyed.
+    //! Requires the allocation of a \c shared_ptr control block, use
+    //! @c Acquire() when possible.
+    std::shared_ptr< T > AcquireShared() {
+        std::shared_ptr< Core > core = core_;
+        return std::shared_ptr< T >(core_->Get(), [core](T* p) {
+            core->Put(p);
+        });
+    }
+    //! Add object to pool.
+    void Put(T&& obj) {
+        core_->Put(new T(std::move(obj)));
+    }
+    //! Number of idle objects, including the ones cached by other threads.
+    size_t Idle() const {
+        return core_->idle.load(std::memory_order_relaxed);
+    }
+    //! Number of objects created by the factory function.
+    size_t Created() const {
+        return core_->created.load(std::memory_order_relaxed);
+    }
+    size_t Capacity() const {
+        return core_->capacity.load(std::memory_order_relaxed);
+    }
+    //! Set maximum number of idle objects and trim excess objects.
+    void SetCapacity(size_t c) {
+        core_->capacity.store(c, std::memory_order_relaxed);
+        Trim(c);
+    }
+    //! Destroy idle objects in the shared list and in the current thread's
+    //! cache until at most @c keep objects are left idle.
+    //! Objects cached by other threads are not affected.
+    void Trim(size_t keep = 0) {
+        core_->Trim(keep);
+    }
+private:
+    static T* New() { return new T(); }
+    //! Per-thread cache of free objects, shared by all the pools of the
+    //! same type.
+    struct ThreadCache {
+        const Core* core;
+        std::weak_ptr< Core > ref;
+        std::vector< T* > objects;
+    };
+    struct ThreadCaches {
+        ~ThreadCaches() {
+            //return cached objects to their pool or delete them if the
+            //pool does not exist anymore
+            for(auto& c: caches) {
+                std::shared_ptr< Core > core = c.ref.lock();
+                if(core) core->Reclaim(c.objects);
+                else for(auto o: c.objects) delete o;
+            }
+        }
+        std::vector< ThreadCache > caches;
+    };
+    static ThreadCaches& Caches() {
+        static thread_local ThreadCaches c;
+        return c;
+    }
+    //! Shared state.
+    struct Core : std::enable_shared_from_this< Core > {
+        Core(size_t cap, Factory f, Reset r, size_t cacheSize)
+            : factory(std::move(f)), reset(std::move(r)),
+              threadCacheSize(cacheSize), capacity(cap), idle(0),
+              created(0) {
+            free.reserve(cap);
+        }
+        ~Core() {
+            for(auto o: free) delete o;
+        }
+        //! Return current thread's cache or nullptr if caching disabled.
+        std::vector< T* >* Cache() {
+            if(threadCacheSize == 0) return nullptr;
+            std::vector< ThreadCache >& caches = Caches().caches;
+            for(auto i = caches.begin(); i != caches.end();) {
+                if(i->core == this && !i->ref.expired()) return &i->objects;
+                if(i->ref.expired()) {
+                    //pool destroyed: objects are owned by this thread
+                    for(auto o: i->objects) delete o;
+                    i = caches.erase(i);
+                } else ++i;
+            }
+            ThreadCache c;
+            c.core = this;
+            c.ref = this->shared_from_this();
+            c.objects.reserve(threadCacheSize);
+            caches.push_back(std::move(c));
+            return &caches.back().objects;
+        }
+        T* Get() {
+            std::vector< T* >* cache = Cache();
+            if(cache && cache->empty()) {
+                //refill half of the thread cache from shared list
+                std::lock_guard< std::mutex > l(mutex);
+                const size_t n =
+                    std::min(free.size(), std::max(threadCacheSize / 2,
+                                                   size_t(1)));
+                cache->insert(cache->end(), free.end() - n, free.end());
+                free.resize(free.size() - n);
+            }
+            if(cache && !cache->empty()) {
+                T* o = cache->back();
+                cache->pop_back();
+                idle.fetch_sub(1, std::memory_order_relaxed);
+                return o;
+            }
+            if(!cache) {
+                std::lock_guard< std::mutex > l(mutex);
+                if(!free.empty()) {
+                    T* o = free.back();
+                    free.pop_back();
+                    idle.fetch_sub(1, std::memory_order_relaxed);
+                    return o;
+                }
+            }
+            created.fetch_add(1, std::memory_order_relaxed);
+            return factory();
+        }
+        void Put(T* o) {
+            if(reset) reset(*o);
+            if(idle.load(std::memory_order_relaxed)
+               >= capacity.load(std::memory_order_relaxed)) {
+                delete o;
+                return;
+            }
+            std::vector< T* >* cache = Cache();
+            if(!cache) {
+                PutShared(o);
+                return;
+            }
+            if(cache->size() == threadCacheSize) {
+                //move half of the thread cache to shared list
+                std::lock_guard< std::mutex > l(mutex);
+                const size_t n = std::max(threadCacheSize / 2, size_t(1));
+                free.insert(free.end(), cache->end() - n, cache->end());
+                cache->resize(cache->size() - n);
+            }
+            cache->push_back(o);
+            idle.fetch_add(1, std::memory_order_relaxed);
+        }
+        void PutShared(T* o) {
+            std::lock_guard< std::mutex > l(mutex);
+            free.push_back(o);
+            idle.fetch_add(1, std::memory_order_relaxed);
+        }
+        //! Move objects from an exiting thread's cache to the shared list.
+        void Reclaim(const std::vector< T* >& objects) {
+            std::lock_guard< std::mutex > l(mutex);
+            free.insert(free.end(), objects.begin(), objects.end());
+        }
+        void Trim(size_t keep) {
+            std::vector< T* >* cache = Cache();
+            std::vector< T* > trimmed;
+            {
+                std::lock_guard< std::mutex > l(mutex);
+                if(cache) {
+                    free.insert(free.end(), cache->begin(), cache->end());
+                    cache->clear();
+                }
+                const size_t others =
+                    idle.load(std::memory_order_relaxed) - free.size();
+                const size_t keepShared = keep > others ? keep - others : 0;
+                if(free.size() > keepShared) {
+                    trimmed.assign(free.begin() + keepShared, free.end());
+                    free.resize(keepShared);
+                    idle.fetch_sub(trimmed.size(), std::memory_order_relaxed);
+                }
+            }
+            for(auto o: trimmed) delete o;
+        }
+        std::mutex mutex;
+        //! Shared list of free objects.
+        std::vector< T* > free;
+        Factory factory;
+        Reset reset;
+        const size_t threadCacheSize;
+        std::atomic< size_t > capacity;
+        std::atomic< size_t > idle;
+        std::atomic< size_t > created;
+    };
+private:
+    std::shared_ptr< Core > core_;
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+//! \file QueueStats.h
+//! \brief Optional instrumentation of synchronized types
+//!
+//! Instrumentation policies used by \c SyncQueue and \c SyncValue:
+//! - \c NoQueueInstrument: default, every hook is an empty inline function
+//!   and elements are stored as-is
+//! - \c QueueInstrument: elements are time-stamped when added; depth,
+//!   enqueue to dequeue latency, time spent waiting for data and lock
+//!   contention are recorded
+//!
+//! Instrumentation is enabled for all instances by defining
+//! \c SYNCQUEUE_INSTRUMENT before including the headers or per instance
+//! by passing \c QueueInstrument as the second template parameter.
+//! Statistics are returned as a \c QueueStats snapshot.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+//! Snapshot of queue statistics.
+struct QueueStats {
+    //! Number of latency histogram buckets.
+    static const int LATENCY_BUCKETS = 32;
+    QueueStats() { latencyHistogram.fill(0); }
+    //! \c false if statistics are not being collected.
+    bool enabled = false;
+    //! Number of elements in the queue at snapshot time.
+    size_t depth = 0;
+    //! Maximum number of elements ever present in the queue.
+    size_t highWaterDepth = 0;
+    //! Number of elements added.
+    uint64_t pushed = 0;
+    //! Number of elements removed.
+    uint64_t popped = 0;
+    //! Number of times the lock was found already taken (failed try-lock).
+    uint64_t contended = 0;
+    //! Number of consumer calls which had to wait for data.
+    uint64_t blockedPops = 0;
+    //! Total time consumers spent waiting for data.
+    std::chrono::nanoseconds blockedTime{0};
+    //! Sum of enqueue to dequeue latencies.
+    std::chrono::nanoseconds totalLatency{0};
+    //! Maximum enqueue to dequeue latency.
+    std::chrono::nanoseconds maxLatency{0};
+    //! Enqueue to dequeue latency histogram: element @c i is the number of
+    //! elements which spent [2^(i-1), 2^i) microseconds in the queue;
+    //! element @c 0 counts latencies below one microsecond.
+    std::array< uint64_t, LATENCY_BUCKETS > latencyHistogram;
+    //! Average enqueue to dequeue latency.
+    std::chrono::nanoseconds AverageLatency() const {
+        return popped ? totalLatency / int64_t(popped)
+                      : std::chrono::nanoseconds(0);
+    }
+    //! Upper bound of the latency histogram bucket containing the requested
+    //! percentile, @c p in [0, 1].
+    std::chrono::microseconds LatencyPercentile(double p) const {
+        const double target = p * double(popped);
+        uint64_t count = 0;
+        for(int i = 0; i != LATENCY_BUCKETS; ++i) {
+            count += latencyHistogram[i];
+            if(count > 0 && double(count) >= target)
+                return std::chrono::microseconds(int64_t(1) << i);
+        }
+        return std::chrono::microseconds(int64_t(1) << (LATENCY_BUCKETS - 1));
+    }
+};
+
+//! No instrumentation: zero overhead.
+class NoQueueInstrument {
+public:
+    //! Type stored in the queue for each element.
+    template< typename T >
+    using Entry = T;
+    //! Wait start time: not recorded.
+    struct WaitTime {};
+    template< typename T >
+    static T& Value(Entry< T >& e) { return e; }
+    template< typename T >
+    static void Assign(Entry< T >& e, T&& v) { e = std::move(v); }
+    void Acquire(std::mutex& m) const { m.lock(); }
+    void Pushed(size_t) {}
+    template< typename T >
+    void Popped(const Entry< T >&) {}
+    WaitTime WaitBegin() const { return WaitTime(); }
+    void WaitEnd(WaitTime) {}
+    QueueStats Snapshot(size_t depth) const {
+        QueueStats s;
+        s.depth = depth;
+        return s;
+    }
+    void Reset() {}
+};
+
+//! Record queue statistics.
+//! All methods except @c Acquire() must be invoked with the queue mutex
+//! held.
+class QueueInstrument {
+public:
+    using Clock = std::chrono::steady_clock;
+    //! Element time-stamped at insertion time.
+    template< typename T >
+    struct Entry {
+        Entry() : value(), time(Clock::now()) {}
+        Entry(const T& v) : value(v), time(Clock::now()) {}
+        Entry(T&& v) : value(std::move(v)), time(Clock::now()) {}
+        T value;
+        Clock::time_point time;
+    };
+    using WaitTime = Clock::time_point;
+    template< typename T >
+    static T& Value(Entry< T >& e) { return e.value; }
+    template< typename T >
+    static void Assign(Entry< T >& e, T&& v) {
+        e.value = std::move(v);
+        e.time = Clock::now();
+    }
+    QueueInstrument() : contended_(0) {}
+    //! Lock mutex, recording a contention event if already locked.
+    void Acquire(std::mutex& m) const {
+        if(m.try_lock()) return;
+        contended_.fetch_add(1, std::memory_order_relaxed);
+        m.lock();
+    }
+    //! Element added, @c depth is the new number of elements.
+    void Pushed(size_t depth) {
+        ++stats_.pushed;
+        if(depth > stats_.highWaterDepth) stats_.highWaterDepth = depth;
+    }
+    //! Element removed: record latency.
+    template< typename T >
+    void Popped(const Entry< T >& e) {
+        ++stats_.popped;
+        const std::chrono::nanoseconds l =
+            std::chrono::duration_cast< std::chrono::nanoseconds >(
+                Clock::now() - e.time);
+        stats_.totalLatency += l;
+        if(l > stats_.maxLatency) stats_.maxLatency = l;
+        ++stats_.latencyHistogram[Bucket(l)];
+    }
+    //! Consumer about to wait for data.
+    WaitTime WaitBegin() const { return Clock::now(); }
+    //! Consumer done waiting.
+    void WaitEnd(WaitTime begin) {
+        ++stats_.blockedPops;
+        stats_.blockedTime +=
+            std::chrono::duration_cast< std::chrono::nanoseconds >(
+                Clock::now() - begin);
+    }
+    QueueStats Snapshot(size_t depth) const {
+        QueueStats s = stats_;
+        s.enabled = true;
+        s.depth = depth;
+        s.contended = contended_.load(std::memory_order_relaxed);
+        return s;
+    }
+    void Reset() {
+        stats_ = QueueStats();
+        contended_.store(0, std::memory_order_relaxed);
+    }
+private:
+    static int Bucket(std::chrono::nanoseconds l) {
+        uint64_t us = uint64_t(
+            std::chrono::duration_cast< std::chrono::microseconds >(l).count());
+        int b = 0;
+        while(us && b != QueueStats::LATENCY_BUCKETS - 1) {
+            us >>= 1;
+            ++b;
+        }
+        return b;
+    }
+private:
+    QueueStats stats_;
+    //! Updated before the lock is acquired.
+    mutable std::atomic< uint64_t > contended_;
+};
+
+#ifdef SYNCQUEUE_INSTRUMENT
+using DefaultQueueInstrument = QueueInstrument;
+#else
+using DefaultQueueInstrument = NoQueueInstrument;
+#endif
@@ -10,58 +10,80 @@
 #include <mutex>
 #include <condition_variable>
 
+#include "QueueStats.h"
+
 //! Synchronized queue:
 //! @c Pop() waits for data
-template<typename T>
+//! \tparam InstrumentT statistics collection policy, see QueueStats.h
+template<typename T, typename InstrumentT = DefaultQueueInstrument>
 class SyncQueue {
+    using Entry = typename InstrumentT::template Entry< T >;
 public:
     //! Push data to back of the queue; if a temporary (rvalue ref)
     //! is passed then the data is moved into the internal `std::deque`
     //! instance.
     void Push(T&& e) {
-        std::lock_guard<std::mutex> guard(mutex_);
-        queue_.push_back(std::forward< T >(e));
+        instrument_.Acquire(mutex_);
+        std::lock_guard<std::mutex> guard(mutex_, std::adopt_lock);
+        queue_.emplace_back(std::forward< T >(e));
+        instrument_.Pushed(queue_.size());
         cond_.notify_one(); //notify
     }
     //! Push data to back of the queue.
     void Push(const T& e) {
-        std::lock_guard< std::mutex > guard(mutex_);
-        queue_.push_back(e);
+        instrument_.Acquire(mutex_);
+        std::lock_guard< std::mutex > guard(mutex_, std::adopt_lock);
+        queue_.emplace_back(e);
+        instrument_.Pushed(queue_.size());
         cond_.notify_one(); //notify
     }
     //! Push data to front of queue.
     //! Used to add a high piority message, normally to signal
     //! end of operations
     void PushFront(const T& e) {
-        std::lock_guard< std::mutex > guard(mutex_);
-        queue_.push_front(e);
+        instrument_.Acquire(mutex_);
+        std::lock_guard< std::mutex > guard(mutex_, std::adopt_lock);
+        queue_.emplace_front(e);
+        instrument_.Pushed(queue_.size());
         cond_.notify_one(); //notify
     }
     //! Push data to front of queue; supports move from temporary
     //! Used to add a high piority message, normally to signal
     //! end of operations
     void PushFront(T&& e) {
-        std::lock_guard< std::mutex > guard(mutex_);
-        queue_.push_front(std::forward< T >(e));
+        instrument_.Acquire(mutex_);
+        std::lock_guard< std::mutex > guard(mutex_, std::adopt_lock);
+        queue_.emplace_front(std::forward< T >(e));
+        instrument_.Pushed(queue_.size());
         cond_.notify_one(); //notify
     }
     //! Add elementes in [begin, end) interval to queue
     //! in a single atomic operation.
     template<typename FwdT>
     void Buffer(FwdT begin, FwdT end) {
-        std::lock_guard< std::mutex > guard(mutex_);
-        while(begin++ != end) queue_.push_back(*begin);
+        instrument_.Acquire(mutex_);
+        std::lock_guard< std::mutex > guard(mutex_, std::adopt_lock);
+        for(; begin != end; ++begin) {
+            queue_.emplace_back(*begin);
+            instrument_.Pushed(queue_.size());
+        }
         cond_.notify_one();
     }
     //! Return and remove element in front of queue.
     //! Waits indefinitely for an element to be available.
     T Pop() {
-        std::unique_lock< std::mutex > lock(mutex_);
+        instrument_.Acquire(mutex_);
+        std::unique_lock< std::mutex > lock(mutex_, std::adopt_lock);
         //stop and wait for notification if condition is false;
         //continue otherwise
-        cond_.wait(lock, [this] { return !queue_.empty() || done_; });
+        if(queue_.empty() && !done_) {
+            const typename InstrumentT::WaitTime w = instrument_.WaitBegin();
+            cond_.wait(lock, [this] { return !queue_.empty() || done_; });
+            instrument_.WaitEnd(w);
+        }
         if(done_) return T();
-        T e(std::move(queue_.front()));
+        T e(std::move(InstrumentT::Value(queue_.front())));
+        instrument_.Popped(queue_.front());
         queue_.pop_front();
         return e;
     }
@@ -69,15 +91,21 @@ public:
     //! This is intended to be used \em only when data access happens
     //! from inside a pre-existing loop
     bool Empty() const {
-        std::lock_guard< std::mutex > lg(mutex_);
+        instrument_.Acquire(mutex_);
+        std::lock_guard< std::mutex > lg(mutex_, std::adopt_lock);
         const bool e = queue_.empty();
         return e;
     }
     //! Notify end of operations: will set end of operations flag to true
     //! and notify condition variable
     void Stop() {
-        done_ = true;
-        cond_.notify_one(); //notify
+        {
+            //set flag with lock held: a consumer between the predicate
+            //check and the wait would otherwise miss the notification
+            std::lock_guard< std::mutex > guard(mutex_);
+            done_ = true;
+        }
+        cond_.notify_all(); //notify
     }
     //! Reset: set end of operations flag to true: allow reuse of current
     //! queue instance
@@ -93,13 +121,26 @@ public:
         return Done();
     }
     size_t Size() const {
-        std::lock_guard< std::mutex > lg(mutex_);
+        instrument_.Acquire(mutex_);
+        std::lock_guard< std::mutex > lg(mutex_, std::adopt_lock);
         const size_t e = queue_.size();
         return e;
     }
+    //! Statistics snapshot; only depth is reported if instrumentation is
+    //! disabled.
+    QueueStats Stats() const {
+        std::lock_guard< std::mutex > lg(mutex_);
+        return instrument_.Snapshot(queue_.size());
+    }
+    //! Clear statistics.
+    void ResetStats() {
+        std::lock_guard< std::mutex > lg(mutex_);
+        instrument_.Reset();
+    }
 private:
-    std::deque<T> queue_;
+    std::deque<Entry> queue_;
     mutable std::mutex mutex_;
     std::condition_variable cond_;
     bool done_ = false;
+    InstrumentT instrument_;
 };
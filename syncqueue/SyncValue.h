@@ -11,26 +11,39 @@
 #include <mutex>
 #include <condition_variable>
 
+#include "QueueStats.h"
+
 //! Synchronized value:
 //! @c Get() waits for data
-template<typename T>
+//! \tparam InstrumentT statistics collection policy, see QueueStats.h
+template<typename T, typename InstrumentT = DefaultQueueInstrument>
 class SyncValue {
+    using Entry = typename InstrumentT::template Entry< T >;
 public:
     //! Put
     void Put(T&& v) {
-        std::lock_guard<std::mutex> guard(mutex_);
-        value_ = std::move(v); //MUST HAVE AN OVERLOADED operator=(T&&)
+        instrument_.Acquire(mutex_);
+        std::lock_guard<std::mutex> guard(mutex_, std::adopt_lock);
+        //MUST HAVE AN OVERLOADED operator=(T&&)
+        InstrumentT::Assign(value_, std::move(v));
         empty_ = false;
+        instrument_.Pushed(1);
         cond_.notify_one(); //notify
     }
     //! Return and remove element in front of queue.
     //! Waits indefinitely for an element to be available.
     T Get() {
-        std::unique_lock<std::mutex> lock(mutex_);
+        instrument_.Acquire(mutex_);
+        std::unique_lock<std::mutex> lock(mutex_, std::adopt_lock);
         //stop and wait for notification if condition is false;
         //continue otherwise
-        cond_.wait(lock, [this] { return !empty_; });
-        T e(std::move(value_));
+        if(empty_) {
+            const typename InstrumentT::WaitTime w = instrument_.WaitBegin();
+            cond_.wait(lock, [this] { return !empty_; });
+            instrument_.WaitEnd(w);
+        }
+        T e(std::move(InstrumentT::Value(value_)));
+        instrument_.Popped(value_);
         empty_ = true;
         return e;
     }
@@ -47,10 +60,21 @@ public:
     }
     void Reset() { done_ = false; }
     bool operator!() const { return Done(); }
+    //! Statistics snapshot, see SyncQueue::Stats().
+    QueueStats Stats() const {
+        std::lock_guard< std::mutex > lg(mutex_);
+        return instrument_.Snapshot(empty_ ? 0 : 1);
+    }
+    //! Clear statistics.
+    void ResetStats() {
+        std::lock_guard< std::mutex > lg(mutex_);
+        instrument_.Reset();
+    }
 private:
-    T value_;
+    Entry value_;
     bool empty_ = true;
     mutable std::mutex mutex_;
     std::condition_variable cond_;
     bool done_ = false;
+    InstrumentT instrument_;
 };
@@ -0,0 +1,326 @@
+#pragma once
+
+//! \file TaskScheduler.h
+//! \brief Work-stealing task scheduler
+//!
+//! Fixed size pool of worker threads, each owning a Chase-Lev deque;
+//! tasks submitted from outside the pool go into a global injection queue.
+//! Idle workers try to steal from each other and park on a condition
+//! variable when no work is available.
+//! A single instance is meant to be shared by all the parallel stages of
+//! an application (e.g. image compression and websocket services) so that
+//! the total number of threads matches the number of available cores.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "WorkStealingDeque.h"
+
+//! Work-stealing scheduler:
+//! @c Submit() returns a future, @c ParallelFor() splits an index range
+//! into chunks executed by the workers and the calling thread.
+class TaskScheduler {
+public:
+    //! Start @c numWorkers threads; by default one per hardware thread.
+    explicit TaskScheduler(int numWorkers = DefaultConcurrency())
+        : injected_(0), stop_(false), sleeping_(0) {
+        if(numWorkers < 1) numWorkers = 1;
+        for(int i = 0; i != numWorkers; ++i)
+            workers_.push_back(std::unique_ptr< Worker >(new Worker(i)));
+        for(int i = 0; i != numWorkers; ++i)
+            workers_[i]->thread = std::thread(&TaskScheduler::Loop, this, i);
+    }
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    //! Run all pending tasks then join worker threads.
+    ~TaskScheduler() {
+        {
+            std::lock_guard< std::mutex > l(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        for(auto& w: workers_) w->thread.join();
+    }
+    //! Number of worker threads.
+    int NumWorkers() const { return int(workers_.size()); }
+    //! Default number of workers: number of hardware threads or 1 if
+    //! not available.
+    static int DefaultConcurrency() {
+        const unsigned n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : int(n);
+    }
+    //! Schedule callable object for execution and return future
+    //! holding the result or the thrown exception.
+    //! When invoked from a worker thread the task is pushed into the
+    //! worker's own deque, from the global injection queue otherwise.
+    template< typename F >
+    std::future< typename std::result_of< F() >::type > Submit(F&& f) {
+        using R = typename std::result_of< F() >::type;
+        std::packaged_task< R() > pt(std::forward< F >(f));
+        std::future< R > r = pt.get_future();
+        Schedule(new TaskImpl< std::packaged_task< R() > >(std::move(pt)));
+        return r;
+    }
+    //! Invoke @c f(i) for each @c i in [begin, end).
+    //! The range is split into chunks of @c grain elements picked
+    //! dynamically by the calling thread and by up to @c NumWorkers()
+    //! helper tasks; returns when all the elements have been processed.
+    //! The first exception thrown by @c f is re-thrown in the calling
+    //! thread, remaining chunks are skipped.
+    //! Can be safely nested: a worker waiting for completion keeps
+    //! executing other tasks.
+    template< typename IntT, typename F >
+    void ParallelFor(IntT begin, IntT end, IntT grain, const F& f) {
+        if(end <= begin) return;
+        if(grain < 1) grain = 1;
+        const IntT chunks = (end - begin + grain - 1) / grain;
+        if(chunks == 1) {
+            for(IntT i = begin; i != end; ++i) f(i);
+            return;
+        }
+        ForState< IntT, F > s(begin, end, grain, chunks, f);
+        const int helpers =
+            int(std::min(IntT(chunks - 1), IntT(NumWorkers())));
+        s.pending = helpers;
+        for(int h = 0; h != helpers; ++h)
+            Schedule(new TaskImpl< ForHelper< IntT, F > >(
+                ForHelper< IntT, F >(&s)));
+        s.Run();
+        Wait([&s]() {
+            std::lock_guard< std::mutex > l(s.mutex);
+            return s.pending == 0;
+        }, [&s]() {
+            std::unique_lock< std::mutex > l(s.mutex);
+            s.done.wait(l, [&s]() { return s.pending == 0; });
+        });
+        if(s.error) std::rethrow_exception(s.error);
+    }
+    //! Wait for future to become ready and return its value.
+    //! Use this method instead of @c std::future::get() from inside tasks
+    //! to have the waiting worker execute other tasks instead of blocking.
+    template< typename R >
+    R Get(std::future< R >& f) {
+        Wait([&f]() {
+            return f.wait_for(std::chrono::seconds(0))
+                   == std::future_status::ready;
+        }, [&f]() { f.wait(); });
+        return f.get();
+    }
+    //! Returns \c true if invoked from one of this scheduler's workers.
+    bool InWorker() const {
+        return Current().scheduler == this;
+    }
+private:
+    //! Type-erased task.
+    struct Task {
+        virtual void Run() = 0;
+        virtual ~Task() {}
+    };
+    template< typename F >
+    struct TaskImpl : Task {
+        explicit TaskImpl(F&& f) : f_(std::move(f)) {}
+        void Run() override { f_(); }
+        F f_;
+    };
+    //! Worker data: task deque and thread.
+    struct Worker {
+        explicit Worker(int i) : seed(uint32_t(2654435761u * (i + 1))) {}
+        WorkStealingDeque< Task* > tasks;
+        std::thread thread;
+        //! Random number generator state used to select victims.
+        uint32_t seed;
+    };
+    //! Identify current thread as a worker of a specific scheduler.
+    struct WorkerContext {
+        const TaskScheduler* scheduler = nullptr;
+        int id = -1;
+    };
+    static WorkerContext& Current() {
+        static thread_local WorkerContext c;
+        return c;
+    }
+    //! Parallel for state shared between calling thread and helper tasks;
+    //! allocated on the stack of the calling thread.
+    template< typename IntT, typename F >
+    struct ForState {
+        ForState(IntT b, IntT e, IntT g, IntT c, const F& fun)
+            : begin(b), end(e), grain(g), chunks(c), f(fun), next(0),
+              pending(0) {}
+        //! Process chunks until none left.
+        void Run() {
+            IntT c;
+            while((c = next.fetch_add(1)) < chunks) {
+                const IntT lo = begin + c * grain;
+                const IntT hi = std::min(IntT(lo + grain), end);
+                try {
+                    for(IntT i = lo; i != hi; ++i) f(i);
+                } catch(...) {
+                    std::lock_guard< std::mutex > l(mutex);
+                    if(!error) error = std::current_exception();
+                    next.store(chunks);
+                }
+            }
+        }
+        IntT begin;
+        IntT end;
+        IntT grain;
+        IntT chunks;
+        const F& f;
+        std::atomic< IntT > next;
+        int pending;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    template< typename IntT, typename F >
+    struct ForHelper {
+        explicit ForHelper(ForState< IntT, F >* s) : state(s) {}
+        void operator()() {
+            state->Run();
+            std::lock_guard< std::mutex > l(state->mutex);
+            if(--state->pending == 0) state->done.notify_all();
+        }
+        ForState< IntT, F >* state;
+    };
+private:
+    //! Push task into current worker's deque or injection queue and
+    //! wake up a parked worker if any.
+    void Schedule(Task* t) {
+        WorkerContext& c = Current();
+        if(c.scheduler == this) {
+            workers_[c.id]->tasks.Push(t);
+            //pairs with fence in Park()
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(sleeping_.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard< std::mutex > l(mutex_);
+                cond_.notify_one();
+            }
+        } else {
+            std::lock_guard< std::mutex > l(mutex_);
+            injection_.push_back(t);
+            injected_.store(injection_.size(), std::memory_order_relaxed);
+            if(sleeping_.load(std::memory_order_relaxed) > 0)
+                cond_.notify_one();
+        }
+    }
+    //! Find task: own deque first, then injection queue, then steal from
+    //! a random victim.
+    Task* FindTask(int id) {
+        Task* t = nullptr;
+        if(id >= 0 && workers_[id]->tasks.Pop(t)) return t;
+        if(injected_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard< std::mutex > l(mutex_);
+            if(!injection_.empty()) {
+                t = injection_.front();
+                injection_.pop_front();
+                injected_.store(injection_.size(), std::memory_order_relaxed);
+                return t;
+            }
+        }
+        const int n = NumWorkers();
+        const int start = id >= 0 ? int(NextRandom(*workers_[id]) % n) : 0;
+        for(int i = 0; i != n; ++i) {
+            const int v = (start + i) % n;
+            if(v == id) continue;
+            if(workers_[v]->tasks.Steal(t)) return t;
+        }
+        return nullptr;
+    }
+    //! Returns \c true if any task is available; approximate.
+    bool HasWork() const {
+        if(!injection_.empty()) return true;
+        for(auto& w: workers_) if(!w->tasks.Empty()) return true;
+        return false;
+    }
+    //! Wait until predicate is true: workers keep on executing tasks,
+    //! other threads invoke the blocking function.
+    template< typename P, typename B >
+    void Wait(const P& ready, const B& block) {
+        WorkerContext& c = Current();
+        if(c.scheduler != this) {
+            block();
+            return;
+        }
+        while(!ready()) {
+            Task* t = FindTask(c.id);
+            if(t) Execute(t);
+            else std::this_thread::yield();
+        }
+    }
+    static void Execute(Task* t) {
+        t->Run();
+        delete t;
+    }
+    static uint32_t NextRandom(Worker& w) {
+        //xorshift32
+        uint32_t x = w.seed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        w.seed = x;
+        return x;
+    }
+    //! Park worker until new work is scheduled or scheduler is stopped.
+    //! \return \c false if scheduler stopped and no work is left
+    bool Park() {
+        std::unique_lock< std::mutex > l(mutex_);
+        sleeping_.fetch_add(1, std::memory_order_relaxed);
+        //pairs with fence in Schedule(): either the scheduling thread sees
+        //the sleeping counter or this thread sees the new task
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(!HasWork()) {
+            if(stop_) {
+                sleeping_.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            cond_.wait(l);
+        }
+        sleeping_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    //! Worker loop: execute available tasks, spin for a short while when
+    //! no task is found then park.
+    void Loop(int id) {
+        WorkerContext& c = Current();
+        c.scheduler = this;
+        c.id = id;
+        const int spinCount = 64;
+        while(true) {
+            Task* t = FindTask(id);
+            for(int s = 0; !t && s != spinCount; ++s) {
+                std::this_thread::yield();
+                t = FindTask(id);
+            }
+            if(t) {
+                Execute(t);
+                continue;
+            }
+            if(!Park()) break;
+        }
+        c.scheduler = nullptr;
+        c.id = -1;
+    }
+private:
+    std::vector< std::unique_ptr< Worker > > workers_;
+    //! Tasks submitted from non-worker threads.
+    std::deque< Task* > injection_;
+    //! Size of injection queue readable without locking.
+    std::atomic< size_t > injected_;
+    //! Guards injection queue, parking and stop flag.
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_;
+    //! Number of parked workers.
+    std::atomic< int > sleeping_;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+//! \file WorkStealingDeque.h
+//! \brief Chase-Lev work-stealing deque
+//!
+//! Lock-free double ended queue: the owner thread pushes and pops at the
+//! bottom, any other thread steals from the top.
+//! Memory orderings follow N.M. Le et al., "Correct and Efficient
+//! Work-Stealing for Weak Memory Models", PPoPP 2013.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+//! Work-stealing deque:
+//! @c Push() and @c Pop() must only be called by the owner thread,
+//! @c Steal() can be called from any thread.
+//! Elements are stored into atomic slots and must therefore be trivially
+//! copyable, normally a pointer to a heap allocated task.
+template<typename T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable< T >::value,
+                  "WorkStealingDeque element type must be trivially copyable");
+public:
+    //! Create deque with initial capacity rounded to the next power of two.
+    explicit WorkStealingDeque(int64_t capacity = 256)
+        : top_(0), bottom_(0) {
+        int64_t c = 1;
+        while(c < capacity) c <<= 1;
+        arrays_.push_back(std::unique_ptr< Array >(new Array(c)));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+    //! Push element to the bottom of the deque; owner thread only.
+    //! The underlying buffer is doubled when full; previous buffers are
+    //! kept alive until the deque is destroyed since concurrent thieves
+    //! might still be reading from them.
+    void Push(T e) {
+        const int64_t b = bottom_.load(std::memory_order_relaxed);
+        const int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if(b - t > a->Capacity() - 1) {
+            arrays_.push_back(std::unique_ptr< Array >(a->Grow(b, t)));
+            a = arrays_.back().get();
+            array_.store(a, std::memory_order_release);
+        }
+        a->Put(b, e);
+        //release store instead of release fence + relaxed store: same
+        //guarantees, and understood by thread sanitizers
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+    //! Pop element from the bottom of the deque; owner thread only.
+    //! \return \c false if the deque is empty or the last element was
+    //! stolen concurrently
+    bool Pop(T& e) {
+        const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if(t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        e = a->Get(b);
+        if(t == b) {
+            //last element: race against thieves
+            const bool won =
+                top_.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+    //! Steal element from the top of the deque; callable from any thread.
+    //! \return \c false if the deque is empty or another thread won the race
+    bool Steal(T& e) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom_.load(std::memory_order_acquire);
+        if(t >= b) return false;
+        Array* a = array_.load(std::memory_order_acquire);
+        e = a->Get(t);
+        return top_.compare_exchange_strong(t, t + 1,
+                                            std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    }
+    //! Empty ? Approximate when invoked concurrently with other operations.
+    bool Empty() const {
+        const int64_t b = bottom_.load(std::memory_order_relaxed);
+        const int64_t t = top_.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+    //! Number of elements; approximate when invoked concurrently with
+    //! other operations.
+    size_t Size() const {
+        const int64_t b = bottom_.load(std::memory_order_relaxed);
+        const int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? size_t(b - t) : 0;
+    }
+private:
+    //! Circular buffer of atomic slots.
+    class Array {
+    public:
+        explicit Array(int64_t capacity)
+            : capacity_(capacity), mask_(capacity - 1),
+              slots_(new std::atomic< T >[capacity]) {}
+        int64_t Capacity() const { return capacity_; }
+        T Get(int64_t i) const {
+            return slots_[i & mask_].load(std::memory_order_relaxed);
+        }
+        void Put(int64_t i, T e) {
+            slots_[i & mask_].store(e, std::memory_order_relaxed);
+        }
+        //! Return new array with twice the capacity holding
+        //! elements in [t, b) interval.
+        Array* Grow(int64_t b, int64_t t) const {
+            Array* a = new Array(2 * capacity_);
+            for(int64_t i = t; i != b; ++i) a->Put(i, Get(i));
+            return a;
+        }
+    private:
+        int64_t capacity_;
+        int64_t mask_;
+        std::unique_ptr< std::atomic< T >[] > slots_;
+    };
+private:
+    std::atomic< int64_t > top_;
+    //keep thieves (top) and owner (bottom) on separate cache lines
+    char padding_[64 - sizeof(std::atomic< int64_t >)];
+    std::atomic< int64_t > bottom_;
+    std::atomic< Array* > array_;
+    //! Current and retired buffers, owned by the deque.
+    std::vector< std::unique_ptr< Array > > arrays_;
+};
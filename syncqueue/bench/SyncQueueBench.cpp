@@ -0,0 +1,359 @@
+//
+// Producer/consumer benchmark for synchronized queues.
+//
+// Measures throughput and enqueue to dequeue latency percentiles for
+// 1:1, N:1, 1:N and N:M topologies and item sizes from 8 bytes to 4 MB.
+// Items are move-only frame buffers leased from an ObjectPool so that
+// allocation costs do not hide queue costs; producers block when the
+// number of items in flight reaches the number of pooled buffers, so
+// memory use is bounded and no buffer is allocated during the run.
+// Only pointers to the buffers cross the queue, so throughput is reported
+// in items per second: item size affects cache traffic, not bytes copied.
+//
+// usage: syncqueue-bench [--topology 1:1|N:1|1:N|N:M|all] [--threads N]
+//                        [--items N] [--max-bytes N] [--sizes s1,s2,...]
+//                        [--impl name|all] [--pin] [--repeat N]
+//                        [--json file]
+// results are printed to stdout in JSON format unless --json is given.
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../SyncQueue.h"
+#include "../CoalescingQueue.h"
+#include "../ObjectPool.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+using Buffer = vector< char >;
+
+//Move-only frame: pooled buffer plus enqueue time.
+struct Frame {
+    ObjectPool< Buffer >::Lease buffer;
+    Clock::time_point time;
+    //empty frame signals end of stream to consumers
+    bool End() const { return !buffer; }
+};
+
+//Uniform interface over the queue implementations under test.
+struct QueueAdapter {
+    virtual ~QueueAdapter() {}
+    virtual void Push(Frame&& f) = 0;
+    virtual Frame Pop() = 0;
+};
+
+template< typename QueueT >
+struct SyncQueueAdapter : QueueAdapter {
+    void Push(Frame&& f) { q.Push(move(f)); }
+    Frame Pop() { return q.Pop(); }
+    QueueT q;
+};
+
+struct CoalescingQueueAdapter : QueueAdapter {
+    void Push(Frame&& f) { q.Push(0, move(f)); }
+    Frame Pop() { return q.Pop(); }
+    CoalescingQueue< Frame > q;
+};
+
+//Counting semaphore limiting the number of items in flight.
+class Slots {
+public:
+    explicit Slots(size_t n) : free_(n) {}
+    void Acquire() {
+        unique_lock< mutex > l(mutex_);
+        cond_.wait(l, [this]() { return free_ > 0; });
+        --free_;
+    }
+    void Release() {
+        {
+            lock_guard< mutex > l(mutex_);
+            ++free_;
+        }
+        cond_.notify_one();
+    }
+private:
+    size_t free_;
+    mutex mutex_;
+    condition_variable cond_;
+};
+
+struct Implementation {
+    string name;
+    function< QueueAdapter*() > create;
+};
+
+vector< Implementation > Implementations() {
+    return {
+        {"SyncQueue", []() -> QueueAdapter* {
+            return new SyncQueueAdapter<
+                SyncQueue< Frame, NoQueueInstrument > >;
+        }},
+        {"SyncQueue+QueueInstrument", []() -> QueueAdapter* {
+            return new SyncQueueAdapter<
+                SyncQueue< Frame, QueueInstrument > >;
+        }},
+        {"CoalescingQueue", []() -> QueueAdapter* {
+            return new CoalescingQueueAdapter;
+        }}
+    };
+}
+
+struct Config {
+    string impl;
+    string topology;
+    int producers;
+    int consumers;
+    size_t itemSize;
+    size_t items;
+    //maximum number of items in flight, i.e. of pooled buffers
+    size_t inFlight;
+    bool pin;
+};
+
+struct Result {
+    Config config;
+    double seconds;
+    double itemsPerSecond;
+    //latency percentiles in nanoseconds
+    double p50, p90, p99, p999, max;
+};
+
+//Pin current thread to a core, round-robin over available cores.
+void Pin(int index) {
+#ifdef __linux__
+    const int cores = max(1, int(thread::hardware_concurrency()));
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void) index;
+#endif
+}
+
+double Percentile(const vector< int64_t >& sorted, double p) {
+    if(sorted.empty()) return 0;
+    const size_t i = min(sorted.size() - 1, size_t(p * sorted.size()));
+    return double(sorted[i]);
+}
+
+Result Run(const Implementation& impl, const Config& cfg) {
+    unique_ptr< QueueAdapter > queue(impl.create());
+    //one buffer per item in flight, created before the run; no per-thread
+    //caches, buffers released by consumers are immediately available to
+    //producers
+    const size_t poolSize = cfg.inFlight;
+    ObjectPool< Buffer > pool(poolSize,
+                              [&cfg]() { return new Buffer(cfg.itemSize); },
+                              ObjectPool< Buffer >::Reset(), 0);
+    {
+        vector< ObjectPool< Buffer >::Lease > warm;
+        for(size_t i = 0; i != poolSize; ++i) warm.push_back(pool.Acquire());
+    }
+    Slots slots(poolSize);
+    atomic< int > ready(0);
+    atomic< bool > go(false);
+    const int numThreads = cfg.producers + cfg.consumers;
+    vector< vector< int64_t > > latencies(cfg.consumers);
+    vector< thread > threads;
+    for(int p = 0; p != cfg.producers; ++p) {
+        const size_t n = cfg.items / cfg.producers
+                         + (size_t(p) < cfg.items % cfg.producers ? 1 : 0);
+        threads.push_back(thread([&, p, n]() {
+            if(cfg.pin) Pin(p);
+            ++ready;
+            while(!go.load()) this_thread::yield();
+            for(size_t i = 0; i != n; ++i) {
+                //wait for a consumer when too many items are in flight
+                slots.Acquire();
+                Frame f;
+                f.buffer = pool.Acquire();
+                //touch first and last byte as a frame producer would
+                f.buffer->front() = char(i);
+                f.buffer->back() = char(i);
+                f.time = Clock::now();
+                queue->Push(move(f));
+            }
+        }));
+    }
+    for(int c = 0; c != cfg.consumers; ++c) {
+        latencies[c].reserve(cfg.items / cfg.consumers + 1);
+        threads.push_back(thread([&, c]() {
+            if(cfg.pin) Pin(cfg.producers + c);
+            ++ready;
+            while(!go.load()) this_thread::yield();
+            vector< int64_t >& lat = latencies[c];
+            while(true) {
+                Frame f = queue->Pop();
+                if(f.End()) break;
+                lat.push_back(chrono::duration_cast< chrono::nanoseconds >(
+                    Clock::now() - f.time).count());
+                //buffer back to the pool before a producer can take it
+                f.buffer.Release();
+                slots.Release();
+            }
+        }));
+    }
+    while(ready.load() != numThreads) this_thread::yield();
+    const Clock::time_point start = Clock::now();
+    go = true;
+    for(int p = 0; p != cfg.producers; ++p) threads[p].join();
+    //one end of stream marker per consumer, queued after all the items
+    for(int c = 0; c != cfg.consumers; ++c) queue->Push(Frame());
+    for(size_t t = cfg.producers; t != threads.size(); ++t) threads[t].join();
+    const double seconds =
+        chrono::duration< double >(Clock::now() - start).count();
+    vector< int64_t > all;
+    for(auto& l: latencies) all.insert(all.end(), l.begin(), l.end());
+    if(all.size() != cfg.items)
+        throw logic_error("Number of items received does not match");
+    if(pool.Created() != poolSize)
+        throw logic_error("Buffers allocated during the run");
+    sort(all.begin(), all.end());
+    Result r;
+    r.config = cfg;
+    r.seconds = seconds;
+    r.itemsPerSecond = cfg.items / seconds;
+    r.p50 = Percentile(all, 0.5);
+    r.p90 = Percentile(all, 0.9);
+    r.p99 = Percentile(all, 0.99);
+    r.p999 = Percentile(all, 0.999);
+    r.max = all.empty() ? 0 : double(all.back());
+    return r;
+}
+
+void WriteJSON(ostream& os, const vector< Result >& results) {
+    os << "[\n";
+    for(size_t i = 0; i != results.size(); ++i) {
+        const Result& r = results[i];
+        const Config& c = r.config;
+        os << "  {\"impl\": \"" << c.impl << "\", "
+           << "\"topology\": \"" << c.topology << "\", "
+           << "\"producers\": " << c.producers << ", "
+           << "\"consumers\": " << c.consumers << ", "
+           << "\"item_size\": " << c.itemSize << ", "
+           << "\"items\": " << c.items << ", "
+           << "\"in_flight\": " << c.inFlight << ", "
+           << "\"pinned\": " << (c.pin ? "true" : "false") << ", "
+           << "\"seconds\": " << r.seconds << ", "
+           << "\"items_per_second\": " << r.itemsPerSecond << ", "
+           << "\"latency_ns\": {\"p50\": " << r.p50
+           << ", \"p90\": " << r.p90
+           << ", \"p99\": " << r.p99
+           << ", \"p999\": " << r.p999
+           << ", \"max\": " << r.max << "}}"
+           << (i + 1 == results.size() ? "\n" : ",\n");
+    }
+    os << "]" << endl;
+}
+
+vector< size_t > ParseSizes(const string& s) {
+    vector< size_t > sizes;
+    istringstream is(s);
+    string t;
+    while(getline(is, t, ',')) sizes.push_back(stoul(t));
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    string topology = "all";
+    string implName = "all";
+    string jsonFile;
+    int threads = max(2, int(thread::hardware_concurrency()) / 2);
+    size_t items = 200000;
+    //cap on bytes moved per run, limits the number of large items
+    size_t maxBytes = size_t(256) << 20;
+    //cap on bytes in flight, limits the number of pooled large buffers
+    const size_t maxInFlightBytes = size_t(64) << 20;
+    vector< size_t > sizes = {8, 64, 512, 4096, 65536, 1 << 20, 4 << 20};
+    bool pin = false;
+    int repeat = 1;
+    try {
+        for(int i = 1; i < argc; ++i) {
+            const string a = argv[i];
+            auto next = [&]() -> string {
+                if(i + 1 >= argc)
+                    throw invalid_argument("Missing value for " + a);
+                return argv[++i];
+            };
+            if(a == "--topology") topology = next();
+            else if(a == "--impl") implName = next();
+            else if(a == "--threads") threads = stoi(next());
+            else if(a == "--items") items = stoul(next());
+            else if(a == "--max-bytes") maxBytes = stoul(next());
+            else if(a == "--sizes") sizes = ParseSizes(next());
+            else if(a == "--pin") pin = true;
+            else if(a == "--repeat") repeat = stoi(next());
+            else if(a == "--json") jsonFile = next();
+            else throw invalid_argument("Unknown option " + a);
+        }
+        if(threads < 2) throw invalid_argument("At least two threads needed");
+        //N and M: N producers and M consumers sharing the available threads
+        const int n = max(1, threads / 2);
+        const int m = max(1, threads - n);
+        struct Topology { string name; int producers; int consumers; };
+        const vector< Topology > topologies = {
+            {"1:1", 1, 1}, {"N:1", threads - 1, 1},
+            {"1:N", 1, threads - 1}, {"N:M", n, m}
+        };
+        vector< Result > results;
+        for(auto& impl: Implementations()) {
+            if(implName != "all" && implName != impl.name) continue;
+            for(auto& t: topologies) {
+                if(topology != "all" && topology != t.name) continue;
+                for(auto s: sizes) {
+                    Config cfg;
+                    cfg.impl = impl.name;
+                    cfg.topology = t.name;
+                    cfg.producers = t.producers;
+                    cfg.consumers = t.consumers;
+                    cfg.itemSize = max(s, size_t(1));
+                    cfg.items = max(size_t(1),
+                                    min(items, maxBytes / cfg.itemSize));
+                    //a few items per thread, at least one per thread
+                    const size_t threadCount =
+                        size_t(t.producers + t.consumers);
+                    cfg.inFlight = max(threadCount,
+                                       min(4 * threadCount,
+                                           maxInFlightBytes / cfg.itemSize));
+                    cfg.pin = pin;
+                    for(int r = 0; r != repeat; ++r) {
+                        results.push_back(Run(impl, cfg));
+                        cerr << impl.name << " " << t.name << " "
+                             << cfg.itemSize << "B: "
+                             << results.back().itemsPerSecond << " items/s"
+                             << endl;
+                    }
+                }
+            }
+        }
+        if(jsonFile.empty()) WriteJSON(cout, results);
+        else {
+            ofstream os(jsonFile);
+            if(!os) throw runtime_error("Cannot open " + jsonFile);
+            WriteJSON(os, results);
+        }
+    } catch(const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+//
+// CoalescingQueue test
+//
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <future>
+
+#include "../CoalescingQueue.h"
+
+using namespace std;
+
+enum class Event { DRAG, WHEEL, KEY };
+
+struct Input {
+    Event id;
+    int value;
+};
+
+int main(int, char**) {
+    using Q = CoalescingQueue< Input, Event >;
+    auto merge = [](Event k, Input& queued, Input&& incoming) {
+        switch(k) {
+        case Event::DRAG:
+            return Q::Replace(k, queued, move(incoming));
+        case Event::WHEEL:
+            queued.value += incoming.value;
+            return true;
+        default:
+            return false;
+        }
+    };
+    //drags replace each other, wheel deltas accumulate, keys never merged
+    //and never merged across
+    Q q(merge, [](Event k) { return k == Event::KEY; });
+    const Input in[] = {{Event::DRAG, 1}, {Event::DRAG, 2}, {Event::DRAG, 3},
+                        {Event::KEY, 10}, {Event::KEY, 11},
+                        {Event::WHEEL, 1}, {Event::WHEEL, -3},
+                        {Event::DRAG, 4}, {Event::WHEEL, 5}};
+    for(auto& e: in) q.Push(e.id, e);
+    assert(q.Size() == 5);
+    assert(q.Coalesced() == 4);
+    vector< Input > out;
+    assert(q.PopAll(out) == 5);
+    assert(q.Empty());
+    const Input expected[] = {{Event::DRAG, 3}, {Event::KEY, 10},
+                              {Event::KEY, 11}, {Event::WHEEL, 3},
+                              {Event::DRAG, 4}};
+    assert(out.size() == 5);
+    for(size_t i = 0; i != out.size(); ++i) {
+        assert(out[i].id == expected[i].id);
+        assert(out[i].value == expected[i].value);
+    }
+    //interleaved keys are merged into the last element with the same key
+    {
+        Q iq(merge);
+        const Input ii[] = {{Event::DRAG, 1}, {Event::WHEEL, 1},
+                            {Event::DRAG, 2}, {Event::WHEEL, 2},
+                            {Event::DRAG, 3}, {Event::WHEEL, 3}};
+        for(auto& e: ii) iq.Push(e.id, e);
+        assert(iq.Coalesced() == 4);
+        assert(iq.Pop().value == 3);
+        //popped element is not merged with, queued one still is
+        assert(!iq.Push(Event::DRAG, Input{Event::DRAG, 4}));
+        assert(iq.Push(Event::WHEEL, Input{Event::WHEEL, 4}));
+        const vector< Input > r = iq.PopAll();
+        assert(r.size() == 2);
+        assert(r[0].id == Event::WHEEL && r[0].value == 10);
+        assert(r[1].id == Event::DRAG && r[1].value == 4);
+    }
+    //element already popped is not merged with
+    q.Push(Event::DRAG, Input{Event::DRAG, 1});
+    assert(q.Pop().value == 1);
+    q.Push(Event::DRAG, Input{Event::DRAG, 2});
+    assert(q.PopAll().size() == 1);
+    //producer/consumer: sum of wheel deltas preserved
+    {
+        CoalescingQueue< int > w([](int, int& a, int&& b) {
+            a += b;
+            return true;
+        });
+        const int N = 100000;
+        auto producer = async(launch::async, [&w, N]() {
+            for(int i = 0; i != N; ++i) w.Push(0, 1);
+            w.Stop();
+        });
+        long sum = 0;
+        vector< int > batch;
+        while(true) {
+            const bool done = w.Done();
+            batch.clear();
+            w.PopAll(batch);
+            for(auto v: batch) sum += v;
+            if(done && batch.empty()) break;
+        }
+        producer.get();
+        assert(sum == N);
+    }
+    //Stop unblocks consumer
+    {
+        CoalescingQueue< int > s;
+        auto consumer = async(launch::async, [&s]() { return s.Pop(); });
+        s.Stop();
+        assert(consumer.get() == 0);
+    }
+    cout << "PASSED" << endl;
+    return EXIT_SUCCESS;
+}
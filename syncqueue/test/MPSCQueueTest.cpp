@@ -0,0 +1,74 @@
+//
+// MPSCQueue test
+//
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <future>
+
+#include "../MPSCQueue.h"
+
+using namespace std;
+
+int main(int, char**) {
+    //single thread: FIFO order
+    {
+        MPSCQueue< int > q;
+        assert(q.Empty());
+        int e = -1;
+        assert(!q.Pop(e));
+        for(int i = 0; i != 10; ++i) q.Push(i);
+        assert(!q.Empty());
+        for(int i = 0; i != 10; ++i) {
+            assert(q.Pop(e));
+            assert(e == i);
+        }
+        assert(q.Empty());
+        assert(!q.Pop(e));
+    }
+    //elements left in the queue are destroyed with it
+    {
+        shared_ptr< int > p = make_shared< int >(1);
+        {
+            MPSCQueue< shared_ptr< int > > q;
+            q.Push(p);
+            q.Push(p);
+            assert(p.use_count() == 3);
+            shared_ptr< int > e;
+            assert(q.Pop(e));
+            e.reset();
+            //popped node keeps a moved-from element only
+            assert(p.use_count() == 2);
+        }
+        assert(p.use_count() == 1);
+    }
+    //multiple producers: per-producer order preserved, nothing lost
+    {
+        const int P = 4;
+        const int N = 100000;
+        MPSCQueue< pair< int, int > > q;
+        vector< future< void > > producers;
+        for(int p = 0; p != P; ++p)
+            producers.push_back(async(launch::async, [&q, p, N]() {
+                for(int i = 0; i != N; ++i) q.Push(make_pair(p, i));
+            }));
+        vector< int > next(P, 0);
+        pair< int, int > e;
+        for(int received = 0; received != P * N;) {
+            if(!q.Pop(e)) {
+                this_thread::yield();
+                continue;
+            }
+            assert(e.second == next[e.first]);
+            ++next[e.first];
+            ++received;
+        }
+        for(auto& f: producers) f.get();
+        assert(q.Empty());
+    }
+    cout << "PASSED" << endl;
+    return EXIT_SUCCESS;
+}
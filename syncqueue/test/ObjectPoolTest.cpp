@@ -0,0 +1,114 @@
+//
+// ObjectPool test
+//
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <future>
+#include <atomic>
+
+#include "../ObjectPool.h"
+#include "../SyncQueue.h"
+
+using namespace std;
+
+using Buffer = vector< char >;
+
+int main(int, char**) {
+    //lease and return
+    {
+        ObjectPool< Buffer > pool(4, []() { return new Buffer(16); },
+                                  [](Buffer& b) { b.assign(b.size(), 0); });
+        Buffer* first = nullptr;
+        {
+            ObjectPool< Buffer >::Lease l = pool.Acquire();
+            assert(l);
+            assert(l->size() == 16);
+            (*l)[0] = 'x';
+            first = l.Get();
+            assert(pool.Created() == 1);
+            assert(pool.Idle() == 0);
+        }
+        assert(pool.Idle() == 1);
+        //same object returned, reset function applied
+        ObjectPool< Buffer >::Lease l = pool.Acquire();
+        assert(l.Get() == first);
+        assert((*l)[0] == 0);
+        assert(pool.Created() == 1);
+        //move only
+        ObjectPool< Buffer >::Lease m(move(l));
+        assert(!l);
+        assert(m.Get() == first);
+        m.Release();
+        assert(!m);
+        assert(pool.Idle() == 1);
+    }
+    //capacity: excess objects destroyed
+    {
+        ObjectPool< Buffer > pool(2);
+        {
+            vector< ObjectPool< Buffer >::Lease > leases;
+            for(int i = 0; i != 5; ++i) leases.push_back(pool.Acquire());
+            assert(pool.Created() == 5);
+        }
+        assert(pool.Idle() == 2);
+        pool.Trim(1);
+        assert(pool.Idle() == 1);
+        pool.SetCapacity(0);
+        assert(pool.Idle() == 0);
+        pool.SetCapacity(8);
+        pool.Put(Buffer(3));
+        assert(pool.Idle() == 1);
+        assert(pool.Acquire()->size() == 3);
+    }
+    //shared_ptr lease, pool destroyed before object is returned
+    {
+        shared_ptr< Buffer > p;
+        {
+            ObjectPool< Buffer > pool;
+            p = pool.AcquireShared();
+            p->resize(10);
+        }
+        assert(p->size() == 10);
+    }
+    //objects leased in one thread and returned in others; no object
+    //handed out twice
+    {
+        ObjectPool< Buffer > pool(64, []() { return new Buffer(1, 0); });
+        SyncQueue< Buffer* > handoff;
+        atomic< int > inUse(0);
+        const int N = 10000;
+        auto consumer = async(launch::async, [&handoff, &pool, &inUse, N]() {
+            for(int i = 0; i != N; ++i) {
+                Buffer* b = handoff.Pop();
+                assert((*b)[0] == 1);
+                (*b)[0] = 0;
+                --inUse;
+                pool.Put(move(*b));
+                delete b;
+            }
+        });
+        vector< future< void > > producers;
+        for(int t = 0; t != 4; ++t) {
+            producers.push_back(async(launch::async, [&pool, &handoff, &inUse,
+                                                      N]() {
+                for(int i = 0; i != N / 4; ++i) {
+                    ObjectPool< Buffer >::Lease l = pool.Acquire();
+                    assert((*l)[0] == 0);
+                    (*l)[0] = 1;
+                    ++inUse;
+                    handoff.Push(new Buffer(move(*l)));
+                    l->assign(1, 0);
+                }
+            }));
+        }
+        for(auto& p: producers) p.get();
+        consumer.get();
+        assert(inUse == 0);
+        assert(pool.Idle() <= pool.Capacity());
+    }
+    cout << "PASSED" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+//
+// SyncQueue and SyncValue instrumentation test
+//
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <future>
+#include <chrono>
+
+#include "../SyncQueue.h"
+#include "../SyncValue.h"
+
+using namespace std;
+
+int main(int, char**) {
+    //disabled: only depth reported
+    SyncQueue< int > plain;
+    plain.Push(1);
+    assert(!plain.Stats().enabled);
+    assert(plain.Stats().depth == 1);
+    //enabled
+    SyncQueue< string, QueueInstrument > sq;
+    sq.Push(string("1"));
+    sq.Push(string("2"));
+    const string s3 = "3";
+    sq.PushFront(s3);
+    QueueStats s = sq.Stats();
+    assert(s.enabled);
+    assert(s.depth == 3);
+    assert(s.highWaterDepth == 3);
+    assert(s.pushed == 3);
+    assert(s.popped == 0);
+    assert(sq.Pop() == "3");
+    assert(sq.Pop() == "1");
+    const string b[] = {"4", "5"};
+    sq.Buffer(begin(b), end(b));
+    assert(sq.Pop() == "2");
+    assert(sq.Pop() == "4");
+    assert(sq.Pop() == "5");
+    s = sq.Stats();
+    assert(s.depth == 0);
+    assert(s.highWaterDepth == 3);
+    assert(s.pushed == 5);
+    assert(s.popped == 5);
+    uint64_t total = 0;
+    for(auto c: s.latencyHistogram) total += c;
+    assert(total == 5);
+    assert(s.maxLatency >= s.AverageLatency());
+    //blocked consumer
+    auto consumer = async(launch::async, [&sq]() { return sq.Pop(); });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    sq.Push(string("6"));
+    assert(consumer.get() == "6");
+    s = sq.Stats();
+    assert(s.blockedPops == 1);
+    assert(s.blockedTime >= chrono::milliseconds(10));
+    assert(s.LatencyPercentile(1.0) >= chrono::microseconds(1));
+    sq.ResetStats();
+    assert(sq.Stats().pushed == 0);
+    //SyncValue
+    SyncValue< string, QueueInstrument > v;
+    v.Put(string("HELLO"));
+    assert(v.Stats().depth == 1);
+    assert(v.Get() == "HELLO");
+    s = v.Stats();
+    assert(s.pushed == 1 && s.popped == 1 && s.depth == 0);
+
+    cout << "PASSED" << endl;
+    return EXIT_SUCCESS;
+}
@@ -45,11 +45,9 @@ int main(int, char**) {
         sq.Pop();
     });
     sq.Stop();
-    //wait until Pop has been called (removed condition variable: too messy)
-    this_thread::sleep_for(chrono::seconds(2));
-    //check that thread has ended
+    //check that thread ends: returns as soon as Pop has been unblocked
     const std::future_status fs =
-        task.wait_for(chrono::seconds(0));
+        task.wait_for(chrono::seconds(10));
     assert(fs == std::future_status::ready);
     //ok
     cout << "PASSED" << endl;
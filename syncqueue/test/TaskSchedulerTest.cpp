@@ -0,0 +1,130 @@
+//
+// Work-stealing deque and task scheduler test
+//
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+
+#include "../WorkStealingDeque.h"
+#include "../TaskScheduler.h"
+
+using namespace std;
+
+int main(int, char**) {
+    //deque: owner pops in LIFO order
+    WorkStealingDeque< int* > wsd(2);
+    vector< int > data(100);
+    iota(data.begin(), data.end(), 0);
+    for(auto& i: data) wsd.Push(&i); //grow from initial capacity
+    assert(wsd.Size() == data.size());
+    int* e = nullptr;
+    assert(wsd.Pop(e) && *e == 99);
+    //thieves steal in FIFO order
+    assert(wsd.Steal(e) && *e == 0);
+    //concurrent steal: every element consumed exactly once
+    {
+        WorkStealingDeque< int* > d;
+        const int N = 100000;
+        vector< int > values(N, 0);
+        atomic< int > consumed(0);
+        vector< future< void > > thieves;
+        for(int t = 0; t != 3; ++t) {
+            thieves.push_back(async(launch::async, [&d, &consumed, N]() {
+                int* p = nullptr;
+                while(consumed.load() < N) {
+                    if(d.Steal(p)) {
+                        ++*p;
+                        ++consumed;
+                    }
+                }
+            }));
+        }
+        for(int i = 0; i != N; ++i) {
+            d.Push(&values[i]);
+            int* p = nullptr;
+            if(i % 3 == 0 && d.Pop(p)) {
+                ++*p;
+                ++consumed;
+            }
+        }
+        int* p = nullptr;
+        while(consumed.load() < N) {
+            if(d.Pop(p)) {
+                ++*p;
+                ++consumed;
+            }
+        }
+        for(auto& t: thieves) t.get();
+        for(auto v: values) assert(v == 1);
+    }
+    TaskScheduler ts(4);
+    assert(ts.NumWorkers() == 4);
+    assert(!ts.InWorker());
+    //tasks run in the workers
+    assert(ts.Submit([&ts]() { return ts.InWorker(); }).get());
+    //futures
+    {
+        vector< future< int > > results;
+        for(int i = 0; i != 1000; ++i)
+            results.push_back(ts.Submit([i]() { return i * 2; }));
+        for(int i = 0; i != 1000; ++i) assert(results[i].get() == i * 2);
+        auto f = ts.Submit([]() -> int { throw runtime_error("task"); });
+        bool thrown = false;
+        try {
+            f.get();
+        } catch(const runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    //parallel for: every element visited exactly once
+    {
+        vector< int > v(100003, 0);
+        ts.ParallelFor(size_t(0), v.size(), size_t(1000),
+                       [&v](size_t i) { v[i] += 1; });
+        for(auto i: v) assert(i == 1);
+    }
+    //nested parallel for and futures waited on from inside tasks
+    {
+        vector< atomic< int > > counts(64);
+        for(auto& c: counts) c = 0;
+        const thread::id caller = this_thread::get_id();
+        ts.ParallelFor(0, 64, 1, [&ts, &counts, caller](int i) {
+            //chunks run in the workers and in the calling thread
+            assert(ts.InWorker() == (this_thread::get_id() != caller));
+            ts.ParallelFor(0, 100, 10, [&counts, i](int) { ++counts[i]; });
+            auto f = ts.Submit([]() { return 1; });
+            counts[i] += ts.Get(f);
+        });
+        for(auto& c: counts) assert(c == 101);
+    }
+    //parallel for: exception propagated to caller
+    {
+        bool thrown = false;
+        try {
+            ts.ParallelFor(0, 1000, 1, [](int i) {
+                if(i == 500) throw logic_error("for");
+            });
+        } catch(const logic_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    //pending tasks are executed before the scheduler is destroyed
+    {
+        atomic< int > count(0);
+        {
+            TaskScheduler s(2);
+            for(int i = 0; i != 1000; ++i) s.Submit([&count]() { ++count; });
+        }
+        assert(count == 1000);
+    }
+    cout << "PASSED" << endl;
+    return EXIT_SUCCESS;
+}
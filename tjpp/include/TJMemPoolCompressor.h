@@ -22,31 +22,34 @@
 #include <stdexcept>
 #include <turbojpeg.h>
 
-#include "SyncQueue.h"
+#include "ObjectPool.h"
 #include "JPEGImage.h"
 #include "timing.h"
 
 namespace tjpp {
+//! JPEG compressor recycling output buffers: compressed images are leased
+//! from an \c ObjectPool and returned to the pool when the wrapper returned
+//! by @c Compress() is destroyed or flushed.
 class TJMemPoolCompressor {
+    using Pool = ObjectPool< JPEGImage >;
 public:
     class JPEGImageWrapper {
     public:
-        JPEGImageWrapper(JPEGImage img,
-                         std::shared_ptr< SyncQueue< JPEGImage > > sq)
-            : img_(img), queue_(sq) {}
-        const JPEGImage& Image() const { return img_; }
+        JPEGImageWrapper(Pool::Lease img) : img_(std::move(img)) {}
+        const JPEGImage& Image() const { return *img_; }
         operator const JPEGImage&() { return Image(); }
+        //! Return image to pool, @c Image() is invalid afterwards.
         void Flush() {
-            queue_->Push(std::move(img_));
-        }
-        ~JPEGImageWrapper() {
-            Flush();
+            img_.Release();
         }
     private:
-        JPEGImage img_;
-        std::shared_ptr< SyncQueue< JPEGImage > > queue_;
+        Pool::Lease img_;
     };
 public:
+    //! Constructor.
+    //! \param numBuffers number of pre-allocated buffers, also the maximum
+    //! number of idle buffers kept in the pool; if zero buffers are allocated
+    //! on demand and at most \c DEFAULT_POOL_CAPACITY idle buffers are kept
     TJMemPoolCompressor(int numBuffers = 0,
                         size_t w = 0,
                         size_t h = 0,
@@ -54,10 +57,13 @@ public:
                         TJSAMP ss = TJSAMP_420,
                         int q = 75,
                         int flags = TJFLAG_FASTDCT) :
-        memoryPool_(new SyncQueue< JPEGImage >()),
+        memoryPool_(numBuffers > 0 ? size_t(numBuffers)
+                                   : DEFAULT_POOL_CAPACITY),
         tjCompressor_(tjInitCompress()) {
         for(int i = 0; i != numBuffers; ++i) {
-            memoryPool_->Push(JPEGImage(w, h, pf, ss, q));
+            JPEGImage img;
+            img.Reset(w, h, pf, ss, q);
+            memoryPool_.Put(std::move(img));
         }
     }
     JPEGImageWrapper Compress(const unsigned char* img,
@@ -70,10 +76,9 @@ public:
                               int flags = TJFLAG_FASTDCT,
                               int pitch = 0) {
 
-        JPEGImage i;/*(memoryPool_->Pop(
-            JPEGImage(width, height, pf, ss, quality)));*/
-
-        if(i.Empty()
+        Pool::Lease lease = memoryPool_.Acquire();
+        JPEGImage& i = *lease;
+        if(!i.DataPtr()
             || tjBufSize(width, height, ss) > i.BufferSize()) {
             i.Reset(width, height, pf, ss, quality);
         }
@@ -94,19 +99,20 @@ public:
                   << std::endl;
 #endif
         i.SetCompressedSize(jpegSize);
-        return JPEGImageWrapper(i, memoryPool_);
+        return JPEGImageWrapper(std::move(lease));
     }
     void PutBack(JPEGImage&& im) {
-        memoryPool_->Push(std::move(im));
+        memoryPool_.Put(std::move(im));
     }
     void PutBack(JPEGImage& im) {
-        memoryPool_->Push(std::move(im));
+        memoryPool_.Put(std::move(im));
     }
     ~TJMemPoolCompressor() {
         tjDestroy(tjCompressor_);
     }
 private:
-    std::shared_ptr< SyncQueue< JPEGImage > > memoryPool_;
+    static const size_t DEFAULT_POOL_CAPACITY = 16;
+    Pool memoryPool_;
     tjhandle tjCompressor_;
 };
 }
\ No newline at end of file
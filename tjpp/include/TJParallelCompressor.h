@@ -23,6 +23,7 @@
 #include <future>
 #include <turbojpeg.h>
 
+#include "TaskScheduler.h"
 #include "JPEGImage.h"
 #include "timing.h"
 
@@ -30,8 +31,13 @@ namespace tjpp {
 template < typename C >
 class TJParallelCompressor {
 public:
-    TJParallelCompressor(int numCompressors)
-        : compressors_(numCompressors), images_(numCompressors) {}
+    //if a scheduler is passed, stacks are compressed by the scheduler's
+    //workers instead of threads spawned at each call; use this option to
+    //share the same pool of threads with the other stages of the pipeline
+    TJParallelCompressor(int numCompressors,
+                         TaskScheduler* scheduler = nullptr)
+        : compressors_(numCompressors), images_(numCompressors),
+          scheduler_(scheduler) {}
     //UV note: current implementation spawns threads at each call, however after
     //testing with other solutions like creating threads and wait on a condition
     //variable in a loop, there does not seem to be any real gain in doing so.
@@ -64,9 +70,18 @@ public:
             *out = compressor->Compress(img, width, height, pf, ss,
                                         quality, offset, flags, pitch);
         };
-        std::vector< std::future< void > > tasks_;
         const int h = height / stacks;
         const int nc = NumComponents(pf);
+        if(scheduler_) {
+            scheduler_->ParallelFor(0, stacks, 1, [&](int s) {
+                const int off = s * h * width * nc;
+                const int sh = s == stacks - 1 ? height - (stacks - 1) * h : h;
+                compress(&compressors_[s], img, width, sh, pf, ss, quality,
+                         off, flags, pitch, &images_[s]);
+            });
+            return images_;
+        }
+        std::vector< std::future< void > > tasks_;
         for(int s = 0; s != stacks - 1; ++s) {
             const int off = s * h * width * nc;
             tasks_.push_back(std::async(std::launch::async, compress,
@@ -109,5 +124,6 @@ public:
 private:
     std::vector< C > compressors_;
     std::vector< JPEGImage > images_;
+    TaskScheduler* scheduler_;
 };
 }
\ No newline at end of file
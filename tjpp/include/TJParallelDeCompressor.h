@@ -18,6 +18,7 @@
 #include <stdexcept>
 #include <turbojpeg.h>
 
+#include "TaskScheduler.h"
 #include "Image.h"
 #include "JPEGImage.h"
 #include "timing.h"
@@ -27,8 +28,11 @@ namespace tjpp {
 
 class TJParallelDeCompressor {
 public:
-    TJParallelDeCompressor(int numStacks, size_t preAllocatedSize = 0) :
-        handles_(numStacks), tasks_(numStacks) {
+    //if a scheduler is passed, stacks are decompressed by the scheduler's
+    //workers instead of threads spawned at each call
+    TJParallelDeCompressor(int numStacks, size_t preAllocatedSize = 0,
+                           TaskScheduler* scheduler = nullptr) :
+        handles_(numStacks), tasks_(numStacks), scheduler_(scheduler) {
         if(preAllocatedSize > 0) {
             img_.Allocate(preAllocatedSize);
         }
@@ -69,6 +73,22 @@ public:
                 throw std::runtime_error(tjGetErrorStr());
         };
 
+        if(scheduler_) {
+            scheduler_->ParallelFor(0, int(jpgImgs.size()), 1, [&](int i) {
+                const int offset =
+                    NumComponents(TJPF(pixelFormat)) * i
+                        * globalWidth * jpgImgs[i].Height();
+                decompress(handles_[i],
+                           jpgImgs[i].DataPtr(),
+                           jpgImgs[i].CompressedSize(),
+                           img_.DataPtr() + offset,
+                           int(globalWidth),
+                           int(jpgImgs[i].Height()),
+                           TJPF(pixelFormat),
+                           flags);
+            });
+            return std::move(img_);
+        }
         for(int i = 0; i != jpgImgs.size(); ++i) {
             const int offset =
                 NumComponents(TJPF(pixelFormat)) * i
@@ -102,5 +122,6 @@ private:
     Image img_;
     std::vector< tjhandle > handles_;
     std::vector< std::future< void > > tasks_;
+    TaskScheduler* scheduler_;
 };
 }
\ No newline at end of file
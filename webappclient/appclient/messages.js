@@ -0,0 +1,14 @@
+// Generated by srz::JSDecoderGenerator, do not edit.
+// Decode with new SrzReader(data, {sizeBytes: 4, aligned: false}), see srz.js.
+
+function decodeViewportResize(r) {
+  const o = r.offset;
+  r.skip(8);
+  return {
+    width: r.view.getInt32(o, true),
+    height: r.view.getInt32(o + 4, true)
+  };
+}
+
+if(typeof module !== 'undefined')
+  module.exports = {decodeViewportResize};
@@ -0,0 +1,382 @@
+/** Decoder for messages serialized by the srz C++ library in portable wire
+    format (SRZ_WIRE_LE, optionally SRZ_WIRE_ALIGNED): little-endian numbers,
+    length prefixed strings and arrays; with alignment enabled array payloads
+    are preceded by a pad count byte and padding, and are mapped as typed
+    arrays without copying when aligned. */
+
+const SRZ_TYPES = {
+  int8: {size: 1, get: 'getInt8', array: Int8Array},
+  uint8: {size: 1, get: 'getUint8', array: Uint8Array},
+  int16: {size: 2, get: 'getInt16', array: Int16Array},
+  uint16: {size: 2, get: 'getUint16', array: Uint16Array},
+  int32: {size: 4, get: 'getInt32', array: Int32Array},
+  uint32: {size: 4, get: 'getUint32', array: Uint32Array},
+  float32: {size: 4, get: 'getFloat32', array: Float32Array},
+  float64: {size: 8, get: 'getFloat64', array: Float64Array},
+  int64: {size: 8, get: 'getBigInt64',
+          array: typeof BigInt64Array !== 'undefined' ? BigInt64Array : null},
+  uint64: {size: 8, get: 'getBigUint64',
+           array: typeof BigUint64Array !== 'undefined' ? BigUint64Array : null}
+};
+
+const SRZ_ENCODINGS = {
+  varint: {delta: false, zigzag: false, packed: false},
+  zigzag: {delta: false, zigzag: true, packed: false},
+  delta: {delta: true, zigzag: true, packed: false},
+  bitpacked: {delta: false, zigzag: false, packed: true},
+  deltabitpacked: {delta: true, zigzag: true, packed: true}
+};
+
+/** unpack block of 128 values of b bits: value i in lane i % 4 at bit
+    offset (i / 4) * b, word k of lane l is word 4 * k + l */
+function srzUnpackBlock(view, offset, b, out) {
+  const mask = b === 32 ? 0xffffffff : (1 << b) - 1;
+  for(let lane = 0; lane !== 4; ++lane) {
+    for(let r = 0; r !== 32; ++r) {
+      const bit = r * b;
+      const k = bit >>> 5;
+      const off = bit & 31;
+      let v = b ? view.getUint32(offset + 4 * (4 * k + lane), true) >>> off : 0;
+      if(off + b > 32)
+        v |= view.getUint32(offset + 4 * (4 * (k + 1) + lane), true)
+             << (32 - off);
+      out[4 * r + lane] = (v & mask) >>> 0;
+    }
+  }
+}
+
+/** decompress LZ4 block format data src into n bytes */
+function srzLZDecompress(src, n) {
+  const out = new Uint8Array(n);
+  let ip = 0;
+  let op = 0;
+  const length = (len) => {
+    for(;;) {
+      if(ip >= src.length) throw new RangeError('srz: truncated LZ data');
+      const b = src[ip++];
+      len += b;
+      if(b !== 255) return len;
+    }
+  };
+  for(;;) {
+    if(ip >= src.length) throw new RangeError('srz: truncated LZ data');
+    const token = src[ip++];
+    let lit = token >>> 4;
+    if(lit === 15) lit = length(lit);
+    if(lit > src.length - ip || lit > n - op)
+      throw new RangeError('srz: invalid LZ literals');
+    out.set(src.subarray(ip, ip + lit), op);
+    ip += lit;
+    op += lit;
+    if(ip === src.length) break;
+    if(src.length - ip < 2) throw new RangeError('srz: truncated LZ data');
+    const offset = src[ip] | (src[ip + 1] << 8);
+    ip += 2;
+    let ml = (token & 15) + 4;
+    if((token & 15) === 15) ml = length(ml);
+    if(!offset || offset > op || ml > n - op)
+      throw new RangeError('srz: invalid LZ match');
+    for(let i = 0; i !== ml; ++i, ++op) out[op] = out[op - offset];
+  }
+  if(op !== n) throw new RangeError('srz: LZ size mismatch');
+  return out;
+}
+
+/** undo bit shuffle of the first n - n % 8 bytes of byte plane p (n bytes):
+    bit j of byte i is stored in bit i % 8 of byte j * m / 8 + i / 8 */
+function srzBitUnshufflePlane(p, n) {
+  const m = n & ~7;
+  const stride = m >>> 3;
+  const planes = p.slice(0, m);
+  p.fill(0, 0, m);
+  for(let j = 0; j !== 8; ++j) {
+    for(let k = 0; k !== stride; ++k) {
+      const bits = planes[j * stride + k];
+      if(!bits) continue;
+      for(let b = 0; b !== 8; ++b)
+        if(bits & (1 << b)) p[8 * k + b] |= 1 << j;
+    }
+  }
+}
+
+/** undo byte shuffle of n elements of w bytes: byte b of element i is
+    stored at b * n + i */
+function srzByteUnshuffle(src, n, w, out) {
+  for(let b = 0; b !== w; ++b)
+    for(let i = 0; i !== n; ++i) out[i * w + b] = src[b * n + i];
+}
+
+/** lookup table of the float values of all the halves, built on first use */
+let srzHalfTable = null;
+
+function srzHalfToFloat(h) {
+  const e = (h >>> 10) & 0x1f;
+  const m = h & 0x3ff;
+  const s = h & 0x8000 ? -1 : 1;
+  if(e === 0) return s * m * Math.pow(2, -24);
+  if(e === 31) return m ? NaN : s * Infinity;
+  return s * (1024 + m) * Math.pow(2, e - 25);
+}
+
+function srzHalfs() {
+  if(!srzHalfTable) {
+    srzHalfTable = new Float32Array(0x10000);
+    for(let h = 0; h !== 0x10000; ++h) srzHalfTable[h] = srzHalfToFloat(h);
+  }
+  return srzHalfTable;
+}
+
+const SRZ_HOST_LITTLE_ENDIAN =
+  new Uint8Array(new Uint16Array([1]).buffer)[0] === 1;
+
+class SrzReader {
+  /** data: ArrayBuffer or typed array view;
+      options.sizeBytes: 4 (ZRF_int32_size) or 8, default 4;
+      options.aligned: true if SRZ_WIRE_ALIGNED, default false */
+  constructor(data, options = {}) {
+    if(data instanceof ArrayBuffer) {
+      this.buffer = data;
+      this.base = 0;
+      this.byteLength = data.byteLength;
+    } else {
+      this.buffer = data.buffer;
+      this.base = data.byteOffset;
+      this.byteLength = data.byteLength;
+    }
+    this.view = new DataView(this.buffer, this.base, this.byteLength);
+    this.offset = 0;
+    this.sizeBytes = options.sizeBytes || 4;
+    this.aligned = !!options.aligned;
+  }
+
+  remaining() { return this.byteLength - this.offset; }
+
+  skip(n) {
+    this.require(n);
+    this.offset += n;
+  }
+
+  require(n) {
+    if(n > this.remaining())
+      throw new RangeError(`srz: reading ${n} bytes past end of message`);
+  }
+
+  /** read scalar of type name, e.g. 'int32', 'float64' */
+  scalar(type) {
+    const t = SRZ_TYPES[type];
+    this.require(t.size);
+    const v = this.view[t.get](this.offset, true);
+    this.offset += t.size;
+    return v;
+  }
+
+  int8() { return this.scalar('int8'); }
+  uint8() { return this.scalar('uint8'); }
+  int16() { return this.scalar('int16'); }
+  uint16() { return this.scalar('uint16'); }
+  int32() { return this.scalar('int32'); }
+  uint32() { return this.scalar('uint32'); }
+  float32() { return this.scalar('float32'); }
+  float64() { return this.scalar('float64'); }
+  int64() { return this.scalar('int64'); }
+  uint64() { return this.scalar('uint64'); }
+
+  /** read length prefix; 64 bit sizes must fit into a double */
+  size() {
+    if(this.sizeBytes === 4) return this.int32();
+    const lo = this.uint32();
+    const hi = this.uint32();
+    if(hi >= 0x200000) throw new RangeError('srz: size too large');
+    return hi * 0x100000000 + lo;
+  }
+
+  /** read std::string as Uint8Array view of the characters */
+  bytes() {
+    const n = this.size();
+    this.require(n);
+    const b = new Uint8Array(this.buffer, this.base + this.offset, n);
+    this.offset += n;
+    return b;
+  }
+
+  /** read std::string, decoded as UTF-8 */
+  string() {
+    const b = this.bytes();
+    if(typeof TextDecoder !== 'undefined') return new TextDecoder().decode(b);
+    return b.reduce((s, ch) => s + String.fromCharCode(ch), '');
+  }
+
+  /** read std::vector of POD numbers as typed array; aligned payloads are
+      mapped in place, misaligned ones copied */
+  array(type) {
+    const t = SRZ_TYPES[type];
+    const n = this.size();
+    if(this.aligned) this.skip(this.uint8());
+    const bytes = n * t.size;
+    this.require(bytes);
+    const start = this.base + this.offset;
+    this.offset += bytes;
+    if(SRZ_HOST_LITTLE_ENDIAN && start % t.size === 0)
+      return new t.array(this.buffer, start, n);
+    if(SRZ_HOST_LITTLE_ENDIAN)
+      return new t.array(this.buffer.slice(start, start + bytes));
+    const a = new t.array(n);
+    const v = new DataView(this.buffer, start, bytes);
+    for(let i = 0; i !== n; ++i) a[i] = v[t.get](i * t.size, true);
+    return a;
+  }
+
+  /** read integer array serialized with srz::AsVarint, AsZigZag, AsDelta,
+      AsBitPacked or AsDeltaBitPacked; type is the element type, up to
+      32 bits */
+  encoded(type, encoding) {
+    const t = SRZ_TYPES[type];
+    const e = SRZ_ENCODINGS[encoding];
+    const n = this.size();
+    const bytes = this.size();
+    this.require(bytes);
+    const end = this.offset + bytes;
+    const signed = type[0] === 'i';
+    const zig = e.zigzag || signed;
+    const out = new t.array(n);
+    let prev = 0;
+    let i = 0;
+    const put = (z) => {
+      let d = zig ? (z >>> 1) ^ -(z & 1) : z;
+      if(e.delta) d = (prev + d) | 0;
+      prev = d;
+      out[i++] = d;
+    };
+    if(e.packed) {
+      const block = new Uint32Array(128);
+      while(i + 128 <= n) {
+        const b = this.uint8();
+        if(b > 32 || this.offset + 16 * b > end)
+          throw new RangeError('srz: invalid block');
+        srzUnpackBlock(this.view, this.offset, b, block);
+        this.offset += 16 * b;
+        for(let j = 0; j !== 128; ++j) put(block[j]);
+      }
+    }
+    while(i !== n) {
+      let v = 0;
+      let shift = 0;
+      for(;;) {
+        if(this.offset >= end) throw new RangeError('srz: truncated varint');
+        const b = this.view.getUint8(this.offset++);
+        v += (b & 0x7f) * Math.pow(2, shift);
+        shift += 7;
+        if(!(b & 0x80)) break;
+      }
+      put(v >>> 0);
+    }
+    if(this.offset !== end) throw new RangeError('srz: encoded size mismatch');
+    return out;
+  }
+
+  /** read array serialized with srz::AsCompressed as typed array of type */
+  compressed(type) {
+    const t = SRZ_TYPES[type];
+    const n = this.size();
+    const bytes = this.size();
+    this.require(bytes);
+    const end = this.offset + bytes;
+    const w = this.uint8();
+    if(w !== t.size) throw new RangeError('srz: element size mismatch');
+    const shuffle = this.uint8();
+    if(shuffle > 2) throw new RangeError('srz: unknown shuffle');
+    const be = this.uint32();
+    if(!be && n) throw new RangeError('srz: invalid block size');
+    const out = new Uint8Array(n * w);
+    for(let i = 0; i < n; i += be) {
+      const count = Math.min(be, n - i);
+      const header = this.uint32();
+      const size = header & 0x7fffffff;
+      if(size > end - this.offset) throw new RangeError('srz: truncated block');
+      const src = new Uint8Array(this.buffer, this.base + this.offset, size);
+      this.offset += size;
+      let data;
+      if(header & 0x80000000) {
+        if(size !== count * w) throw new RangeError('srz: invalid block size');
+        data = src.slice();
+      } else data = srzLZDecompress(src, count * w);
+      if(shuffle === 2)
+        for(let b = 0; b !== w; ++b)
+          srzBitUnshufflePlane(data.subarray(b * count, (b + 1) * count),
+                               count);
+      const dst = out.subarray(i * w, (i + count) * w);
+      if(shuffle) srzByteUnshuffle(data, count, w, dst);
+      else dst.set(data);
+    }
+    if(this.offset !== end)
+      throw new RangeError('srz: compressed size mismatch');
+    if(SRZ_HOST_LITTLE_ENDIAN) return new t.array(out.buffer, 0, n);
+    const a = new t.array(n);
+    const v = new DataView(out.buffer);
+    for(let i = 0; i !== n; ++i) a[i] = v[t.get](i * w, true);
+    return a;
+  }
+
+  /** read array serialized with srz::AsHalf as Float32Array */
+  half() {
+    const h = this.array('uint16');
+    const table = srzHalfs();
+    const out = new Float32Array(h.length);
+    for(let i = 0; i !== h.length; ++i) out[i] = table[h[i]];
+    return out;
+  }
+
+  /** read array serialized with srz::AsFixed8 ('uint8') or srz::AsFixed16
+      ('uint16') as Float32Array; same float arithmetic as the C++ decoder */
+  fixed(type) {
+    const lo = this.float32();
+    const hi = this.float32();
+    const q = this.array(type);
+    const step = Math.fround(Math.fround(hi - lo)
+                             / (type === 'uint8' ? 255 : 65535));
+    const out = new Float32Array(q.length);
+    for(let i = 0; i !== q.length; ++i)
+      out[i] = lo + Math.fround(q[i] * step);
+    return out;
+  }
+
+  /** read std::vector of non POD elements; readElement(reader) reads one */
+  vector(readElement) {
+    const n = this.size();
+    const v = new Array(n);
+    for(let i = 0; i !== n; ++i) v[i] = readElement(this);
+    return v;
+  }
+
+  /** read std::map, std::unordered_map or srz::FlatMap of numbers as
+      {keys, values} typed arrays */
+  flatMap(keyType, valueType) {
+    const keys = this.array(keyType);
+    const values = this.array(valueType);
+    if(keys.length !== values.length)
+      throw new RangeError('srz: map size mismatch');
+    return {keys, values};
+  }
+
+  /** read std::map, std::unordered_map or srz::FlatMap of numbers into
+      Map */
+  scalarMap(keyType, valueType) {
+    const {keys, values} = this.flatMap(keyType, valueType);
+    const m = new Map();
+    for(let i = 0; i !== keys.length; ++i) m.set(keys[i], values[i]);
+    return m;
+  }
+
+  /** read map of non POD keys or values into Map */
+  map(readKey, readValue) {
+    const n = this.size();
+    const m = new Map();
+    for(let i = 0; i !== n; ++i) {
+      const k = readKey(this);
+      m.set(k, readValue(this));
+    }
+    return m;
+  }
+}
+
+if(typeof module !== 'undefined') module.exports = {SrzReader, SRZ_TYPES};
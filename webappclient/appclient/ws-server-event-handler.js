@@ -9,20 +9,17 @@ function abtostr(ab) {
 /** Receive and parse messages from the server */
 function setupWSServerEventHandler(wsocket, resizeCB, log, view) {
   wsocket.onmessage = (e) => {
-    let id = new Int32Array(e.data, 0, 2);
-    if(id[0] === serverEventIDs['viewportResize']) {
-      let size = new Int32Array(e.data, 4, 2);
-      resizeCB(size[0], size[1]);
-      view.viewport = {width: size[0], height: size[1]};
-    } else if(id[0] === serverEventIDs['print']) {
-      let size = id[1];
-      let chars = new Uint8Array(e.data, 8, size);
-      //log(String.fromCharCode(...chars));
-      log(abtostr(chars));
-    } else if(id[0] === serverEventIDs['fileDownload']) {
-      const size = id[1]; //size information is redundant if all the data
-                          //is packages into a single bytearray
-      const buffer = new Uint8Array(e.data, 2 * 4, e.data.byteLength - 2 * 4);
+    //server packs with ZRF_int32_size and SRZ_WIRE_LE
+    const r = new SrzReader(e.data, {sizeBytes: 4});
+    const id = r.int32();
+    if(id === serverEventIDs['viewportResize']) {
+      const viewport = decodeViewportResize(r);
+      resizeCB(viewport.width, viewport.height);
+      view.viewport = viewport;
+    } else if(id === serverEventIDs['print']) {
+      log(abtostr(r.bytes()));
+    } else if(id === serverEventIDs['fileDownload']) {
+      const buffer = r.bytes();
       if(navigator.appVersion.search('Safari') !== -1
          && navigator.appVersion.search('Chrome') === -1) {
         // download(buffer, DOWNLOAD_FILE_NAME + ".txt",
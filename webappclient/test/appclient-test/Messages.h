@@ -0,0 +1,17 @@
+// Author: Ugo Varetto
+//
+// messages sent by the test server to the remote app client; JavaScript
+// decoders are generated by gen-messages-js into appclient/messages.js
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include <Fields.h>
+
+struct ViewportResize {
+    int32_t width;
+    int32_t height;
+};
+SRZ_FIELDS(ViewportResize, width, height)
@@ -22,10 +22,18 @@
 //use signed 32 integers for buffer length for compatibility with
 //javascript client
 #define ZRF_int32_size
+//little-endian wire format decoded by srz.js
+#define SRZ_WIRE_LE
 #include <Serialize.h>
+#include <Sinks.h>
+#include <Gather.h>
+#include <StreamDecoder.h>
+
+#include "Messages.h"
 
 #include "wslog.h"
 #include "WSocketMServer.h"
+#include "CoalescingQueue.h"
 
 
 enum class ClientEventId { MOUSE_DOWN = 1, MOUSE_UP = 2, MOUSE_DRAG = 3,
@@ -126,6 +134,201 @@ string CommandToStr(ServerCommandId id) {
     return c2s[id];
 }
 
+//Input event received from client: event id followed by up to three
+//integers
+struct InputEvent {
+    ClientId client;
+    ClientEventId id;
+    int data[3];
+};
+
+using InputQueue =
+    CoalescingQueue< InputEvent, pair< ClientId, ClientEventId > >;
+
+bool MergeInputEvents(const pair< ClientId, ClientEventId >& key,
+                      InputEvent& queued, InputEvent&& incoming) {
+    switch(key.second) {
+    case ClientEventId::MOUSE_DRAG:
+    case ClientEventId::RESIZE:
+        return InputQueue::Replace(key, queued, move(incoming));
+    case ClientEventId::MOUSE_WHEEL:
+        queued.data[0] += incoming.data[0];
+        return true;
+    default:
+        return false;
+    }
+}
+
+//Button, key and command events keep their position: drag, resize and
+//wheel events are not merged across them.
+bool InputEventBarrier(const pair< ClientId, ClientEventId >& key) {
+    switch(key.second) {
+    case ClientEventId::MOUSE_DRAG:
+    case ClientEventId::RESIZE:
+    case ClientEventId::MOUSE_WHEEL:
+        return false;
+    default:
+        return true;
+    }
+}
+
+void PrintInputEvent(const InputEvent& e) {
+    const string es = EventToStr(e.id);
+    if(es.empty()) return;
+    cout << e.client << "> " << es;
+    const int* pos = e.data;
+    using C = ClientEventId;
+    switch(e.id) {
+    case C::MOUSE_DOWN:
+    case C::MOUSE_UP:
+    case C::MOUSE_DRAG: {
+        //first byte is mouse buttons
+        const char& buttons = *reinterpret_cast< const char* >(pos + 2);
+        //second byte is keyboard modifiers
+        const char& modifiers =
+          *(reinterpret_cast< const char* >(pos + 2) + 1);
+        cout << " x: " << *pos << " y: " << *(pos + 1)
+             << " buttons: " << int(buttons)
+             << " modifiers: ";
+        if(0x01 & modifiers) cout << " Alt";
+        if(0x02 & modifiers) cout << " Ctrl";
+        if(0x04 & modifiers) cout << " Meta";
+        if(0x08 & modifiers) cout << " Shift";
+    }
+    break;
+    case C::RESIZE: {
+        cout << " width: " << *pos << " height: " << *(pos + 1) << endl;
+    }
+        break;
+    case C::KEYDOWN:
+    case C::KEYUP: {
+        const int modifier = *(pos + 1);
+        const string key = ToKeyString(char(*pos), bool(0x20 & modifier));
+
+        cout << " key: " << key << " ";
+        string location = "";
+
+        //if special and modifier
+        if((0x20 & modifier) && Modifier(*pos))  {
+          if(0x10 & modifier) location = " Right ";
+          else location =  " Left ";
+        }
+        cout << location;
+        if(0x01 & modifier) cout << "Alt";
+        if(0x02 & modifier) cout << "Ctrl";
+        if(0x04 & modifier) cout << "Meta";
+        if(0x08 & modifier) cout << "Shift";
+
+        cout << endl;
+    }
+    break;
+    case C::MOUSE_WHEEL: {
+        cout << " wheel: " << *pos << endl;
+    }
+    break;
+    default:
+        break;
+    }
+}
+
+//Input events are processed once per frame from the main loop; return
+//false if message is not an input event
+bool PushInputEvent(InputQueue& inputEvents, ClientId cid,
+                    const char* in, size_t len) {
+    const char* end = in + len;
+    int id = 0;
+    const char* p = srz::Validate< int >(in, end);
+    if(!p) return false;
+    srz::UnPack(in, id);
+    using C = ClientEventId;
+    switch(ClientEventId(id)) {
+    case C::MOUSE_DOWN:
+    case C::MOUSE_UP:
+    case C::MOUSE_DRAG:
+    case C::RESIZE:
+    case C::KEYDOWN:
+    case C::KEYUP:
+    case C::MOUSE_WHEEL: {
+        InputEvent e{};
+        e.client = cid;
+        e.id = ClientEventId(id);
+        //up to three integers, as many as received
+        for(int i = 0; i != 3 && srz::Validate< int >(p, end); ++i)
+            p = srz::UnPack(p, e.data[i]);
+        inputEvents.Push(make_pair(cid, e.id), move(e));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+//Per-client state of control message being received
+struct ControlMessage {
+    //uploads are limited to 1 GiB
+    srz::StreamDecoder decoder{size_t(1) << 30};
+    int id = 0;
+    int command = 0;
+    string text;
+    ofstream file;
+    size_t fileSize = 0;
+    //skip remaining fragments of invalid message
+    bool discard = false;
+};
+
+//Queue fields of command messages; uploaded files are written to disk as
+//received, without buffering the whole message
+void ReadControlMessage(ControlMessage& m, ClientId cid,
+                        bool& sendFile, ClientId& sendFileClient) {
+    using C = ClientEventId;
+    srz::StreamDecoder& d = m.decoder;
+    d.Read(m.id, [&m, &d, cid, &sendFile, &sendFileClient]() {
+        if(ClientEventId(m.id) == C::CMDSTRING) {
+            d.Read(m.text, [&m, cid]() {
+                cout << cid << "> " << EventToStr(C::CMDSTRING) << ": "
+                     << m.text << endl;
+            });
+        } else if(ClientEventId(m.id) == C::CMDID) {
+            d.Read(m.command, [&m, &d, cid, &sendFile, &sendFileClient]() {
+                const ServerCommandId id = ServerCommandId(m.command);
+                cout << cid << "> " << EventToStr(C::CMDID) << ": "
+                     << CommandToStr(id) << endl;
+                if(id == ServerCommandId::UPLOAD) {
+                    //file content: SIZE|DATA
+                    const char* downloadFilePath = "tmp-download";
+                    m.file.open(downloadFilePath, ios::binary);
+                    m.fileSize = 0;
+                    d.ReadChunks< char >([&m](const Byte* p, size_t n) {
+                        m.file.write(reinterpret_cast< const char* >(p), n);
+                        m.fileSize += n;
+                    }, [&m, downloadFilePath]() {
+                        m.file.close();
+                        cout << "\nFile received - " << m.fileSize
+                             << " bytes - saved to " << downloadFilePath
+                             << endl;
+                    });
+                } else if(id == ServerCommandId::SAVE) {
+                    sendFile = true;
+                    sendFileClient = cid;
+                }
+            });
+        }
+    });
+}
+
+//Serialize message directly into a pre-padded send buffer of the service,
+//ready to be passed to PushPrePaddedPtr
+template< typename ServiceT, typename... ArgsT >
+shared_ptr< vector< unsigned char > > PackPadded(ServiceT& service,
+                                                 const ArgsT&... args) {
+    shared_ptr< vector< unsigned char > > buf =
+        service.GetConsumedPaddedPtr(0);
+    srz::PrePaddedSink< vector< unsigned char > >
+        sink(*buf, service.PrePaddingSize());
+    srz::Pack(sink, args...);
+    return buf;
+}
+
 size_t FileSize(const string& fname) {
     ifstream file(fname);
     assert(file);
@@ -174,104 +377,43 @@ int main(int argc, char** argv) {
     }
     bool sendFile = false;
     ClientId sendFileClient = ClientId(0);
-    //callback invoked each time data is received
+    //input events: consecutive drags from the same client replace each
+    //other and wheel deltas accumulate, all other events are kept in order
+    InputQueue inputEvents(MergeInputEvents, InputEventBarrier);
+    //callback invoked each time data is received; messages are decoded
+    //as fragments arrive
+    map< ClientId, ControlMessage > controlMessages;
     auto controlStreamCBack =
-      [&sendFile, &sendFileClient]
+      [&sendFile, &sendFileClient, &inputEvents, &controlMessages]
       (WSSTATE s, ClientId cid, const char* in, size_t len,
-        bool /*isFinalFragment*/, bool /*isBinary*/) {
+        bool isFinalFragment, bool /*isBinary*/) {
         if(s == WSSTATE::CONNECT) {
             cout << cid << "> Control service connected" << endl;
             return;
         } else if(s == WSSTATE::DISCONNECT) {
+            controlMessages.erase(cid);
             cout << cid << "> Control service disconnected" << endl;
             return;
         }
-        const int* p = reinterpret_cast< const int* >(in);
-        const string es = EventToStr(ClientEventId(*p));
-        if(es.empty()) return;
-        cout << cid << "> " << es;
-        using C = ClientEventId;
-        switch(ClientEventId(*p)) {
-        case C::MOUSE_DOWN:
-        case C::MOUSE_UP:
-        case C::MOUSE_DRAG: {
-            const int* pos = ++p;
-            //first byte is mouse buttons
-            const char& buttons = *reinterpret_cast< const char* >(pos + 2);
-            //second byte is keyboard modifiers
-            const char& modifiers =
-              *(reinterpret_cast< const char* >(pos + 2) + 1);
-            cout << " x: " << *pos << " y: " << *(pos + 1)
-                 << " buttons: " << int(buttons)
-                 << " modifiers: ";
-            if(0x01 & modifiers) cout << " Alt";
-            if(0x02 & modifiers) cout << " Ctrl";
-            if(0x04 & modifiers) cout << " Meta";
-            if(0x08 & modifiers) cout << " Shift";
-        }
-        break;
-        case C::RESIZE: {
-            const int* pos = ++p;
-            cout << " width: " << *pos << " height: " << *(pos + 1) << endl;
-        }
-            break;
-        case C::KEYDOWN:
-        case C::KEYUP: {
-            const int* pos = ++p;
-            const int modifier = *(pos + 1);
-            const string key = ToKeyString(char(*pos), bool(0x20 & modifier));
-
-            cout << " key: " << key << " ";
-            string location = "";
-
-            //if special and modifier
-            if((0x20 & modifier) && Modifier(*pos))  {
-              if(0x10 & modifier) location = " Right ";
-              else location =  " Left ";
-            }
-            cout << location;
-            if(0x01 & modifier) cout << "Alt";
-            if(0x02 & modifier) cout << "Ctrl";
-            if(0x04 & modifier) cout << "Meta";
-            if(0x08 & modifier) cout << "Shift";
-
-            cout << endl;
-        }
-        break;
-        case C::MOUSE_WHEEL: {
-            const int* pos = ++p;
-            cout << " wheel: " << *pos << endl;
-        }
-        break;
-        case C::CMDSTRING: {
-            const int length = *(p + 1);
-            const char* begin = reinterpret_cast< const char* >(p + 2);
-            string text(begin, begin + length);
-            cout << ": " << text << endl;
+        ControlMessage& m = controlMessages[cid];
+        if(m.discard) {
+            m.discard = !isFinalFragment;
+            return;
         }
-        break;
-        case C::CMDID: {
-          const int id = *(p + 1);
-          cout << ": " << CommandToStr(ServerCommandId(id)) << endl;
-          if(id == int(ServerCommandId::UPLOAD)) {
-            const int length = *(p + 2);
-            const char* buf = reinterpret_cast< const char* >(in)
-                              + 3 * sizeof(int);
-            const vector< char > data(buf, buf + length);
-            const char* downloadFilePath = "tmp-download";
-            ofstream os(downloadFilePath, ios::binary);
-            os.write(&data[0], data.size());
-            cout << "\nFile received - "
-                 << length << " bytes - saved to " << downloadFilePath
-                 << endl;
-          } else if(id == int(ServerCommandId::SAVE)) {
-              sendFile = true;
-              sendFileClient = cid;
-          }
+        if(m.decoder.Done()) {
+            //first fragment: input events are always received whole
+            if(isFinalFragment && PushInputEvent(inputEvents, cid, in, len))
+                return;
+            ReadControlMessage(m, cid, sendFile, sendFileClient);
         }
-        break;
-        default:
-            break;
+        try {
+            m.decoder.Feed(in, len);
+            if(isFinalFragment && !m.decoder.Done())
+                throw runtime_error("truncated message");
+        } catch(const runtime_error& e) {
+            cerr << cid << "> Invalid control message: " << e.what() << endl;
+            m.decoder.Reset();
+            m.discard = !isFinalFragment;
         }
       };
     auto imageStreamCBack =
@@ -295,7 +437,7 @@ int main(int argc, char** argv) {
     const string wsControlStreamProto = "appclient-control-protocol";
     const int wsImageStreamPort = 8881;
     const int wsControlStreamPort = 8882;
-    const bool recycleMemoryOption = false;
+    const bool recycleMemoryOption = true;
     try {
         WSocketMServer< decltype(controlStreamCBack) >
           controlService(wsControlStreamProto, //protocol name
@@ -306,7 +448,10 @@ int main(int argc, char** argv) {
                          recycleMemoryOption, //recycle memory
                          0x1000, //input buffer size
                          //min interval between sends in ms
-                         sendInterval.count() / 1000);
+                         sendInterval.count() / 1000,
+                         //deliver fragments as received, decoded by
+                         //srz::StreamDecoder
+                         false);
         WSocketMServer< decltype(imageStreamCBack) >
           imageStreamService(wsImageStreamProto, //protocol name
                              1000, //timeout: will spend this time to process
@@ -320,12 +465,11 @@ int main(int argc, char** argv) {
         signal(SIGINT, forceQuit);
         //send images from main thread
         int count = 0;
-        const vector< unsigned char > resize
-          = srz::Pack(ServerEventId::RESIZE, 960, 540);
         chrono::high_resolution_clock::time_point start
           = chrono::high_resolution_clock::now();
         chrono::high_resolution_clock::time_point msgStart = start;
         chrono::high_resolution_clock::time_point resizeStart = start;
+        vector< InputEvent > frameEvents;
         const chrono::seconds textMessageInterval(5); //5s
         const chrono::seconds resizeMessageInterval(10); //10s
         while (!forceExit) {
@@ -336,30 +480,46 @@ int main(int argc, char** argv) {
               chrono::duration_cast< chrono::seconds >(now - resizeStart);
             //auto const elapsed = now - start;
             this_thread::sleep_until(start + sendInterval);
+            //process input received since last frame
+            frameEvents.clear();
+            inputEvents.PopAll(frameEvents);
+            for(const auto& e: frameEvents) PrintInputEvent(e);
             if(imageStreamService.ConnectedClients() == 0) continue;
             const bool prePaddingOption = true;
-            imageStreamService.PushPrePaddedPtr(imgs[count % imgs.size()]);
+            //slow clients skip frames instead of queueing them
+            imageStreamService.PushPrePaddedPtr(imgs[count % imgs.size()],
+                                                WSMSGTYPE::BINARY,
+                                                BroadcastId(),
+                                                WSSENDPOLICY::LATEST);
             ++count;
             //send a text message
             if(msgElapsed >= textMessageInterval) {
-              const vector< unsigned char > msg
-                = srz::Pack(ServerEventId::PRINT, to_string(count));
-              controlService.Push(msg, false);
+              controlService.PushPrePaddedPtr(
+                PackPadded(controlService,
+                           ServerEventId::PRINT, to_string(count)));
               msgStart = now;
             }
             //send a resize message evety ~10 seconds
             if(resizeElapsed >= resizeMessageInterval) {
-              controlService.Push(resize, false);
+              //fixed size message: serialized on the stack
+              const auto resize = srz::PackFixed(ServerEventId::RESIZE,
+                                                 ViewportResize{960, 540});
+              controlService.Push(resize.data(), resize.size());
               resizeStart = now;
             }
             start = now;
             if(sendFile) {
-              const string fileContent = "This is the file content";
+              auto fileContent =
+                make_shared< const string >("This is the file content");
               //client expects a buffer in the form: ID|SIZE|DATA where
               // ID and SIZE are 32 bit signed integers and DATA is a byte
-              // array
-              auto f = srz::Pack(ServerEventId::FILE_DOWNLOAD, fileContent);
-              controlService.Push(f, false, sendFileClient);
+              // array; large file content is sent from its own memory
+              // without copying it into a message buffer
+              auto g = make_shared< srz::GatherBuffer >();
+              g->Hold(fileContent);
+              srz::PackGather(*g, ServerEventId::FILE_DOWNLOAD, *fileContent);
+              controlService.PushSegments(g->Segments(), g,
+                                          WSMSGTYPE::BINARY, sendFileClient);
               sendFile = false;
               sendFileClient = ClientId(0);
             }
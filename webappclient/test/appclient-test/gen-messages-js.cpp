@@ -0,0 +1,36 @@
+// Author: Ugo Varetto
+//
+// generate JavaScript decoders of the messages in Messages.h;
+// usage: gen-messages-js [output file, default: standard output]
+//
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+//same wire format as appclient-test
+#define ZRF_UNSIGNED_CHAR
+#define ZRF_int32_size
+#define SRZ_WIRE_LE
+#include <Serialize.h>
+#include <JSDecoder.h>
+
+#include "Messages.h"
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    srz::JSDecoderGenerator g;
+    g.Add< ViewportResize >("decodeViewportResize");
+    if(argc < 2) {
+        cout << g.Source();
+        return EXIT_SUCCESS;
+    }
+    ofstream os(argv[1]);
+    if(!os) {
+        cerr << "Cannot open " << argv[1] << endl;
+        return EXIT_FAILURE;
+    }
+    os << g.Source();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+// Wire format conformance test for the JavaScript srz decoder.
+// The golden message is the one checked by serializer/test/WireFormatTest.cpp
+// (SRZ_WIRE_LE, SRZ_WIRE_ALIGNED, ZRF_int32_size).
+//
+// usage: node srz-conformance.js
+
+const assert = require('assert');
+const path = require('path');
+const {SrzReader} = require(path.join(__dirname, '../../appclient/srz.js'));
+const {decodeViewportResize} =
+  require(path.join(__dirname, '../../appclient/messages.js'));
+
+//int32 0x01020304, uint16 0xa1b2, double 1.5, string "hi",
+//vector<float> {1, -2}, vector<uint8_t> {7}, vector<double> {0.25}
+const GOLDEN = [
+  0x04, 0x03, 0x02, 0x01,
+  0xb2, 0xa1,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0x3f,
+  0x02, 0x00, 0x00, 0x00, 0x68, 0x69,
+  0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x00, 0xc0,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x07,
+  0x01, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x3f
+];
+
+function decode(data) {
+  const r = new SrzReader(data, {sizeBytes: 4, aligned: true});
+  const m = {
+    i32: r.int32(),
+    u16: r.uint16(),
+    d: r.float64(),
+    s: r.string(),
+    vf: r.array('float32'),
+    vb: r.array('uint8'),
+    vd: r.array('float64')
+  };
+  assert.strictEqual(r.remaining(), 0);
+  return m;
+}
+
+function check(m) {
+  assert.strictEqual(m.i32, 0x01020304);
+  assert.strictEqual(m.u16, 0xa1b2);
+  assert.strictEqual(m.d, 1.5);
+  assert.strictEqual(m.s, 'hi');
+  assert.deepStrictEqual(Array.from(m.vf), [1, -2]);
+  assert.deepStrictEqual(Array.from(m.vb), [7]);
+  assert.deepStrictEqual(Array.from(m.vd), [0.25]);
+}
+
+//1. message at start of buffer: padded arrays are mapped in place
+{
+  const buf = new Uint8Array(GOLDEN).buffer;
+  const m = decode(buf);
+  check(m);
+  assert.strictEqual(m.vf.buffer, buf);
+  assert.strictEqual(m.vd.buffer, buf);
+}
+
+//2. message at misaligned offset: arrays are copied
+{
+  const storage = new Uint8Array(GOLDEN.length + 1);
+  storage.set(GOLDEN, 1);
+  const m = decode(storage.subarray(1));
+  check(m);
+  assert.notStrictEqual(m.vd.buffer, storage.buffer);
+}
+
+//3. 64 bit sizes, no padding, containers
+{
+  const bytes = [
+    //vector<string> {"a", "bc"}
+    0x02, 0, 0, 0, 0, 0, 0, 0,
+    0x01, 0, 0, 0, 0, 0, 0, 0, 0x61,
+    0x02, 0, 0, 0, 0, 0, 0, 0, 0x62, 0x63,
+    //map<int16, float> {{-1, 0.5}, {2, -1}}: keys then values
+    0x02, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0x02, 0x00,
+    0x02, 0, 0, 0, 0, 0, 0, 0,
+    0x00, 0x00, 0x00, 0x3f, 0x00, 0x00, 0x80, 0xbf,
+    //map<string, uint8> {{"k", 7}}: key, value pairs
+    0x01, 0, 0, 0, 0, 0, 0, 0,
+    0x01, 0, 0, 0, 0, 0, 0, 0, 0x6b, 0x07
+  ];
+  const r = new SrzReader(new Uint8Array(bytes), {sizeBytes: 8});
+  assert.deepStrictEqual(r.vector(e => e.string()), ['a', 'bc']);
+  const m = r.scalarMap('int16', 'float32');
+  assert.strictEqual(m.size, 2);
+  assert.strictEqual(m.get(-1), 0.5);
+  assert.strictEqual(m.get(2), -1);
+  const s = r.map(e => e.string(), e => e.uint8());
+  assert.strictEqual(s.get('k'), 7);
+  //keys and values arrays of different length
+  const bad = new SrzReader(new Uint8Array([1, 0, 0, 0, 7, 0, 0, 0, 0]));
+  assert.throws(() => bad.flatMap('uint8', 'uint8'), RangeError);
+  assert.strictEqual(r.remaining(), 0);
+  assert.throws(() => r.int8(), RangeError);
+}
+
+//4. integer encodings, same golden messages as WireFormatTest.cpp
+{
+  const delta = [
+    0x05, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00,
+    0xc8, 0x01, 0x02, 0x04, 0x00, 0x19
+  ];
+  let r = new SrzReader(new Uint8Array(delta));
+  assert.deepStrictEqual(Array.from(r.encoded('uint32', 'delta')),
+                         [100, 101, 103, 103, 90]);
+  const words = [0x00, 0x00, 0x00, 0x00, 0x55, 0x55, 0x55, 0x55,
+                 0xaa, 0xaa, 0xaa, 0xaa, 0xff, 0xff, 0xff, 0xff];
+  const packed = [0x82, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x02]
+    .concat(words, words, [0x05, 0xac, 0x02]);
+  r = new SrzReader(new Uint8Array(packed));
+  const expected = [];
+  for(let i = 0; i !== 128; ++i) expected.push(i % 4);
+  expected.push(5, 300);
+  assert.deepStrictEqual(Array.from(r.encoded('uint32', 'bitpacked')),
+                         expected);
+  assert.strictEqual(r.remaining(), 0);
+  //signed zigzag: -1, 1, -2 encoded as 1, 2, 3
+  r = new SrzReader(new Uint8Array([3, 0, 0, 0, 3, 0, 0, 0, 1, 2, 3]));
+  assert.deepStrictEqual(Array.from(r.encoded('int16', 'zigzag')),
+                         [-1, 1, -2]);
+}
+
+//5. generated decoders: Pack(ServerEventId::RESIZE, ViewportResize{960, 540})
+{
+  const r = new SrzReader(new Uint8Array([2, 0, 0, 0, 0xc0, 0x03, 0, 0,
+                                          0x1c, 0x02, 0, 0]));
+  assert.strictEqual(r.int32(), 2);
+  assert.deepStrictEqual(decodeViewportResize(r), {width: 960, height: 540});
+  assert.strictEqual(r.remaining(), 0);
+  assert.throws(() => decodeViewportResize(r), RangeError);
+}
+
+//6. compressed arrays, same golden messages as WireFormatTest.cpp
+{
+  const expected = [];
+  for(let i = 0; i !== 64; ++i) expected.push(1000 + (i >>> 3));
+  const byteShuffled = [
+    0x40, 0x00, 0x00, 0x00, 0x35, 0x00, 0x00, 0x00,
+    0x02, 0x01, 0x00, 0x80, 0x00, 0x00,
+    0x2b, 0x00, 0x00, 0x00,
+    0x13, 0xe8, 0x01, 0x00, 0x13, 0xe9, 0x01, 0x00, 0x13, 0xea, 0x01, 0x00,
+    0x13, 0xeb, 0x01, 0x00, 0x13, 0xec, 0x01, 0x00, 0x13, 0xed, 0x01, 0x00,
+    0x13, 0xee, 0x01, 0x00, 0x13, 0xef, 0x01, 0x00, 0x1f, 0x03, 0x01, 0x00,
+    0x27, 0x50, 0x03, 0x03, 0x03, 0x03, 0x03
+  ];
+  let r = new SrzReader(new Uint8Array(byteShuffled));
+  assert.deepStrictEqual(Array.from(r.compressed('uint16')), expected);
+  assert.strictEqual(r.remaining(), 0);
+  const bitShuffled = [
+    0x40, 0x00, 0x00, 0x00, 0x34, 0x00, 0x00, 0x00,
+    0x02, 0x02, 0x00, 0x80, 0x00, 0x00,
+    0x2a, 0x00, 0x00, 0x00,
+    0x23, 0x00, 0xff, 0x02, 0x00, 0x23, 0x00, 0xff, 0x04, 0x00, 0x37, 0x00,
+    0x00, 0xff, 0x01, 0x00, 0x00, 0x10, 0x00, 0x00, 0x02, 0x00, 0x07, 0x13,
+    0x00, 0x0f, 0x02, 0x00, 0x0a, 0x00, 0x2c, 0x00, 0x0f, 0x02, 0x00, 0x14,
+    0x50, 0x00, 0x00, 0x00, 0x00, 0x00
+  ];
+  r = new SrzReader(new Uint8Array(bitShuffled));
+  assert.deepStrictEqual(Array.from(r.compressed('uint16')), expected);
+  r = new SrzReader(new Uint8Array(bitShuffled));
+  assert.throws(() => r.compressed('float32'), RangeError);
+}
+
+//7. reduced precision, same golden message as WireFormatTest.cpp
+{
+  const bytes = [
+    0x05, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x3c, 0x00, 0xc0, 0x00, 0x38, 0xff, 0x7b, 0x02, 0x00,
+    0x00, 0x00, 0x80, 0xbf, 0x00, 0x00, 0x80, 0x3f,
+    0x04, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x9f, 0xff, 0x00,
+    0x00, 0x00, 0x80, 0xbf, 0x00, 0x00, 0x80, 0x3f,
+    0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0xff, 0x9f, 0xff, 0xff, 0x00, 0x00
+  ];
+  const r = new SrzReader(new Uint8Array(bytes), {aligned: true});
+  assert.deepStrictEqual(Array.from(r.half()),
+                         [1, -2, 0.5, 65504, Math.pow(2, -23)]);
+  const f32 = (a) => a.map(Math.fround);
+  assert.deepStrictEqual(Array.from(r.fixed('uint8')),
+                         f32([0.003921628, 0.247058868, 1, -1]));
+  assert.deepStrictEqual(Array.from(r.fixed('uint16')),
+                         f32([1.52587891e-05, 0.249988556, 1, -1]));
+  assert.strictEqual(r.remaining(), 0);
+}
+
+console.log('PASSED');
@@ -8,20 +8,27 @@
 // - offer option to reuse memory by storing the consumed data buffer into
 //   a memory pool accessible from client code
 //
+// Requires ObjectPool.h and MPSCQueue.h from syncqueue.
+//
 #include <string>
 #include <vector>
 #include <mutex>
 #include <cstring>
 #include <chrono>
 #include <thread>
-#include <deque>
 #include <utility>
 #include <memory>
 #include <future>
-#include <map>
-#include <cassert>
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <new>
 #include <libwebsockets.h>
 
+#include "ObjectPool.h"
+#include "MPSCQueue.h"
+
 //Note: use libev if possible
 
 ///Cliend id. Matches the void* type received in libwebsockets callback function
@@ -32,16 +39,33 @@ inline ClientId BroadcastId() { return ClientId(size_t(-1)); }
 enum class WSSTATE {SEND, RECV, CONNECT, DISCONNECT};
 //Websocket message type
 enum class WSMSGTYPE {TEXT = LWS_WRITE_TEXT, BINARY = LWS_WRITE_BINARY};
+///Send queue policy: \c QUEUE messages, e.g. control messages, are sent
+///in order from a bounded queue; \c LATEST messages, e.g. image frames,
+///replace the unsent one of the same client.
+enum class WSSENDPOLICY {QUEUE, LATEST};
+///Per-client send statistics.
+struct WSSendStats {
+    ///Messages sent.
+    size_t sent = 0;
+    ///Queued messages dropped because the queue was full.
+    size_t dropped = 0;
+    ///Latest-wins messages replaced before being sent.
+    size_t replaced = 0;
+};
 ///Websockets server
 /// \tparam CBackT callback invoked at connection, disconnection and receive
 /// time.
-///Data is sent to connected clients through the Push method.
+///Data is sent to connected clients through the Push method, callable
+///from any thread: messages are added to lock-free per-client queues and
+///broadcast to a snapshot of the connected clients.
+///Clients are serviced by one or more service threads, each client by
+///a single thread; with more than one thread the callback is invoked
+///concurrently from different threads.
 template < typename CBackT >
 class WSocketMServer {
 private:
     using ByteArray = std::vector< unsigned char >;
     using BAPtr = std::shared_ptr< ByteArray >;
-    using ClientQueues = std::map< ClientId, std::deque< BAPtr > >;
 public:
     WSocketMServer() = delete;
     WSocketMServer(const WSocketMServer&) = delete;
@@ -53,11 +77,12 @@ public:
                    bool recycleMemory,
                    size_t recvBufferSize = 0x10000,
                    int frameTime = 30, //ms
-                   bool atomicMessages = true)
+                   bool atomicMessages = true,
+                   int serviceThreads = 1)
         : protocolName_(protocolName),
           stop(false), cback(cb), frameTime_(frameTime), 
           recycleMemory_(recycleMemory), atomicMessages_(atomicMessages) {
-        Init(timeout, port, recvBufferSize);
+        Init(timeout, port, recvBufferSize, serviceThreads);
     }
     const std::string& Name() const { return protocolName_; }
     ~WSocketMServer() {
@@ -65,9 +90,8 @@ public:
     }
     ///Return sequence of client ids.
     std::vector< ClientId > Clients() {
-        std::lock_guard< std::mutex > l(clientQueueGuard_);
         std::vector< ClientId > cid;
-        for(auto& e: clientQueues_) cid.push_back(e.first);
+        for(auto& e: *Snapshot()) cid.push_back(e.first);
         return cid;
     }
     ///Push data into send queue.
@@ -76,107 +100,404 @@ public:
     /// \param id client to send to, if == broadcast id send to all
     /// connected clients
     /// bytes, \c false otherwise
+    /// \param policy queue or replace unsent message
     void Push(const ByteArray& d,
               bool prePadded,
               WSMSGTYPE writeMode = WSMSGTYPE::BINARY,
-              ClientId id = BroadcastId()) {
-        if(id != BroadcastId() && !ClientInQueue(id))
-            throw std::logic_error("Requested client id not valid");
+              ClientId id = BroadcastId(),
+              WSSENDPOLICY policy = WSSENDPOLICY::QUEUE) {
+        ClientPtr c = Recipient(id);
         std::pair< PerSendData, BAPtr > p;
         p.first.writeMode = writeMode;
-        if(prePadded) p.second.reset(new ByteArray(d));
-        else  {
-            ByteArray* v = new ByteArray(PrePaddingSize() + d.size());
-            memmove(v->data() + PrePaddingSize(), d.data(), d.size());
-            p.second.reset(v);
-        } 
-        std::lock_guard< std::mutex > l(clientQueueGuard_);
-        if(id == BroadcastId()) {
-            for(auto& q: clientQueues_) q.second.push_back(p);
-        } else {
-            clientQueues_[id].push_back(p);
+        if(prePadded) {
+            p.second = NewBuffer(d.size());
+            memmove(p.second->data(), d.data(), d.size());
+        } else  {
+            p.second = NewBuffer(PrePaddingSize() + d.size());
+            memmove(p.second->data() + PrePaddingSize(), d.data(), d.size());
         }
+        Enqueue(p, c, policy);
+    }
+    ///Push data from raw memory, e.g. a fixed size message serialized on
+    ///the stack with \c srz::PackFixed; data is copied into a pre-padded
+    ///buffer, taken from the memory pool when recycling memory.
+    void Push(const unsigned char* data,
+              size_t size,
+              WSMSGTYPE writeMode = WSMSGTYPE::BINARY,
+              ClientId id = BroadcastId(),
+              WSSENDPOLICY policy = WSSENDPOLICY::QUEUE) {
+        ClientPtr c = Recipient(id);
+        std::pair< PerSendData, BAPtr > p;
+        p.first.writeMode = writeMode;
+        p.second = NewBuffer(PrePaddingSize() + size);
+        memmove(p.second->data() + PrePaddingSize(), data, size);
+        Enqueue(p, c, policy);
     }
     ///Push prepadded buffer stored into a \c shared_ptr
     ///This is the preferred way of passing data to the object since internally
     ///only \c shared_ptr objects are used.
     void PushPrePaddedPtr(BAPtr ptr, 
                           WSMSGTYPE writeMode = WSMSGTYPE::BINARY,
-                          ClientId id = BroadcastId()) {
-        if(id != BroadcastId() && !ClientInQueue(id))
-            throw std::logic_error("Requested client id not valid");
+                          ClientId id = BroadcastId(),
+                          WSSENDPOLICY policy = WSSENDPOLICY::QUEUE) {
+        ClientPtr c = Recipient(id);
         std::pair< PerSendData, BAPtr > p;
         p.first.writeMode = writeMode;
         p.second = ptr;
-        std::lock_guard< std::mutex > l(clientQueueGuard_);
-        if(id == BroadcastId()) {
-            for(auto& q: clientQueues_) q.second.push_back(p);
-        } else {
-            clientQueues_[id].push_back(p);
+        Enqueue(p, c, policy);
+    }
+    ///Push message made of a list of memory segments, e.g. created by
+    ///\c srz::PackGather.
+    ///Segments are sent as fragments of a single message through a
+    ///per-client staging buffer of at most \c GatherChunkSize() bytes,
+    ///no contiguous copy of the whole message is created.
+    /// \param segments address and size of each segment
+    /// \param owner object keeping the segment memory alive, released once
+    /// the message has been sent to all the recipients
+    void PushSegments(
+        const std::vector< std::pair< const void*, size_t > >& segments,
+        std::shared_ptr< const void > owner,
+        WSMSGTYPE writeMode = WSMSGTYPE::BINARY,
+        ClientId id = BroadcastId(),
+        WSSENDPOLICY policy = WSSENDPOLICY::QUEUE) {
+        ClientPtr c = Recipient(id);
+        std::shared_ptr< Gather > g = std::make_shared< Gather >();
+        g->size = 0;
+        for(auto& s: segments) {
+            g->segments.push_back(std::make_pair(
+                reinterpret_cast< const unsigned char* >(s.first), s.second));
+            g->size += s.second;
         }
+        g->owner = std::move(owner);
+        std::pair< PerSendData, BAPtr > p;
+        p.first.writeMode = writeMode;
+        p.first.gather = g;
+        Enqueue(p, c, policy);
+    }
+    ///Set maximum size of fragments sent for messages pushed through
+    ///\c PushSegments; can be called from any thread, takes effect on the
+    ///next fragment sent.
+    void SetGatherChunkSize(size_t sz) {
+        gatherChunkSize_ = std::max(sz, size_t(1));
+    }
+    ///Maximum size of fragments sent for messages pushed through
+    ///\c PushSegments.
+    size_t GatherChunkSize() const { return gatherChunkSize_; }
+    ///Set maximum number of queued messages per client, not including
+    ///the latest-wins message; when the queue is full the oldest unsent
+    ///messages are dropped by the service thread, pushing never blocks.
+    void SetMaxQueueSize(size_t sz) {
+        maxQueueSize_ = std::max(sz, size_t(1));
+    }
+    ///Maximum number of queued messages per client.
+    size_t MaxQueueSize() const { return maxQueueSize_; }
+    ///Send statistics of client.
+    WSSendStats SendStats(ClientId id) {
+        const ClientPtr c = Recipient(id);
+        if(!c) throw std::logic_error("Requested client id not valid");
+        WSSendStats stats;
+        stats.sent = c->sent;
+        stats.dropped = c->dropped;
+        stats.replaced = c->replaced;
+        return stats;
     }
     ///Return \c shared_ptr pointing to an \c std::vector of the requested size.
-    ///The returned object is picked from a pool of objects received through
-    ///the Push method or a new one is created if the pool is empty.
+    ///The returned object is picked from a pool of consumed buffers or a new
+    ///one is created if the pool is empty.
     ///Data is already pre-padded and client code shall write at PrePaddingSize
     ///offset.
     ///Using this method to retrieve a buffer allows to avoid unnecessary memory
-    ///allocations since the same memory buffer is reused multiple times.
+    ///allocations since the same memory buffer is reused multiple times: the
+    ///buffer is returned to the pool when the last reference to it is
+    ///released, normally after it has been sent to all the clients.
     ///Reusing memory buffers is enabled only when the object is constructed
     ///with a \c recycleMemory flag set to true.
     std::shared_ptr< std::vector< unsigned char > >
     GetConsumedPaddedPtr(size_t sz) {
-        std::lock_guard< std::mutex > l(consumedQueueMutex_);
-        if(consumedQueue_.empty())
-            return std::shared_ptr< std::vector< unsigned char > >(
-                new std::vector< unsigned char >(sz)
-            );
-        std::shared_ptr< std::vector< unsigned char > > p
-            = consumedQueue_.front();
-        consumedQueue_.pop_front();
-        p->resize(sz);
-        return p;
+        return NewBuffer(sz);
     }
     ///Returns \c true if the pool of consumed buffer is empty.
     bool ConsumedQueueEmpty() {
-        std::lock_guard< std::mutex > l(consumedQueueMutex_);
-        const bool e = consumedQueue_.empty();
-        return e;
+        return bufferPool_.Idle() == 0;
     }
-    ///Minimum time in milliseconds between subsequent sends.
+    ///Minimum time in milliseconds between subsequent sends, default for
+    ///new clients.
     int FrameTime() const { return frameTime_; }
-    ///Number of connected clients. \warning not synchronized
-    size_t ConnectedClients() const { return clientQueues_.size(); }
+    ///Set minimum time in milliseconds between subsequent sends to one
+    ///client; pacing is per client, other clients are not delayed.
+    void SetFrameTime(ClientId id, int frameTime) {
+        const ClientPtr c = Recipient(id);
+        if(!c) throw std::logic_error("Requested client id not valid");
+        c->frameTime = frameTime;
+    }
+    ///Number of connected clients.
+    size_t ConnectedClients() const { return connected_; }
+    ///Number of service threads.
+    size_t ServiceThreads() const { return shards_.size(); }
     ///Size of pre-padded region.
     const size_t PrePaddingSize() const { return LWS_PRE; }
 private:
-    ///Per-session data: created when a client connects, destroyed when
-    ///it disconnects.
-    struct PerSessionData {
-        ///Time of previous send or creation time in case of first send.
-        std::chrono::steady_clock::time_point prev;
-
+    ///Message sent from a list of memory segments.
+    struct Gather {
+        std::vector< std::pair< const unsigned char*, size_t > > segments;
+        ///Total size in bytes
+        size_t size;
+        ///Keeps segment memory alive
+        std::shared_ptr< const void > owner;
     };
     ///Per-send data: created every time user pushes to their send queue
     struct PerSendData {
         ///lws write protocol to use when sending
         WSMSGTYPE writeMode;
+        ///Segments of gather message, \c nullptr for contiguous buffers
+        std::shared_ptr< const Gather > gather;
+        ///Number of bytes of gather message already sent to the client
+        size_t sent = 0;
+    };
+    using Message = std::pair< PerSendData, BAPtr >;
+    ///Connected client: send queue and state, shared by the session data,
+    ///the client registry and threads pushing to it; a client that
+    ///disconnects while a message is pushed is released after the push.
+    struct Client {
+        ///Client id: address of the session data.
+        ClientId id = nullptr;
+        ///Connection.
+        lws* wsi = nullptr;
+        ///Index of the service thread, the one running at connection time.
+        size_t shard = 0;
+        ///Queued messages, pushed from any thread and popped from the
+        ///service thread.
+        MPSCQueue< Message > messages;
+        ///Number of queued messages, incremented before pushing.
+        std::atomic< size_t > queued{0};
+        ///Unsent latest-wins message, owned by the slot.
+        std::atomic< Message* > latest{nullptr};
+        ///Gather message being sent in fragments, service thread only.
+        Message current;
+        ///Time of previous send, first send is not delayed.
+        std::chrono::steady_clock::time_point prev;
+        ///Minimum time in ms between subsequent sends, set from any thread.
+        std::atomic< int > frameTime{0};
+        ///\c true if in the list of clients with new data of its shard.
+        std::atomic< bool > dirty{false};
+        ///\c true once disconnected; accessed from the service thread of
+        ///the shard only, which services the connection and drains the
+        ///shard's dirty list.
+        bool closed = false;
+        std::atomic< size_t > sent{0};
+        std::atomic< size_t > dropped{0};
+        std::atomic< size_t > replaced{0};
+        ///Staging buffer for fragments of gather messages, service thread
+        ///only.
+        ByteArray staging;
+        ///Receive buffer used for constructing atomic messages, service
+        ///thread only.
+        std::vector< char > recvBuffer;
+        ~Client() { delete latest.load(); }
+    };
+    using ClientPtr = std::shared_ptr< Client >;
+    ///Client registry, never modified once published: connections and
+    ///disconnections replace it with a modified copy.
+    using ClientMap = std::unordered_map< ClientId, ClientPtr >;
+    ///Per-session data: created when a client connects, destroyed when
+    ///it disconnects.
+    ///Memory is allocated by libwebsockets, objects are constructed when
+    ///the connection is established.
+    struct PerSessionData {
+        ClientPtr client;
+    };
+    ///State of the clients serviced by one service thread.
+    struct Shard {
+        ///Clients with messages pushed since the last service wake up,
+        ///popped from the service thread.
+        MPSCQueue< ClientPtr > dirty;
     };
 private:
-    ///Check if client id in queue.
-    bool ClientInQueue(ClientId id) const {
-        return clientQueues_.find(id) != clientQueues_.end();
+    ///Current client registry; lock-free with respect to the service
+    ///threads, which only lock to replace it.
+    std::shared_ptr< const ClientMap > Snapshot() const {
+        return std::atomic_load(&clients_);
+    }
+    ///Client to push to, \c nullptr for the broadcast id.
+    /// \throw std::logic_error if the client is not connected
+    ClientPtr Recipient(ClientId id) const {
+        if(id == BroadcastId()) return ClientPtr();
+        const std::shared_ptr< const ClientMap > clients = Snapshot();
+        auto c = clients->find(id);
+        if(c == clients->end())
+            throw std::logic_error("Requested client id not valid");
+        return c->second;
+    }
+    ///Add connected client to the registry; invoked from the service
+    ///threads.
+    void AddClient(const ClientPtr& c) {
+        std::lock_guard< std::mutex > l(clientsGuard_);
+        std::shared_ptr< ClientMap > clients =
+            std::make_shared< ClientMap >(*Snapshot());
+        (*clients)[c->id] = c;
+        std::atomic_store(&clients_,
+                          std::shared_ptr< const ClientMap >(clients));
+    }
+    ///Remove disconnected client from the registry; invoked from the
+    ///service threads.
+    void RemoveClient(ClientId id) {
+        std::lock_guard< std::mutex > l(clientsGuard_);
+        std::shared_ptr< ClientMap > clients =
+            std::make_shared< ClientMap >(*Snapshot());
+        clients->erase(id);
+        std::atomic_store(&clients_,
+                          std::shared_ptr< const ClientMap >(clients));
+    }
+    ///Server and index of the service thread running in the calling
+    ///thread, set before entering the service loop.
+    struct ServiceThread {
+        const WSocketMServer* server;
+        size_t index;
+    };
+    static ServiceThread& CurrentServiceThread() {
+        static thread_local ServiceThread t = {nullptr, 0};
+        return t;
     }
-    ///Add consumed (sent) buffer to memory pool.
-    void PushConsumedPaddedPtr(BAPtr p) {
-        std::lock_guard< std::mutex > l(consumedQueueMutex_);
-        if(p.unique())
-            consumedQueue_.push_back(p);
+    ///Index of the calling service thread: a connection is serviced by
+    ///a single thread, the index does not depend on the connection.
+    ///The index stored in \c wsi is only used if invoked from another
+    ///thread: the wsi of \c LWS_CALLBACK_EVENT_WAIT_CANCELLED is not
+    ///guaranteed to carry the index of the thread woken up.
+    size_t ShardIndex(lws* wsi) const {
+        const ServiceThread& st = CurrentServiceThread();
+        if(st.server == this) return st.index;
+        const size_t t = size_t(std::max(lws_get_tsi(wsi), 0));
+        return std::min(t, shards_.size() - 1);
     }
-    ///Initialize libwebsockets and start service loop in separate thread
+    ///Shard of the calling service thread.
+    Shard& ShardOf(lws* wsi) { return *shards_[ShardIndex(wsi)]; }
+    ///Add message to the send queue of one or all clients and wake up the
+    ///service threads, which request a writable callback for each of them.
+    /// \param c recipient, \c nullptr to send to all the clients in the
+    /// current registry
+    void Enqueue(const Message& p, const ClientPtr& c, WSSENDPOLICY policy) {
+        if(c) {
+            Enqueue(*c, p, policy);
+            MarkDirty(c);
+        } else {
+            const std::shared_ptr< const ClientMap > clients = Snapshot();
+            for(auto& e: *clients) {
+                Enqueue(*e.second, p, policy);
+                MarkDirty(e.second);
+            }
+        }
+        //wakes up all the service threads
+        lws_cancel_service(context);
+    }
+    ///Add message to client queue according to send policy; callable from
+    ///any thread.
+    void Enqueue(Client& c, const Message& p, WSSENDPOLICY policy) {
+        if(policy == WSSENDPOLICY::LATEST) {
+            std::unique_ptr< Message > prev(c.latest.exchange(new Message(p)));
+            if(prev) ++c.replaced;
+            return;
+        }
+        //counted first: the service thread never sees more messages than
+        //the count
+        ++c.queued;
+        c.messages.Push(p);
+    }
+    ///Add client to the list of clients with new data of its service
+    ///thread, unless already there.
+    void MarkDirty(const ClientPtr& c) {
+        if(!c->dirty.exchange(true)) shards_[c->shard]->dirty.Push(c);
+    }
+    ///Drop the oldest queued messages exceeding the maximum queue size;
+    ///service thread only. The message being sent in fragments is not
+    ///in the queue and never dropped.
+    void Trim(Client& c) {
+        Message m;
+        while(c.queued > maxQueueSize_ && c.messages.Pop(m)) {
+            --c.queued;
+            ++c.dropped;
+        }
+    }
+    ///Take next message to send: queued messages first, then the
+    ///latest-wins message, which can no longer be replaced once taken;
+    ///service thread only.
+    /// \return \c false if there is nothing to send
+    bool Next(Client& c, Message& m) {
+        Trim(c);
+        if(c.messages.Pop(m)) {
+            --c.queued;
+            return true;
+        }
+        std::unique_ptr< Message > latest(c.latest.exchange(nullptr));
+        if(!latest) return false;
+        m = std::move(*latest);
+        return true;
+    }
+    ///Return \c true if client has messages to send; service thread only.
+    static bool Pending(const Client& c) {
+        return !c.messages.Empty() || c.latest.load() != nullptr;
+    }
+    ///Send next fragment of the gather message being sent to the client
+    ///through the client staging buffer; invoked from the service thread
+    ///only.
+    /// \return -1 on error, 0 if more fragments need to be sent, 1 if the
+    /// message was completely sent
+    int WriteFragment(lws* wsi, Client& c) {
+        PerSendData& psd = c.current.first;
+        const Gather& g = *psd.gather;
+        const size_t n = std::min(gatherChunkSize_.load(), g.size - psd.sent);
+        ByteArray& staging = c.staging;
+        staging.resize(LWS_PRE + n);
+        //copy [sent, sent + n) range of the message
+        unsigned char* out = staging.data() + LWS_PRE;
+        size_t pos = psd.sent;
+        size_t left = n;
+        size_t begin = 0;
+        for(auto& s: g.segments) {
+            const size_t end = begin + s.second;
+            if(left && pos < end) {
+                const size_t k = std::min(left, end - pos);
+                memmove(out, s.first + (pos - begin), k);
+                out += k;
+                pos += k;
+                left -= k;
+            }
+            begin = end;
+        }
+        const bool last = psd.sent + n == g.size;
+        int mode = psd.sent == 0 ? int(psd.writeMode)
+                                 : int(LWS_WRITE_CONTINUATION);
+        if(!last) mode |= LWS_WRITE_NO_FIN;
+        const int sent = lws_write(wsi, staging.data() + LWS_PRE, n,
+                                   static_cast< lws_write_protocol >(mode));
+        if(sent < 0) {
+            lwsl_err("ERROR %d writing to socket, hanging up\n", sent);
+            return -1;
+        }
+        if(size_t(sent) < n) {
+            lwsl_err("Partial write\n");
+            return -1;
+        }
+        if(last) {
+            c.current = Message();
+            ++c.sent;
+            return 1;
+        }
+        psd.sent += n;
+        return 0;
+    }
+    ///Return buffer of the requested size, taken from the memory pool if
+    ///memory recycling is enabled.
+    BAPtr NewBuffer(size_t sz) {
+        if(!recycleMemory_) return std::make_shared< ByteArray >(sz);
+        BAPtr p = bufferPool_.AcquireShared();
+        p->resize(sz);
+        return p;
+    }
+    ///Initialize libwebsockets and start service loops in separate threads
     void Init(int timeout,
               int port,
-              size_t recvBufferSize) {
+              size_t recvBufferSize,
+              int serviceThreads) {
         protocols = {
             //if using http put the http handler as the first entry in the table
             {
@@ -201,16 +522,28 @@ private:
         //warnings if following not set to something
         info.gid = -1;
         info.uid = -1;
+        //connections are distributed among the service threads
+        info.count_threads = unsigned(std::max(serviceThreads, 1));
 
         context = lws_create_context(&info);
-        wsocketsTask = std::async(std::launch::async, [this, timeout]() {
-            while(!this->stop && lws_service(this->context, timeout) >= 0);
-        });
+        //number of threads is limited by the LWS_MAX_SMP build option
+        const int threads = std::max(lws_get_count_threads(context), 1);
+        for(int t = 0; t != threads; ++t)
+            shards_.push_back(std::unique_ptr< Shard >(new Shard));
+        for(int t = 0; t != threads; ++t) {
+            wsocketsTasks.push_back(
+                std::async(std::launch::async, [this, timeout, t]() {
+                    CurrentServiceThread() = ServiceThread{this, size_t(t)};
+                    while(!this->stop
+                          && lws_service_tsi(this->context, timeout, t) >= 0);
+                }));
+        }
     }
-    ///Stop service loop.
+    ///Stop service loops.
     void Stop() {
         stop = true;
-        wsocketsTask.get();
+        lws_cancel_service(context);
+        for(auto& t: wsocketsTasks) t.get();
     }
 private:
     ///protocol name
@@ -219,35 +552,39 @@ private:
     lws_context* context;
     ///libwebsockets context creation data.
     lws_context_creation_info info;
-    ///Per client send queue.
-    std::map< ClientId, std::deque< std::pair< PerSendData, BAPtr > > > clientQueues_;
-    ///Sync access to clientQueues_.
-    std::mutex clientQueueGuard_;
+    ///Client state, one shard per service thread.
+    std::vector< std::unique_ptr< Shard > > shards_;
+    ///Connected clients, read through Snapshot.
+    std::shared_ptr< const ClientMap > clients_ =
+        std::make_shared< ClientMap >();
+    ///Sync replacement of clients_.
+    std::mutex clientsGuard_;
+    ///Number of connected clients.
+    std::atomic< size_t > connected_{0};
+    ///Maximum number of queued messages per client.
+    std::atomic< size_t > maxQueueSize_{256};
     ///Set to \c true to stop service.
-    bool stop;
-    ///Service task.
-    std::future< void > wsocketsTask;
+    std::atomic< bool > stop;
+    ///Service tasks, one per service thread.
+    std::vector< std::future< void > > wsocketsTasks;
     ///libwebsockets protocols.
     std::vector< lws_protocols > protocols;
     ///Client-provided callback.
     CBackT cback;
     ///Time in ms between subsequent writes.
     int frameTime_;
-    ///Pool of consumed memory buffer to be reused by client code.
-    std::deque< std::shared_ptr< std::vector< unsigned char > > >
-        consumedQueue_;
-    ///Guard access to \c consumedQueue_ from different threads.
-    std::mutex consumedQueueMutex_;
-    ///If set to \c true the send buffer is added into the memory pool
-    ///to be reused by client code.
+    ///Pool of consumed memory buffers to be reused by client code.
+    ObjectPool< ByteArray > bufferPool_;
+    ///If set to \c true the send buffers are taken from the memory pool
+    ///and returned to it once sent.
     bool recycleMemory_;
     ///If set to @c true it waits until all frames are received before
-    ///invoking the client callback
+    ///invoking the client callback; if @c false fragments are passed to the
+    ///callback as received, e.g. to decode them with @c srz::StreamDecoder
+    ///without buffering the whole message
     bool atomicMessages_;
-    ///Per-client receive buffer, used for constructing atomic messages
-    std::map< void*, std::vector< char > > clientBuffers_;
-    ///Guard access to client buffers
-    std::mutex clientBufferGuard_;
+    ///Maximum fragment size for gather messages.
+    std::atomic< size_t > gatherChunkSize_{0x10000};
 private:
     ///libwebsockets callback.
     static int
@@ -263,60 +600,93 @@ private:
                 lws_context_user(context));
         switch(reason) {
         case LWS_CALLBACK_SERVER_WRITEABLE: {
-            BAPtr p;
-            PerSendData psd;
-            {
-                std::lock_guard< std::mutex > l(wso->clientQueueGuard_);
-                if(!wso->ClientInQueue(ClientId(user))) {
-                    lws_callback_on_writable(wsi);
-                    break;
+            Client& c = *pss->client;
+            //frame pacing: wait for the client deadline on a timer, the
+            //service loop keeps serving the other clients in the meantime;
+            //fragments of a message already started are past the deadline
+            const auto now = std::chrono::steady_clock::now();
+            const auto next =
+                c.prev + std::chrono::milliseconds(c.frameTime.load());
+            if(now < next) {
+                lws_set_timer_usecs(wsi, lws_usec_t(
+                    std::chrono::duration_cast< std::chrono::microseconds >(
+                        next - now).count()));
+                break;
+            }
+            //a gather message is completely sent before the next one
+            if(!c.current.first.gather) {
+                Message m;
+                //nothing to send: wait for Push
+                if(!wso->Next(c, m)) break;
+                if(m.first.gather) {
+                    c.current = std::move(m);
+                } else {
+                    const BAPtr& p = m.second;
+                    lws_write_protocol writeMode = static_cast< lws_write_protocol >(m.first.writeMode);
+                    const int sent =
+                        lws_write(wsi, p->data() + LWS_PRE, p->size() - LWS_PRE,
+                                  writeMode);
+                    if(sent < 0) {
+                        lwsl_err("ERROR %d writing to socket, hanging up\n", sent);
+                        return -1;
+                    }
+                    if(sent < p->size() - LWS_PRE) {
+                        lwsl_err("Partial write\n");
+                        return -1;
+                    }
+                    ++c.sent;
                 }
-                std::deque< std::pair< PerSendData, BAPtr > >* q = &wso->clientQueues_[ClientId(user)];
-                if(q->empty()) {
+            }
+            if(c.current.first.gather) {
+                const int r = wso->WriteFragment(wsi, c);
+                if(r < 0) return -1;
+                if(r == 0) {
+                    //more fragments: no wait between fragments
                     lws_callback_on_writable(wsi);
                     break;
                 }
-                psd = q->front().first;
-                p = q->front().second;
-                q->pop_front();
-            }
-            lws_write_protocol writeMode = static_cast< lws_write_protocol >(psd.writeMode);
-            const int sent =
-                lws_write(wsi, p->data() + LWS_PRE, p->size() - LWS_PRE,
-                          writeMode);
-            if(wso->recycleMemory_)
-                wso->PushConsumedPaddedPtr(p);
-            if(sent < 0) {
-                lwsl_err("ERROR %d writing to socket, hanging up\n", sent);
-                return -1;
             }
-            if(sent < p->size() - LWS_PRE) {
-                lwsl_err("Partial write\n");
-                return -1;
+            c.prev = std::chrono::steady_clock::now();
+            //messages pushed later request a new writable callback through
+            //Enqueue
+            if(!Pending(c)) break;
+            const int ft = c.frameTime.load();
+            if(ft > 0) lws_set_timer_usecs(wsi, lws_usec_t(ft) * 1000);
+            else lws_callback_on_writable(wsi);
+        }
+            break;
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+            //woken up by Enqueue: request writable callbacks for the
+            //clients with new data serviced by this thread
+            Shard& shard = wso->ShardOf(wsi);
+            ClientPtr c;
+            while(shard.dirty.Pop(c)) {
+                //cleared first: messages pushed from now on mark the
+                //client again
+                c->dirty = false;
+                //skip clients disconnected after the push
+                if(c->closed) continue;
+                //bound memory of clients not writable
+                wso->Trim(*c);
+                lws_callback_on_writable(c->wsi);
             }
-            const std::chrono::milliseconds d =
-                std::chrono::duration_cast< std::chrono::milliseconds >
-                    (std::chrono::steady_clock::now() - pss->prev);
-            const auto ft =
-                std::chrono::milliseconds(wso->FrameTime());
-            if(d < ft) std::this_thread::sleep_for(ft - d);
-            pss->prev = std::chrono::steady_clock::now();
-            lws_callback_on_writable(wsi);
         }
             break;
+        case LWS_CALLBACK_TIMER:
+            //frame deadline reached
+            lws_callback_on_writable(wsi);
+            break;
         case LWS_CALLBACK_RECEIVE: {
             const bool finalFrag = bool(lws_is_final_fragment(wsi));
             const bool binary = lws_frame_is_binary(wsi);
             if(!finalFrag && wso->atomicMessages_) {
-              std::lock_guard< std::mutex > l(wso->clientBufferGuard_);
-              std::vector< char >& b = wso->clientBuffers_[user];
+              std::vector< char >& b = pss->client->recvBuffer;
               b.reserve(b.size() + len);
               b.insert(b.end(),
                        reinterpret_cast< const char* >(in),
                        reinterpret_cast< const char* >(in) + len);
             } else if(finalFrag && wso->atomicMessages_) {
-              std::lock_guard< std::mutex > l(wso->clientBufferGuard_);
-              std::vector< char >& b = wso->clientBuffers_[user];
+              std::vector< char >& b = pss->client->recvBuffer;
               b.insert(b.end(),
                        reinterpret_cast< const char* >(in),
                        reinterpret_cast< const char* >(in) + len);
@@ -328,29 +698,29 @@ private:
                          finalFrag,
                          binary);
             }
-            lws_callback_on_writable(wsi);
           }
             break;
         case LWS_CALLBACK_ESTABLISHED: {
-            std::lock_guard< std::mutex > l(wso->clientQueueGuard_);
-            assert(!wso->ClientInQueue(user));
-            wso->clientQueues_[user] = std::deque< std::pair< PerSendData, BAPtr > >();
-            if(wso->atomicMessages_) {
-              wso->clientBuffers_[user] = std::vector< char >();
-            }
+            new (pss) PerSessionData();
+            pss->client = std::make_shared< Client >();
+            Client& c = *pss->client;
+            c.id = user;
+            c.wsi = wsi;
+            c.shard = wso->ShardIndex(wsi);
+            c.frameTime = wso->FrameTime();
+            wso->AddClient(pss->client);
+            ++wso->connected_;
             wso->cback(WSSTATE::CONNECT, user, nullptr, 0, false, false);
-            lws_callback_on_writable(wsi);
         }
             break;
         case LWS_CALLBACK_CLOSED: {
-            std::lock_guard< std::mutex > l(wso->clientQueueGuard_);
-            assert(wso->ClientInQueue(user));
-            wso->clientQueues_.erase(wso->clientQueues_.find(user));
+            wso->RemoveClient(user);
+            //threads still holding the client may push to it until they
+            //release it, nothing is sent
+            pss->client->closed = true;
+            pss->~PerSessionData();
+            --wso->connected_;
             wso->cback(WSSTATE::DISCONNECT, user, nullptr, 0, false, false);
-            if(wso->atomicMessages_) {
-              std::lock_guard< std::mutex > l2(wso->clientBufferGuard_);
-              wso->clientBuffers_.erase(wso->clientBuffers_.find(user));
-            }
         }
             break;
         default:
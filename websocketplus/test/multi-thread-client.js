@@ -0,0 +1,52 @@
+// Author: Ugo Varetto
+//
+// Client of the multi-thread test server: opens many connections, which
+// the server distributes among its service threads, and checks that each
+// one receives broadcast messages, messages sent to it only and the echo
+// of its own message. A stalled service thread leaves its connections
+// without messages.
+//
+// usage: node [--experimental-websocket] multi-thread-client.js
+//             [url] [connections] [seconds]
+// Node versions without a global WebSocket require the 'ws' package.
+'use strict';
+
+const WS = globalThis.WebSocket || require('ws');
+
+const url = process.argv[2] || 'ws://localhost:7682';
+const connections = parseInt(process.argv[3] || '32');
+const seconds = parseFloat(process.argv[4] || '5');
+//messages of each type required per connection
+const required = 10;
+
+const clients = [];
+for(let i = 0; i !== connections; ++i) {
+    const c = {broadcast: 0, direct: 0, echo: false, error: null};
+    const ws = new WS(url, 'multi-thread');
+    ws.onopen = () => ws.send('e ' + i);
+    ws.onmessage = (e) => {
+        const m = String(e.data);
+        if(m.startsWith('b ')) ++c.broadcast;
+        else if(m.startsWith('c ')) ++c.direct;
+        else if(m === 'e ' + i) c.echo = true;
+    };
+    ws.onerror = (e) => { c.error = e.message || 'error'; };
+    c.ws = ws;
+    clients.push(c);
+}
+
+setTimeout(() => {
+    let failed = 0;
+    clients.forEach((c, i) => {
+        if(c.broadcast >= required && c.direct >= required && c.echo) return;
+        ++failed;
+        console.log('connection ' + i + ': ' + c.broadcast + ' broadcast, '
+                    + c.direct + ' direct, echo ' + c.echo
+                    + (c.error ? ', ' + c.error : ''));
+    });
+    clients.forEach((c) => c.ws.close());
+    console.log(failed ? 'FAILED: ' + failed + ' of ' + connections
+                         + ' connections stalled'
+                       : 'PASSED');
+    process.exit(failed ? 1 : 0);
+}, seconds * 1000);
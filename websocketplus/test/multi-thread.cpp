@@ -0,0 +1,86 @@
+// Author: Ugo Varetto
+//
+// websockets server serviced by multiple threads: broadcast and send to
+// each client at a fixed rate and echo received messages; run
+// multi-thread-client.js to check that the clients of every service
+// thread receive all the message types.
+//
+// usage: multi-thread [port] [service threads]
+//
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <functional>
+#include <atomic>
+#include "WSocketMServer.h"
+
+namespace {
+volatile bool forceExit = false;
+void forceQuit(int) {
+    forceExit = true;
+}
+
+std::vector< unsigned char > Text(const std::string& s) {
+    return std::vector< unsigned char >(s.begin(), s.end());
+}
+}
+
+using namespace std;
+
+using Callback = function< void (WSSTATE, ClientId, void*, int, int, int) >;
+using Server = WSocketMServer< Callback >;
+
+int main(int argc, char** argv) {
+    const int port = argc > 1 ? atoi(argv[1]) : 7682;
+    const int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    //callback: echo received message to sender; invoked concurrently from
+    //the service threads, possibly before construction returns
+    atomic< Server* > server(nullptr);
+    Callback cback = [&server](WSSTATE s, ClientId cid, void* in, int len,
+                               int, int) {
+        Server* wso = server.load();
+        if(s != WSSTATE::RECV || !wso) return;
+        const unsigned char* begin =
+            reinterpret_cast< const unsigned char* >(in);
+        wso->Push(vector< unsigned char >(begin, begin + len),
+                     false, WSMSGTYPE::TEXT, cid);
+    };
+
+    //service creation
+    Server wso("multi-thread", //protocol name
+               100,   //timeout
+               port,  //port
+               cback, //callback
+               true,  //recycle memory
+               0x1000, //input buffer size
+               0,     //no pacing
+               true,  //atomic messages
+               threads); //service threads
+    server.store(&wso);
+    cout << "port " << port << ", " << wso.ServiceThreads()
+         << " service threads" << endl;
+    signal(SIGINT, forceQuit);
+    //broadcast and send to each client every 10 ms
+    for(size_t n = 0; !forceExit; ++n) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        wso.Push(Text("b " + to_string(n)), false, WSMSGTYPE::TEXT);
+        for(ClientId c: wso.Clients()) {
+            try {
+                wso.Push(Text("c " + to_string(n)), false, WSMSGTYPE::TEXT,
+                         c);
+            } catch(const logic_error&) {
+                //disconnected after Clients() returned
+            }
+        }
+        if(n % 100 == 0)
+            cout << wso.ConnectedClients() << " clients" << endl;
+    }
+    return EXIT_SUCCESS;
+}